@@ -0,0 +1,107 @@
+/**
+ * Sound card analogue to digital converter
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "Adc.h"
+
+using namespace std;
+
+// Default baseband filter cut-off, as a fraction of the sample rate
+constexpr auto DEFAULT_CUTOFF_FRACTION = floating{0.45};
+
+/**
+ * Parse an ADC specification,
+ * bits:sampleRateHz:fullScaleVolts[:cutoffHz]
+ *
+ * @param specification ADC specification
+ * @return ADC settings
+ */
+auto AdcSettings::parse(const string& specification) -> AdcSettings {
+  auto stream = istringstream{specification};
+  auto parts = vector<string>{};
+  auto part = string{};
+  while (getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+
+  auto settings = AdcSettings{0, 0, 0, 0};
+  try {
+    if (parts.size() == 3 || parts.size() == 4) {
+      settings.bits = stoul(parts.at(0));
+      settings.sampleRateHz = stold(parts.at(1));
+      settings.fullScale = stold(parts.at(2));
+      settings.cutoffHz = (parts.size() == 4) ? stold(parts.at(3)) :
+	DEFAULT_CUTOFF_FRACTION * settings.sampleRateHz;
+    }
+  }
+  catch (const logic_error&) {
+    settings.bits = 0;
+  }
+
+  if (settings.bits < 2 || settings.bits > 24 ||
+      settings.sampleRateHz <= 0 || settings.fullScale <= 0 ||
+      settings.cutoffHz <= 0 ||
+      settings.cutoffHz >= settings.sampleRateHz / 2) {
+    cout << "Bad ADC specification " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+  return settings;
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param settings ADC characteristics
+ */
+Adc::Adc(const AdcSettings& settings) :
+  maximumCode{(1 << (settings.bits - 1)) - 1},
+  minimumCode{-(1 << (settings.bits - 1))},
+  codesPerVolt{(1 << (settings.bits - 1)) / settings.fullScale},
+  clipCount{0} {}
+
+/**
+ * Convert one sample.
+ *
+ * @param voltage input voltage
+ * @return ADC output code
+ */
+auto Adc::convert(floating voltage) -> int32_t {
+  auto code = llround(voltage * codesPerVolt);
+  if (code > maximumCode) {
+    clipCount++;
+    return maximumCode;
+  }
+  if (code < minimumCode) {
+    clipCount++;
+    return minimumCode;
+  }
+  return static_cast<int32_t>(code);
+}
@@ -0,0 +1,73 @@
+/**
+ * Sound card analogue to digital converter
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "misc.h"
+
+/**
+ * ADC characteristics.  The full scale voltage is the largest
+ * magnitude that can be converted without clipping.  The cut-off is
+ * that of the integer low pass filter on the samples.
+ */
+struct AdcSettings {
+  unsigned bits;
+  floating sampleRateHz;
+  floating fullScale;
+  floating cutoffHz;
+
+  static auto parse(const std::string& specification) -> AdcSettings;
+};
+
+//===================================================================
+
+/**
+ * This represents one channel of the sound card that digitises the
+ * IC2A and IC2B outputs in the real radio.  It rounds to the nearest
+ * code and clips at the ends of the range.
+ */
+class Adc {
+private:
+  const std::int32_t maximumCode;
+  const std::int32_t minimumCode;
+  const floating codesPerVolt;
+  std::size_t clipCount;
+
+public:
+  Adc(const AdcSettings& settings);
+  auto convert(floating voltage) -> std::int32_t;
+
+  /**
+   * Get the number of samples that have been clipped so far
+   *
+   * @return clipped sample count
+   */
+  auto getClipCount() const {
+    return clipCount;
+  }
+};
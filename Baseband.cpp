@@ -0,0 +1,243 @@
+/**
+ * Fixed point baseband processing of the digitised I/Q signal
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include "Baseband.h"
+
+using namespace std;
+
+// Vector types for the filter kernels.  These use the GCC vector
+// extensions, so the compiler picks whatever SIMD instructions the
+// target has.
+using v8hi = int16_t __attribute__((vector_size(16)));
+using v8si = int32_t __attribute__((vector_size(32)));
+using v4si = int32_t __attribute__((vector_size(16)));
+using v4di = int64_t __attribute__((vector_size(32)));
+
+//===================================================================
+
+/**
+ * FIR filter kernel for 16 bit samples.  Eight output samples are
+ * worked out at once.  The input has tapCount - 1 samples of history
+ * in front of the samples being filtered, and the taps are in reverse
+ * order so that each step of the inner loop reads eight consecutive
+ * input samples.
+ *
+ * @param input padded input samples
+ * @param count number of output samples
+ * @param taps reversed filter taps
+ * @param tapCount number of taps
+ * @param output output samples
+ */
+static auto firInt16(const int16_t* input,
+		     size_t count,
+		     const int16_t* taps,
+		     size_t tapCount,
+		     int32_t* output) -> void {
+  constexpr auto ROUNDING = int32_t{1} << (BASEBAND_COEFFICIENT_BITS - 1);
+  auto n = size_t{0};
+  for (; n + 8 <= count; n += 8) {
+    auto accumulator = v8si{} + ROUNDING;
+    for (auto tap = decltype(tapCount){0}; tap < tapCount; tap++) {
+      auto samples = v8hi{};
+      memcpy(&samples, input + n + tap, sizeof(samples));
+      accumulator += __builtin_convertvector(samples, v8si) *
+	static_cast<int32_t>(taps[tap]);
+    }
+    accumulator >>= BASEBAND_COEFFICIENT_BITS;
+    memcpy(output + n, &accumulator, sizeof(accumulator));
+  }
+  for (; n < count; n++) {
+    auto accumulator = ROUNDING;
+    for (auto tap = decltype(tapCount){0}; tap < tapCount; tap++) {
+      accumulator += input[n + tap] * static_cast<int32_t>(taps[tap]);
+    }
+    output[n] = accumulator >> BASEBAND_COEFFICIENT_BITS;
+  }
+}
+
+/**
+ * FIR filter kernel for 32 bit samples, four output samples at a
+ * time.  See firInt16 for the layout of the arguments.
+ *
+ * @param input padded input samples
+ * @param count number of output samples
+ * @param taps reversed filter taps
+ * @param tapCount number of taps
+ * @param output output samples
+ */
+static auto firInt32(const int32_t* input,
+		     size_t count,
+		     const int16_t* taps,
+		     size_t tapCount,
+		     int32_t* output) -> void {
+  constexpr auto ROUNDING = int64_t{1} << (BASEBAND_COEFFICIENT_BITS - 1);
+  auto n = size_t{0};
+  for (; n + 4 <= count; n += 4) {
+    auto accumulator = v4di{} + ROUNDING;
+    for (auto tap = decltype(tapCount){0}; tap < tapCount; tap++) {
+      auto samples = v4si{};
+      memcpy(&samples, input + n + tap, sizeof(samples));
+      accumulator += __builtin_convertvector(samples, v4di) *
+	static_cast<int64_t>(taps[tap]);
+    }
+    accumulator >>= BASEBAND_COEFFICIENT_BITS;
+    auto narrowed = __builtin_convertvector(accumulator, v4si);
+    memcpy(output + n, &narrowed, sizeof(narrowed));
+  }
+  for (; n < count; n++) {
+    auto accumulator = ROUNDING;
+    for (auto tap = decltype(tapCount){0}; tap < tapCount; tap++) {
+      accumulator += input[n + tap] * static_cast<int64_t>(taps[tap]);
+    }
+    output[n] = static_cast<int32_t>(accumulator >> BASEBAND_COEFFICIENT_BITS);
+  }
+}
+
+/**
+ * Integer square root, rounded down
+ *
+ * @param value value to take the square root of
+ * @return the square root
+ */
+static auto squareRoot(uint64_t value) -> uint64_t {
+  auto root = static_cast<uint64_t>(sqrt(static_cast<double>(value)));
+  while (root * root > value) {
+    root--;
+  }
+  while ((root + 1) * (root + 1) <= value) {
+    root++;
+  }
+  return root;
+}
+
+//===================================================================
+
+/**
+ * Constructor.  Designs a Hamming windowed sinc low pass filter and
+ * quantises its taps, adjusting the centre tap so that the DC gain is
+ * exactly one.  A cut-off of 0, or one above the Nyquist frequency,
+ * gives a filter that just passes the signal through.
+ *
+ * @param cutoffHz low pass cut-off frequency
+ * @param sampleRateHz ADC sample rate
+ * @param adcBits ADC resolution
+ */
+Baseband::Baseband(floating cutoffHz,
+		   floating sampleRateHz,
+		   unsigned adcBits) :
+  taps(BASEBAND_TAPS, 0),
+  adcBits{adcBits} {
+  constexpr auto ONE = int32_t{1} << BASEBAND_COEFFICIENT_BITS;
+  const auto centre = BASEBAND_TAPS / 2;
+  const auto normalisedCutoff = cutoffHz / sampleRateHz;
+
+  if (cutoffHz <= 0 || normalisedCutoff >= 0.5) {
+    taps.at(centre) = ONE;
+    return;
+  }
+
+  auto design = vector<floating>(BASEBAND_TAPS);
+  auto sum = floating{0};
+  for (auto index = size_t{0}; index < BASEBAND_TAPS; index++) {
+    auto offset = static_cast<floating>(index) - centre;
+    auto sinc = (offset == 0) ? 2 * normalisedCutoff :
+      sin(2 * M_PI * normalisedCutoff * offset) / (M_PI * offset);
+    auto window = 0.54 - 0.46 * cos(2 * M_PI * index / (BASEBAND_TAPS - 1));
+    design.at(index) = sinc * window;
+    sum += design.at(index);
+  }
+
+  auto total = int32_t{0};
+  for (auto index = size_t{0}; index < BASEBAND_TAPS; index++) {
+    taps.at(index) = static_cast<int16_t>(lround(design.at(index) / sum * ONE));
+    total += taps.at(index);
+  }
+  taps.at(centre) += ONE - total;
+}
+
+/**
+ * Low pass filter a block of samples, starting with an empty filter.
+ *
+ * @param input ADC codes
+ * @return filtered samples, in ADC codes
+ */
+auto Baseband::filter(const vector<int32_t>& input) const -> vector<int32_t> {
+  auto output = vector<int32_t>(input.size());
+  auto reversedTaps = vector<int16_t>(taps.rbegin(), taps.rend());
+  const auto history = taps.size() - 1;
+
+  if (adcBits <= 16) {
+    auto padded = vector<int16_t>(history, 0);
+    padded.insert(padded.end(), input.begin(), input.end());
+    firInt16(padded.data(), input.size(),
+	     reversedTaps.data(), reversedTaps.size(), output.data());
+  }
+  else {
+    auto padded = vector<int32_t>(history, 0);
+    padded.insert(padded.end(), input.begin(), input.end());
+    firInt32(padded.data(), input.size(),
+	     reversedTaps.data(), reversedTaps.size(), output.data());
+  }
+  return output;
+}
+
+/**
+ * AM demodulation, the magnitude of the I/Q vector
+ *
+ * @param inphase in phase samples
+ * @param quadrature quadrature samples
+ * @return demodulated samples
+ */
+auto Baseband::demodulate(const vector<int32_t>& inphase,
+			  const vector<int32_t>& quadrature) const
+  -> vector<int32_t> {
+  auto output = vector<int32_t>(inphase.size());
+  for (auto index = size_t{0}; index < output.size(); index++) {
+    auto i = static_cast<int64_t>(inphase.at(index));
+    auto q = static_cast<int64_t>(quadrature.at(index));
+    output.at(index) =
+      static_cast<int32_t>(squareRoot(static_cast<uint64_t>(i * i + q * q)));
+  }
+  return output;
+}
+
+/**
+ * Remove the DC level with a first order high pass filter.  The
+ * accumulator holds the DC level scaled up by 2^BASEBAND_DC_SHIFT so
+ * that no precision is lost.
+ *
+ * @param samples samples to process in place
+ */
+auto Baseband::removeDc(vector<int32_t>& samples) const -> void {
+  auto accumulator = int64_t{0};
+  for (auto&& sample : samples) {
+    auto output = sample - (accumulator >> BASEBAND_DC_SHIFT);
+    accumulator += output;
+    sample = static_cast<int32_t>(output);
+  }
+}
@@ -0,0 +1,63 @@
+/**
+ * Fixed point baseband processing of the digitised I/Q signal
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "misc.h"
+
+// Number of taps in the low pass FIR filter
+constexpr auto BASEBAND_TAPS = std::size_t{63};
+
+// Fractional bits in the filter coefficients
+constexpr auto BASEBAND_COEFFICIENT_BITS = 14;
+
+// DC removal time constant is 2^BASEBAND_DC_SHIFT samples
+constexpr auto BASEBAND_DC_SHIFT = 8u;
+
+/**
+ * Integer only version of the filtering, demodulation and DC removal
+ * that the PC does after the sound card.  Samples are ADC codes.
+ * ADCs of 16 bits or fewer use 16 bit samples with 32 bit
+ * accumulators, wider ADCs use 32 bit samples with 64 bit
+ * accumulators.
+ */
+class Baseband {
+private:
+  std::vector<std::int16_t> taps;
+  const unsigned adcBits;
+
+public:
+  Baseband(floating cutoffHz, floating sampleRateHz, unsigned adcBits);
+  auto filter(const std::vector<std::int32_t>& input) const
+    -> std::vector<std::int32_t>;
+  auto demodulate(const std::vector<std::int32_t>& inphase,
+		  const std::vector<std::int32_t>& quadrature) const
+    -> std::vector<std::int32_t>;
+  auto removeDc(std::vector<std::int32_t>& samples) const -> void;
+};
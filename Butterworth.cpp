@@ -0,0 +1,105 @@
+/**
+ * Streaming Butterworth filter
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "Butterworth.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ *
+ * @param poles number of poles
+ * @param cutoffHz filter cut-off frequency, 0 to disable the filter
+ * @param highPass true for high pass, false for low pass
+ */
+Butterworth::Butterworth(unsigned poles,
+			 floating cutoffHz,
+			 bool highPass) : filter{nullptr} {
+  if (cutoffHz) {
+    const auto normalisedCutoffFreq = 
+      cutoffHz * static_cast<floating>(TIME_STEP_SIZE);
+
+    filter = rtf_create_butterworth(1,
+				    RTF_DOUBLE,
+				    static_cast<double>(normalisedCutoffFreq),
+				    poles,
+				    static_cast<int>(highPass));
+
+    if (filter == nullptr) {
+      cout << "Unable to create low pass filter" << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/**
+ * Filter the next block of the signal.  The input and output can be
+ * the same.
+ *
+ * @param input input samples
+ * @param output filtered samples
+ * @param count number of samples
+ */
+auto Butterworth::apply(const double* input,
+			double* output,
+			size_t count) -> void {
+  if (filter) {
+    rtf_filter(filter, input, output, count);
+  }
+  else if (input != output) {
+    copy(input, input + count, output);
+  }
+}
+
+/**
+ * Destructor
+ */
+Butterworth::~Butterworth() {
+  if (filter) {
+    rtf_destroy_filter(filter);
+  }
+}
+
+//===================================================================
+
+/**
+ * Check a low pass filter cut-off before making a filter with it.
+ * The constructor exits on one that rtfilter can't make a filter
+ * for, which would take a server or a program using the library down
+ * with it, so callers that take cut-offs from outside check them
+ * here first.
+ *
+ * @param cutoffHz cut-off frequency, 0 for no filter
+ */
+auto checkCutoff(floating cutoffHz) -> void {
+  if (!(cutoffHz >= 0 && cutoffHz < NYQUIST_HZ)) {
+    throw invalid_argument{"The low pass filter cutoff must be at least "
+			   "0 and below half the simulation rate"};
+  }
+}
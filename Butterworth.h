@@ -0,0 +1,51 @@
+/**
+ * Streaming Butterworth filter
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <rtf_common.h>
+#include "misc.h"
+
+/**
+ * Butterworth filter that keeps its state between calls, so that a
+ * signal can be filtered a block at a time with exactly the same
+ * result as filtering it all at once.  A cut-off frequency of zero
+ * disables the filter, so that it just copies its input.
+ */
+class Butterworth {
+private:
+  hfilter filter;
+
+public:
+  Butterworth(unsigned poles, floating cutoffHz, bool highPass);
+  Butterworth(const Butterworth&) = delete;
+  Butterworth& operator=(const Butterworth&) = delete;
+  auto apply(const double* input, double* output, std::size_t count) -> void;
+  ~Butterworth();
+};
+
+auto checkCutoff(floating cutoffHz) -> void;
@@ -0,0 +1,254 @@
+/**
+ * Oscilloscope style triggered capture of the results
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <sstream>
+#include "Capture.h"
+
+using namespace std;
+
+/**
+ * Parse a trigger specification.  This is one of
+ *
+ *   column:level:value
+ *   column:rising:value
+ *   column:falling:value
+ *   window:startSeconds:endSeconds
+ *
+ * where column is one of the column headings of the output file.
+ *
+ * @param specification trigger specification
+ * @return the trigger
+ */
+auto Trigger::parse(const string& specification) -> Trigger {
+  auto stream = istringstream{specification};
+  auto parts = vector<string>{};
+  auto part = string{};
+  while (getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+
+  if (parts.size() != 3) {
+    cout << "Bad trigger specification " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto trigger = Trigger{parts.at(0), Mode::LEVEL, 0, 0, 0};
+  try {
+    if (parts.at(0) == "window") {
+      trigger.mode = Mode::WINDOW;
+      trigger.windowStart = stold(parts.at(1));
+      trigger.windowEnd = stold(parts.at(2));
+      return trigger;
+    }
+
+    trigger.level = stold(parts.at(2));
+  }
+  catch (const logic_error&) {
+    cout << "Bad trigger value in " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (parts.at(1) == "level") {
+    trigger.mode = Mode::LEVEL;
+  }
+  else if (parts.at(1) == "rising") {
+    trigger.mode = Mode::RISING;
+  }
+  else if (parts.at(1) == "falling") {
+    trigger.mode = Mode::FALLING;
+  }
+  else {
+    cout << "Unknown trigger mode " << parts.at(1) << endl;
+    exit(EXIT_FAILURE);
+  }
+  return trigger;
+}
+
+//===================================================================
+
+/**
+ * Constructor.  The ring buffer is allocated here, and is not resized
+ * afterwards.
+ *
+ * @param settings trigger and capture lengths
+ * @param output where the captured lines go
+ */
+Capture::Capture(const CaptureSettings& settings, OutputSink& output) :
+  settings{settings},
+  output{output},
+  fieldIndex{0},
+  ring(settings.preTrigger),
+  ringStart{0},
+  ringCount{0},
+  postRemaining{0},
+  segments{0},
+  capturing{false},
+  havePrevious{false},
+  previous{0} {}
+
+/**
+ * Look up the trigger column and pass the headings on.
+ *
+ * @param headings column headings
+ */
+auto Capture::begin(const string& headings) -> void {
+  if (settings.trigger.mode != Trigger::Mode::WINDOW) {
+    auto index = findField(headings, settings.trigger.column);
+    if (!index) {
+      cout << "No column called " << settings.trigger.column
+	   << " to trigger on" << endl;
+      exit(EXIT_FAILURE);
+    }
+    fieldIndex = *index;
+  }
+  output.begin(headings);
+}
+
+/**
+ * Check the trigger condition for this line.
+ *
+ * @param timeStamp time of the line
+ * @param fields values on the line
+ * @return true if the trigger fires
+ */
+auto Capture::fired(floating timeStamp,
+		    const vector<floating>& fields) -> bool {
+  const auto& trigger = settings.trigger;
+  if (trigger.mode == Trigger::Mode::WINDOW) {
+    return timeStamp >= trigger.windowStart && timeStamp <= trigger.windowEnd;
+  }
+
+  auto value = fields.at(fieldIndex);
+  auto result = false;
+  switch (trigger.mode) {
+  case Trigger::Mode::LEVEL:
+    result = value >= trigger.level;
+    break;
+  case Trigger::Mode::RISING:
+    result = havePrevious && previous < trigger.level && value >= trigger.level;
+    break;
+  case Trigger::Mode::FALLING:
+    result = havePrevious && previous > trigger.level && value <= trigger.level;
+    break;
+  default:
+    break;
+  }
+  previous = value;
+  havePrevious = true;
+  return result;
+}
+
+/**
+ * Keep a line in the pre-trigger ring buffer, overwriting the oldest
+ * line if it is full.
+ *
+ * @param timeStep time step
+ * @param timeStamp time
+ * @param fields values on the line
+ */
+auto Capture::hold(size_t timeStep,
+		   floating timeStamp,
+		   const vector<floating>& fields) -> void {
+  if (ring.empty()) {
+    return;
+  }
+  auto index = (ringStart + ringCount) % ring.size();
+  if (ringCount == ring.size()) {
+    ringStart = (ringStart + 1) % ring.size();
+  }
+  else {
+    ringCount++;
+  }
+  auto& line = ring.at(index);
+  line.timeStep = timeStep;
+  line.timeStamp = timeStamp;
+  line.fields = fields;
+}
+
+/**
+ * Write out everything in the pre-trigger ring buffer and empty it.
+ */
+auto Capture::flush() -> void {
+  for (auto count = decltype(ringCount){0}; count < ringCount; count++) {
+    const auto& line = ring.at((ringStart + count) % ring.size());
+    output.write(line.timeStep, line.timeStamp, line.fields);
+  }
+  ringStart = 0;
+  ringCount = 0;
+}
+
+/**
+ * Handle one line of results.  Level and window triggers are
+ * re-triggerable, so the capture carries on for as long as the
+ * condition holds.  Edge triggers are ignored until the current
+ * capture has finished.
+ *
+ * @param timeStep time step
+ * @param timeStamp time
+ * @param fields values on the line
+ */
+auto Capture::write(size_t timeStep,
+		    floating timeStamp,
+		    const vector<floating>& fields) -> void {
+  auto triggered = fired(timeStamp, fields);
+  auto retriggerable = settings.trigger.mode == Trigger::Mode::LEVEL ||
+    settings.trigger.mode == Trigger::Mode::WINDOW;
+
+  if (capturing) {
+    if (triggered && retriggerable) {
+      output.write(timeStep, timeStamp, fields);
+      postRemaining = settings.postTrigger;
+      return;
+    }
+    if (postRemaining > 0) {
+      output.write(timeStep, timeStamp, fields);
+      postRemaining--;
+      return;
+    }
+    capturing = false;
+  }
+
+  auto armed = settings.maxSegments == 0 || segments < settings.maxSegments;
+  if (triggered && armed) {
+    output.segment(segments++, timeStep);
+    flush();
+    output.write(timeStep, timeStamp, fields);
+    postRemaining = settings.postTrigger;
+    capturing = true;
+  }
+  else if (armed) {
+    hold(timeStep, timeStamp, fields);
+  }
+}
+
+/**
+ * End of the results.  Anything left in the ring buffer never saw a
+ * trigger, so is discarded.
+ */
+auto Capture::end() -> void {
+  output.end();
+}
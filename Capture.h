@@ -0,0 +1,108 @@
+/**
+ * Oscilloscope style triggered capture of the results
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "Output.h"
+
+//===================================================================
+
+/**
+ * Trigger condition.  LEVEL fires whenever the column is at or above
+ * the level, RISING and FALLING fire when the column crosses the
+ * level, and WINDOW fires for every line between two times.
+ */
+struct Trigger {
+  enum class Mode { LEVEL, RISING, FALLING, WINDOW };
+
+  std::string column;
+  Mode mode;
+  floating level;
+  floating windowStart;
+  floating windowEnd;
+
+  static auto parse(const std::string& specification) -> Trigger;
+};
+
+/**
+ * Trigger condition plus the number of lines to keep either side of
+ * it.  A maxSegments of zero means keep on re-arming until the end
+ * of the run.
+ */
+struct CaptureSettings {
+  Trigger trigger;
+  std::size_t preTrigger;
+  std::size_t postTrigger;
+  std::size_t maxSegments;
+};
+
+//===================================================================
+
+/**
+ * Sits in front of another output sink and only passes on the lines
+ * around each trigger.  Lines before the trigger are held in a fixed
+ * size ring buffer, so the memory the capture uses depends on its
+ * length rather than the length of the run.  The block engines
+ * stream each line through it as soon as it has been worked out,
+ * unless it triggers on a column that needs the whole run, in which
+ * case the mixers hold the whole run before passing it on.
+ */
+class Capture : public OutputSink {
+private:
+  struct Line {
+    std::size_t timeStep;
+    floating timeStamp;
+    std::vector<floating> fields;
+  };
+
+  const CaptureSettings settings;
+  OutputSink& output;
+  std::size_t fieldIndex;
+  std::vector<Line> ring;
+  std::size_t ringStart;
+  std::size_t ringCount;
+  std::size_t postRemaining;
+  std::size_t segments;
+  bool capturing;
+  bool havePrevious;
+  floating previous;
+
+  auto fired(floating timeStamp,
+	     const std::vector<floating>& fields) -> bool;
+  auto hold(std::size_t timeStep,
+	    floating timeStamp,
+	    const std::vector<floating>& fields) -> void;
+  auto flush() -> void;
+
+public:
+  Capture(const CaptureSettings& settings, OutputSink& output);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto end() -> void override;
+  virtual ~Capture() = default;
+};
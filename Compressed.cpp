@@ -0,0 +1,401 @@
+/**
+ * Compressed column output with a block index
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <zlib.h>
+#include "Compressed.h"
+
+using namespace std;
+
+// Start and end of a compressed results file
+constexpr char FILE_MAGIC[] = "ZSDRCMP1";
+constexpr char INDEX_MAGIC[] = "ZSDRIDX1";
+constexpr auto MAGIC_LENGTH = sizeof(FILE_MAGIC) - 1;
+
+//===================================================================
+
+/**
+ * Write a value in the machine's byte order
+ *
+ * @param file output file
+ * @param value value to write
+ */
+template<typename T>
+static auto writeValue(ofstream& file, T value) -> void {
+  file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+ * Read a value in the machine's byte order
+ *
+ * @param file input file
+ * @return the value
+ */
+template<typename T>
+static auto readValue(ifstream& file) -> T {
+  auto value = T{};
+  file.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return value;
+}
+
+/**
+ * Encode and deflate one block.  Each column becomes a run of 64 bit
+ * words, the first holding the first value and the rest the
+ * difference from the value before.  The words are stored a byte
+ * position at a time, so that the mostly zero high bytes of the
+ * differences end up next to each other.
+ *
+ * @param timeSteps time step column
+ * @param columns the other columns
+ * @return deflated block
+ */
+static auto compressBlock(const vector<uint64_t>& timeSteps,
+			  const vector<vector<double>>& columns)
+  -> vector<unsigned char> {
+  const auto rows = timeSteps.size();
+  auto words = vector<uint64_t>(rows);
+  auto raw = vector<unsigned char>{};
+  raw.reserve(rows * (columns.size() + 1) * sizeof(uint64_t));
+
+  auto shuffle = [&]() {
+    for (auto byte = size_t{0}; byte < sizeof(uint64_t); byte++) {
+      for (auto&& word : words) {
+	raw.push_back(static_cast<unsigned char>(word >> (8 * byte)));
+      }
+    }
+  };
+
+  auto previous = uint64_t{0};
+  for (auto row = size_t{0}; row < rows; row++) {
+    words[row] = timeSteps[row] - previous;
+    previous = timeSteps[row];
+  }
+  shuffle();
+
+  for (auto&& column : columns) {
+    previous = 0;
+    for (auto row = size_t{0}; row < rows; row++) {
+      auto bits = uint64_t{};
+      memcpy(&bits, &column[row], sizeof(bits));
+      words[row] = bits ^ previous;
+      previous = bits;
+    }
+    shuffle();
+  }
+
+  auto compressedSize = compressBound(raw.size());
+  auto compressed = vector<unsigned char>(compressedSize);
+  if (compress2(compressed.data(), &compressedSize,
+		raw.data(), raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+    cout << "Unable to compress results" << endl;
+    exit(EXIT_FAILURE);
+  }
+  compressed.resize(compressedSize);
+  return compressed;
+}
+
+/**
+ * Inflate and decode one block
+ *
+ * @param compressed deflated block
+ * @param rows number of rows in the block
+ * @param columnCount number of columns including the time step
+ * @param timeSteps receives the time step column
+ * @param columns receives the other columns
+ */
+static auto decompressBlock(const vector<unsigned char>& compressed,
+			    size_t rows,
+			    size_t columnCount,
+			    vector<uint64_t>& timeSteps,
+			    vector<vector<double>>& columns) -> void {
+  auto raw = vector<unsigned char>(rows * columnCount * sizeof(uint64_t));
+  auto rawSize = uLongf{raw.size()};
+  if (uncompress(raw.data(), &rawSize,
+		 compressed.data(), compressed.size()) != Z_OK ||
+      rawSize != raw.size()) {
+    cout << "Corrupt compressed results" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto words = vector<uint64_t>(rows);
+  auto position = size_t{0};
+  auto unshuffle = [&]() {
+    fill(words.begin(), words.end(), 0);
+    for (auto byte = size_t{0}; byte < sizeof(uint64_t); byte++) {
+      for (auto&& word : words) {
+	word |= uint64_t{raw[position++]} << (8 * byte);
+      }
+    }
+  };
+
+  unshuffle();
+  timeSteps.resize(rows);
+  auto previous = uint64_t{0};
+  for (auto row = size_t{0}; row < rows; row++) {
+    previous += words[row];
+    timeSteps[row] = previous;
+  }
+
+  columns.resize(columnCount - 1);
+  for (auto&& column : columns) {
+    unshuffle();
+    column.resize(rows);
+    previous = 0;
+    for (auto row = size_t{0}; row < rows; row++) {
+      previous ^= words[row];
+      memcpy(&column[row], &previous, sizeof(previous));
+    }
+  }
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param filename output filename
+ */
+CompressedFile::CompressedFile(const string& filename) :
+  file{filename, ios::binary},
+  columnCount{0},
+  segmentIndex{NO_SEGMENT},
+  triggerTimeStep{0},
+  maxInFlight{max(thread::hardware_concurrency(), 1u)} {}
+
+/**
+ * Write the file header
+ *
+ * @param headings column headings
+ */
+auto CompressedFile::begin(const string& headings) -> void {
+  file.write(FILE_MAGIC, MAGIC_LENGTH);
+  writeValue(file, uint64_t{headings.size()});
+  file.write(headings.data(), headings.size());
+}
+
+/**
+ * Add one line of results, compressing the block when it is full
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto CompressedFile::write(size_t timeStep,
+			   floating timeStamp,
+			   const vector<floating>& fields) -> void {
+  if (!columnCount) {
+    columnCount = fields.size() + 2;
+  }
+  if (columns.empty()) {
+    columns.resize(columnCount - 1);
+  }
+  timeSteps.push_back(timeStep);
+  columns.at(0).push_back(static_cast<double>(timeStamp));
+  for (auto index = size_t{0}; index < fields.size(); index++) {
+    columns.at(index + 1).push_back(static_cast<double>(fields[index]));
+  }
+  if (timeSteps.size() == COMPRESSED_BLOCK_ROWS) {
+    flush();
+  }
+}
+
+/**
+ * Start a new block for each captured segment, so that the index
+ * records where the segments start
+ *
+ * @param index segment number
+ * @param triggerTimeStep time step at which the trigger fired
+ */
+auto CompressedFile::segment(size_t index, size_t triggerTimeStep) -> void {
+  flush();
+  segmentIndex = index;
+  this->triggerTimeStep = triggerTimeStep;
+}
+
+/**
+ * Hand the current block to another thread to compress, first
+ * writing out the oldest block if there are already enough being
+ * compressed
+ */
+auto CompressedFile::flush() -> void {
+  if (timeSteps.empty()) {
+    return;
+  }
+  auto block = CompressedBlock{0, 0, timeSteps.size(),
+			       timeSteps.front(), timeSteps.back(),
+			       columns.at(0).front(), columns.at(0).back(),
+			       segmentIndex, triggerTimeStep};
+
+  if (inFlight.size() >= maxInFlight) {
+    writeOldest();
+  }
+  inFlight.push_back(async(launch::async,
+			   [block,
+			    timeSteps = move(timeSteps),
+			    columns = move(columns)]() {
+			     return Compressed{compressBlock(timeSteps,
+							     columns),
+					       block};
+			   }));
+  timeSteps.clear();
+  columns.clear();
+}
+
+/**
+ * Wait for the oldest block to be compressed, and write it out
+ */
+auto CompressedFile::writeOldest() -> void {
+  auto compressed = inFlight.front().get();
+  inFlight.pop_front();
+  compressed.block.offset = static_cast<uint64_t>(file.tellp());
+  compressed.block.size = compressed.data.size();
+  file.write(reinterpret_cast<const char*>(compressed.data.data()),
+	     compressed.data.size());
+  index.push_back(compressed.block);
+}
+
+/**
+ * Write out the remaining blocks, followed by the index
+ */
+auto CompressedFile::end() -> void {
+  flush();
+  while (!inFlight.empty()) {
+    writeOldest();
+  }
+
+  const auto indexOffset = static_cast<uint64_t>(file.tellp());
+  for (auto&& block : index) {
+    writeValue(file, block.offset);
+    writeValue(file, block.size);
+    writeValue(file, block.rows);
+    writeValue(file, block.firstTimeStep);
+    writeValue(file, block.lastTimeStep);
+    writeValue(file, block.firstTime);
+    writeValue(file, block.lastTime);
+    writeValue(file, block.segment);
+    writeValue(file, block.triggerTimeStep);
+  }
+  writeValue(file, columnCount);
+  writeValue(file, uint64_t{index.size()});
+  writeValue(file, indexOffset);
+  file.write(INDEX_MAGIC, MAGIC_LENGTH);
+  file.flush();
+}
+
+//===================================================================
+
+/**
+ * Constructor.  Reads the headings and the block index.
+ *
+ * @param filename compressed results file
+ */
+CompressedReader::CompressedReader(const string& filename) :
+  file{filename, ios::binary} {
+  auto magic = string(MAGIC_LENGTH, ' ');
+  file.read(magic.data(), MAGIC_LENGTH);
+  if (!file || magic != FILE_MAGIC) {
+    cout << filename << " is not a compressed results file" << endl;
+    exit(EXIT_FAILURE);
+  }
+  headings.resize(readValue<uint64_t>(file));
+  file.read(headings.data(), headings.size());
+
+  constexpr auto TRAILER_SIZE = 3 * sizeof(uint64_t) + MAGIC_LENGTH;
+  file.seekg(-static_cast<streamoff>(TRAILER_SIZE), ios::end);
+  columnCount = readValue<uint64_t>(file);
+  const auto blockCount = readValue<uint64_t>(file);
+  const auto indexOffset = readValue<uint64_t>(file);
+  file.read(magic.data(), MAGIC_LENGTH);
+  if (!file || magic != INDEX_MAGIC) {
+    cout << filename << " has no block index, it may be incomplete" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  file.seekg(indexOffset);
+  for (auto block = uint64_t{0}; block < blockCount; block++) {
+    auto entry = CompressedBlock{};
+    entry.offset = readValue<uint64_t>(file);
+    entry.size = readValue<uint64_t>(file);
+    entry.rows = readValue<uint64_t>(file);
+    entry.firstTimeStep = readValue<uint64_t>(file);
+    entry.lastTimeStep = readValue<uint64_t>(file);
+    entry.firstTime = readValue<double>(file);
+    entry.lastTime = readValue<double>(file);
+    entry.segment = readValue<uint64_t>(file);
+    entry.triggerTimeStep = readValue<uint64_t>(file);
+    index.push_back(entry);
+  }
+}
+
+/**
+ * Pass the lines between two times to an output sink.  Only the
+ * blocks that overlap the time range are decompressed.
+ *
+ * @param fromTime start of the time range, in seconds
+ * @param toTime end of the time range, in seconds
+ * @param sink where the lines go
+ */
+auto CompressedReader::read(double fromTime,
+			    double toTime,
+			    OutputSink& sink) -> void {
+  sink.begin(headings);
+
+  auto currentSegment = NO_SEGMENT;
+  auto compressed = vector<unsigned char>{};
+  auto timeSteps = vector<uint64_t>{};
+  auto columns = vector<vector<double>>{};
+  auto fields = vector<floating>(columnCount > 2 ? columnCount - 2 : 0);
+
+  for (auto&& block : index) {
+    if (block.lastTime < fromTime || block.firstTime > toTime) {
+      continue;
+    }
+    if (block.segment != NO_SEGMENT && block.segment != currentSegment) {
+      sink.segment(block.segment, block.triggerTimeStep);
+      currentSegment = block.segment;
+    }
+
+    compressed.resize(block.size);
+    file.seekg(block.offset);
+    file.read(reinterpret_cast<char*>(compressed.data()), block.size);
+    decompressBlock(compressed, block.rows, columnCount, timeSteps, columns);
+
+    for (auto row = size_t{0}; row < block.rows; row++) {
+      const auto time = columns.at(0)[row];
+      if (time < fromTime || time > toTime) {
+	continue;
+      }
+      for (auto field = size_t{0}; field < fields.size(); field++) {
+	fields[field] = columns.at(field + 1)[row];
+      }
+      sink.write(timeSteps[row], time, fields);
+    }
+  }
+  sink.end();
+}
@@ -0,0 +1,130 @@
+/**
+ * Compressed column output with a block index
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <string>
+#include <vector>
+#include "Output.h"
+
+// Rows in each compressed block, which is the unit of random access
+constexpr auto COMPRESSED_BLOCK_ROWS = std::size_t{4096};
+
+// Blocks in a file that don't belong to a triggered capture segment
+constexpr auto NO_SEGMENT = ~std::uint64_t{0};
+
+/**
+ * Index entry for one block of a compressed results file
+ */
+struct CompressedBlock {
+  std::uint64_t offset;
+  std::uint64_t size;
+  std::uint64_t rows;
+  std::uint64_t firstTimeStep;
+  std::uint64_t lastTimeStep;
+  double firstTime;
+  double lastTime;
+  std::uint64_t segment;
+  std::uint64_t triggerTimeStep;
+};
+
+//===================================================================
+
+/**
+ * Writes the results as a compressed binary file, which is much
+ * smaller than the CSV file.  The rows are grouped into blocks.
+ * Within a block each column is encoded as the difference from the
+ * previous row: an integer difference for the time step, and the
+ * exclusive or of the bit patterns for the floating point columns, as
+ * consecutive values share their sign, exponent and top mantissa
+ * bits.  The bytes are then grouped by significance and deflated.
+ * Blocks are compressed on several threads at once, and an index of
+ * the blocks at the end of the file lets a reader find a time range
+ * without decompressing the rest.
+ *
+ * The values are stored as doubles, so nothing is lost compared with
+ * the CSV file.
+ */
+class CompressedFile : public OutputSink {
+private:
+  struct Compressed {
+    std::vector<unsigned char> data;
+    CompressedBlock block;
+  };
+
+  std::ofstream file;
+  std::uint64_t columnCount;
+  std::vector<std::uint64_t> timeSteps;
+  std::vector<std::vector<double>> columns;
+  std::uint64_t segmentIndex;
+  std::uint64_t triggerTimeStep;
+  std::deque<std::future<Compressed>> inFlight;
+  std::vector<CompressedBlock> index;
+  const std::size_t maxInFlight;
+
+  auto flush() -> void;
+  auto writeOldest() -> void;
+
+public:
+  CompressedFile(const std::string& filename);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto segment(std::size_t index,
+	       std::size_t triggerTimeStep) -> void override;
+  auto end() -> void override;
+  virtual ~CompressedFile() = default;
+};
+
+//===================================================================
+
+/**
+ * Reads a file written by CompressedFile, only decompressing the
+ * blocks that are needed
+ */
+class CompressedReader {
+private:
+  std::ifstream file;
+  std::string headings;
+  std::uint64_t columnCount;
+  std::vector<CompressedBlock> index;
+
+public:
+  CompressedReader(const std::string& filename);
+  auto getHeadings() const -> const std::string& {
+    return headings;
+  }
+  auto getIndex() const -> const std::vector<CompressedBlock>& {
+    return index;
+  }
+  auto read(double fromTime, double toTime, OutputSink& sink) -> void;
+};
@@ -0,0 +1,131 @@
+/**
+ * Event driven simulation of the digital logic
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "DigitalLogic.h"
+
+using namespace std;
+
+/**
+ * Parse the logic timing.  "typical" is the typical 74HC delays,
+ * otherwise it is flipFlopNs:switchOnNs:switchOffNs.
+ *
+ * @param specification timing specification
+ * @return the timing
+ */
+auto LogicTiming::parse(const string& specification) -> LogicTiming {
+  if (specification == "typical") {
+    return {DEFAULT_FLIP_FLOP_DELAY,
+	    DEFAULT_SWITCH_ON_DELAY,
+	    DEFAULT_SWITCH_OFF_DELAY};
+  }
+
+  auto stream = istringstream{specification};
+  auto parts = vector<floating>{};
+  auto part = string{};
+  try {
+    while (getline(stream, part, ':')) {
+      parts.push_back(stold(part) * 1e-9);
+    }
+  }
+  catch (const logic_error&) {
+    parts.clear();
+  }
+  if (parts.size() != 3 ||
+      *min_element(parts.begin(), parts.end()) < 0) {
+    cout << "Bad logic timing " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+  return {parts[0], parts[1], parts[2]};
+}
+
+//===================================================================
+
+/**
+ * Add a net
+ *
+ * @param value its starting level
+ * @return the net
+ */
+auto LogicSimulator::addNet(bool value) -> size_t {
+  nets.push_back(value);
+  watchers.emplace_back();
+  return nets.size() - 1;
+}
+
+/**
+ * Call a function whenever a net changes
+ *
+ * @param net the net
+ * @param watcher gets the time of the change
+ */
+auto LogicSimulator::watch(size_t net, Watcher watcher) -> void {
+  watchers.at(net).push_back(move(watcher));
+}
+
+/**
+ * Set a net to a level at some time
+ *
+ * @param net the net
+ * @param value new level
+ * @param time when it changes, in time steps
+ */
+auto LogicSimulator::schedule(size_t net, bool value, floating time) -> void {
+  events.push(LogicEvent{time, sequence++, net, value});
+}
+
+/**
+ * Get the time of the next change
+ *
+ * @return time in time steps, infinity if nothing is scheduled
+ */
+auto LogicSimulator::nextEventTime() const -> floating {
+  return events.empty() ? numeric_limits<floating>::infinity() :
+    events.top().time;
+}
+
+/**
+ * Make all the changes up to and including a time, in time order,
+ * including any that the watchers schedule as they go
+ *
+ * @param until time in time steps
+ */
+auto LogicSimulator::run(floating until) -> void {
+  while (!events.empty() && events.top().time <= until) {
+    const auto event = events.top();
+    events.pop();
+    if (nets[event.net] == event.value) {
+      continue;
+    }
+    nets[event.net] = event.value;
+    for (auto&& watcher : watchers[event.net]) {
+      watcher(event.time);
+    }
+  }
+}
@@ -0,0 +1,103 @@
+/**
+ * Event driven simulation of the digital logic
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+#include "misc.h"
+
+// Typical 74HC74 clock to output delay at 4.5 volts
+constexpr auto DEFAULT_FLIP_FLOP_DELAY = floating{14e-9};
+
+// Typical 74HC4052 select to switch on and switch off delays at 4.5
+// volts.  Off is quicker than on, so the switch breaks before it
+// makes.
+constexpr auto DEFAULT_SWITCH_ON_DELAY = floating{22e-9};
+constexpr auto DEFAULT_SWITCH_OFF_DELAY = floating{18e-9};
+
+/**
+ * Propagation delays of the digital logic, in seconds
+ */
+struct LogicTiming {
+  floating flipFlopDelay;
+  floating switchOnDelay;
+  floating switchOffDelay;
+
+  static auto parse(const std::string& specification) -> LogicTiming;
+};
+
+//===================================================================
+
+/**
+ * A change to a net that is waiting to happen.  Changes scheduled for
+ * the same time happen in the order they were scheduled.
+ */
+struct LogicEvent {
+  floating time;
+  std::uint64_t sequence;
+  std::size_t net;
+  bool value;
+
+  auto operator>(const LogicEvent& other) const -> bool {
+    return time != other.time ? time > other.time :
+      sequence > other.sequence;
+  }
+};
+
+/**
+ * A minimal discrete event simulator for digital logic.  Each net is
+ * a logic level.  Gates are functions watching the nets they take as
+ * inputs, which schedule changes to their outputs after their
+ * propagation delay, and the changes wait in a priority queue until
+ * their time comes.  Times are in time steps, and needn't be whole
+ * numbers.
+ */
+class LogicSimulator {
+private:
+  using Watcher = std::function<auto (floating time) -> void>;
+
+  std::vector<bool> nets;
+  std::vector<std::vector<Watcher>> watchers;
+  std::priority_queue<LogicEvent,
+		      std::vector<LogicEvent>,
+		      std::greater<LogicEvent>> events;
+  std::uint64_t sequence = 0;
+
+public:
+  auto addNet(bool value = false) -> std::size_t;
+  auto get(std::size_t net) const -> bool {
+    return nets[net];
+  }
+  auto watch(std::size_t net, Watcher watcher) -> void;
+  auto schedule(std::size_t net, bool value, floating time) -> void;
+  auto nextEventTime() const -> floating;
+  auto run(floating until) -> void;
+};
@@ -0,0 +1,126 @@
+/**
+ * Fast Fourier transform
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include "Fft.h"
+
+using namespace std;
+
+/**
+ * Get the smallest power of two that is at least the given value
+ *
+ * @param value value
+ * @return power of two
+ */
+auto nextPowerOfTwo(size_t value) -> size_t {
+  auto power = size_t{1};
+  while (power < value) {
+    power <<= 1;
+  }
+  return power;
+}
+
+/**
+ * In place radix 2 FFT.  The inverse transform is scaled by 1/N, so
+ * that the forward transform followed by the inverse transform gives
+ * back the original data.
+ *
+ * @param data data to transform, whose size must be a power of two
+ * @param inverse true for the inverse transform
+ */
+auto fft(vector<complex<double>>& data, bool inverse) -> void {
+  const auto size = data.size();
+  if (size & (size - 1)) {
+    cout << "FFT size " << size << " is not a power of two" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // Bit reversal permutation
+  for (auto i = size_t{1}, j = size_t{0}; i < size; i++) {
+    auto bit = size >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      swap(data[i], data[j]);
+    }
+  }
+
+  // Butterflies
+  for (auto length = size_t{2}; length <= size; length <<= 1) {
+    const auto angle = (inverse ? 2 : -2) * M_PI / length;
+    const auto twiddleStep = polar(1.0, angle);
+    for (auto start = size_t{0}; start < size; start += length) {
+      auto twiddle = complex<double>{1};
+      for (auto k = size_t{0}; k < length / 2; k++) {
+	const auto even = data[start + k];
+	const auto odd = data[start + k + length / 2] * twiddle;
+	data[start + k] = even + odd;
+	data[start + k + length / 2] = even - odd;
+	twiddle *= twiddleStep;
+      }
+    }
+  }
+
+  if (inverse) {
+    for (auto&& value : data) {
+      value /= static_cast<double>(size);
+    }
+  }
+}
+
+/**
+ * Get the magnitude spectrum of a real signal.  The mean is removed
+ * and a Hann window applied first, and the signal is padded with
+ * zeroes up to a power of two.
+ *
+ * @param samples signal
+ * @return magnitudes of the bins from DC up to half the sample rate
+ */
+auto magnitudeSpectrum(const vector<double>& samples) -> vector<double> {
+  if (samples.empty()) {
+    return {};
+  }
+  const auto count = samples.size();
+  const auto mean = accumulate(samples.begin(), samples.end(), 0.0) / count;
+
+  auto data = vector<complex<double>>(nextPowerOfTwo(count));
+  for (auto index = size_t{0}; index < count; index++) {
+    const auto window = count > 1 ?
+      0.5 - 0.5 * cos(2 * M_PI * index / (count - 1)) : 1.0;
+    data[index] = (samples[index] - mean) * window;
+  }
+  fft(data);
+
+  auto magnitudes = vector<double>(data.size() / 2 + 1);
+  for (auto bin = size_t{0}; bin < magnitudes.size(); bin++) {
+    magnitudes[bin] = abs(data[bin]);
+  }
+  return magnitudes;
+}
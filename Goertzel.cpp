@@ -0,0 +1,92 @@
+/**
+ * Streaming single frequency DFT
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include "Goertzel.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ *
+ * @param frequencyHz frequency to detect
+ * @param sampleRateHz rate at which samples are added
+ */
+Goertzel::Goertzel(floating frequencyHz, floating sampleRateHz) :
+  radians{2 * M_PI * frequencyHz / sampleRateHz},
+  coefficient{2 * cos(radians)} {}
+
+/**
+ * Add the next sample
+ *
+ * @param sample signal value
+ * @param weight window weight for this sample
+ */
+auto Goertzel::add(floating sample, floating weight) -> void {
+  auto state0 = weight * sample + coefficient * state1 - state2;
+  state2 = state1;
+  state1 = state0;
+  weights += weight;
+  count++;
+}
+
+/**
+ * Get the DFT bin for the samples so far, divided by the sum of the
+ * weights.  A complex exponential of amplitude A at the frequency
+ * gives A times its phase at the first sample.
+ *
+ * @return the bin
+ */
+auto Goertzel::getBin() const -> complex<floating> {
+  if (count == 0) {
+    return {};
+  }
+  // The recurrence leaves the sum rotated to the last sample
+  auto rotated = complex<floating>{state1 - cos(radians) * state2,
+				   sin(radians) * state2};
+  return rotated * polar(floating{1}, -radians * (count - 1)) / weights;
+}
+
+/**
+ * Get the amplitude of a real sinusoid at the frequency
+ *
+ * @return the amplitude
+ */
+auto Goertzel::getAmplitude() const -> floating {
+  // A real sinusoid puts half its amplitude in each of the positive
+  // and negative frequency bins, apart from at 0 Hz
+  return radians == 0 ? abs(getBin()) : 2 * abs(getBin());
+}
+
+/**
+ * Start again with no samples
+ */
+auto Goertzel::reset() -> void {
+  state1 = 0;
+  state2 = 0;
+  weights = 0;
+  count = 0;
+}
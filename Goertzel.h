@@ -0,0 +1,55 @@
+/**
+ * Streaming single frequency DFT
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include "misc.h"
+
+/**
+ * Goertzel detector.  It works out one bin of the discrete Fourier
+ * transform of a signal as the samples arrive, without keeping them,
+ * for far less work than an FFT when only one frequency matters.
+ * Each sample can be weighted, so that a window function can be
+ * applied as it goes.
+ */
+class Goertzel {
+private:
+  floating radians;
+  floating coefficient;
+  floating state1 = 0;
+  floating state2 = 0;
+  floating weights = 0;
+  std::size_t count = 0;
+
+public:
+  Goertzel(floating frequencyHz, floating sampleRateHz);
+  auto add(floating sample, floating weight = 1) -> void;
+  auto getBin() const -> std::complex<floating>;
+  auto getAmplitude() const -> floating;
+  auto reset() -> void;
+};
@@ -24,13 +24,35 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <iostream>
-#include <fstream>
+#include <sstream>
 #include "Mixer.h"
 #include "Signal.h"
+#include "Butterworth.h"
+#include "Trace.h"
 
 using namespace std;
 
+// Entries in the DataLine struct
+constexpr auto INDEX_SIGNAL = size_t{0};
+constexpr auto INDEX_LOCAL_OSC = size_t{1};
+constexpr auto INDEX_MODULATION = size_t{2};
+constexpr auto INDEX_INPHASE = size_t{3};
+constexpr auto INDEX_QUADRATURE = size_t{4};
+constexpr auto INDEX_FILTERED_INPHASE = size_t{5};
+constexpr auto INDEX_FILTERED_QUADRATURE = size_t{6};
+constexpr auto INDEX_DEMODULATED = size_t{7};
+
+// Column headings, less any ADC columns
+static const auto HEADINGS = "timesteps, time, signal, localOsc, "
+  "modulation, inphase, quadrature, filteredInphase, "
+  "filteredQuadrature, demodulated"s;
+
+// Time steps that the fused engine works on in one go.  The block
+// buffers come to about 300 kB, so they stay in the cache.
+constexpr auto FUSED_BLOCK_SIZE = size_t{4096};
+
 //===================================================================
 
 /**
@@ -39,7 +61,18 @@ using namespace std;
  * @param lpFreqHz low pass filter cutoff frequency
  */
 IqMixer::IqMixer(const floating lpFreqHz) :
-  lpFreqHz{lpFreqHz} {}
+  lpFreqHz{lpFreqHz}, fused{false} {}
+
+/**
+ * Use the fused engine, which does everything in one pass over the
+ * run and keeps only the lines that are written.  It is not used
+ * with the ADC, which needs every time step.
+ *
+ * @param enable true to use the fused engine
+ */
+auto IqMixer::setFused(bool enable) -> void {
+  fused = enable;
+}
 
 //===================================================================
 
@@ -57,27 +90,74 @@ auto IqMixer::run(const string& outputFilename,
 		  size_t cycleCount,
 		  const Signal& signal,
 		  floating phaseAngleDeg) -> void {
+  writeResults(outputFilename,
+	       describe(cycleCount, signal, phaseAngleDeg),
+	       [&](OutputSink& file) {
+		 run(file, cycleCount, signal, phaseAngleDeg);
+	       });
+}
+
+/**
+ * Describe a run exactly, for the result cache
+ *
+ * @param cycleCount number of carrier cycles to simulate
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ * @return description
+ */
+auto IqMixer::describe(size_t cycleCount,
+		       const Signal& signal,
+		       floating phaseAngleDeg) const -> string {
+  auto stream = ostringstream{};
+  stream << hexfloat
+	 << "iqmixer " << cycleCount << " " << phaseAngleDeg << "\n"
+	 << "lowpass " << lpFreqHz << "\n"
+	 << (fused && !adc ? "fused\n" : "")
+	 << describeOptions() << signal.describe();
+  return stream.str();
+}
+
+/**
+ * This simulates a conventional multiplying IQ mixer, passing the
+ * results to an output sink rather than a file.
+ *
+ * @param output where the results go
+ * @param cycleCount number of carrier cycles to simulate
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ */
+auto IqMixer::run(OutputSink& output,
+		  size_t cycleCount,
+		  const Signal& signal,
+		  floating phaseAngleDeg) -> void {
+  auto trace = TraceScope{"IqMixer::run"};
+
+  if (fused && !adc) {
+    runFused(output, cycleCount, signal, phaseAngleDeg);
+    return;
+  }
 
-  cout << "Writing " << outputFilename << endl;
   reset();
   
-  const auto headings = "timesteps, time, signal, localOsc, "
-    "modulation, inphase, quadrature, filteredInphase, "
-    "filteredQuadrature, demodulated"s;
-
-  constexpr auto INDEX_SIGNAL = size_t{0};
-  constexpr auto INDEX_LOCAL_OSC = size_t{1};
-  constexpr auto INDEX_MODULATION = size_t{2};
-  constexpr auto INDEX_INPHASE = size_t{3};
-  constexpr auto INDEX_QUADRATURE = size_t{4};
-  constexpr auto INDEX_FILTERED_INPHASE = size_t{5};
-  constexpr auto INDEX_FILTERED_QUADRATURE = size_t{6};
-  constexpr auto INDEX_DEMODULATED = size_t{7};
-  
+  const auto headings = HEADINGS + adcHeadings();
+
   // Add a few extra cycles to let the simulation stabilise
   cycleCount += EXTRA_CYCLES;
 
   auto timeStepsPerCarrierCycle = signal.getTimeStepsPerCarrierCycle(0);
+
+  // Whole number of time steps in each carrier cycle
+  auto timeStepsPerCycle = size_t{0};
+  for (auto timeStep = decltype(timeStepsPerCarrierCycle){1};
+       timeStep <= timeStepsPerCarrierCycle; timeStep++) {
+    timeStepsPerCycle++;
+  }
+  startTelemetry(headings, cycleCount * timeStepsPerCycle);
+
+  // The whole run's signal, if it comes from the waveform cache
+  auto waveform = getWaveform(signal, cycleCount * timeStepsPerCycle);
     
   auto totalTimeSteps = size_t{0};
 
@@ -87,15 +167,49 @@ auto IqMixer::run(const string& outputFilename,
 				signal.getModFreqHz(0),
 				-phaseAngleDeg};
 
+  // Noise on the RF signal, and timing jitter on the local oscillator
+  auto signalNoise = optional<NoiseSource>{};
+  auto jitterNoise = optional<GaussianNoise>{};
+  if (noise && noise->rmsVolts) {
+    signalNoise.emplace(*noise, NOISE_STREAM_SIGNAL);
+  }
+  if (noise && noise->jitterSeconds) {
+    jitterNoise.emplace(noise->seed, NOISE_STREAM_LOCAL_OSCILLATOR);
+  }
+
+  // The signal is synthesised a block at a time, which is much cheaper
+  // than one time step at a time for a crowded band
+  const auto runTimeSteps = cycleCount * timeStepsPerCycle;
+  auto signalBlock = vector<floating>(FUSED_BLOCK_SIZE);
+
   for (auto cycles = decltype(cycleCount){0}; cycles < cycleCount; cycles++) {
     for (auto timeStep = decltype(timeStepsPerCarrierCycle){1};
 	 timeStep <= timeStepsPerCarrierCycle; timeStep++) {
 
       totalTimeSteps++;
-      auto signalVoltage = signal.getTotalSignal(totalTimeSteps);
+      const auto index = (totalTimeSteps - 1) % FUSED_BLOCK_SIZE;
+      if (!waveform && index == 0) {
+	signal.synthesise(totalTimeSteps,
+			  min(FUSED_BLOCK_SIZE,
+			      runTimeSteps - totalTimeSteps + 1),
+			  signalBlock.data());
+      }
+      auto signalVoltage = waveform ? (*waveform)[totalTimeSteps - 1] :
+	signalBlock[index];
       auto localOscRadians = localOscillator.getRadians(0, totalTimeSteps);
 
-      auto dataLine = unique_ptr<DataLine>{new DataLine(INDEX_DEMODULATED + 1,
+      if (signalNoise) {
+	signalNoise->add(totalTimeSteps, 1, &signalVoltage);
+      }
+      if (jitterNoise) {
+	auto jitter = double{0};
+	jitterNoise->generate(totalTimeSteps, 1, &jitter);
+	localOscRadians += 2.0 * M_PI * noise->jitterSeconds * jitter /
+	  (TIME_STEP_SIZE * timeStepsPerCarrierCycle);
+      }
+
+      auto dataLine = unique_ptr<DataLine>{new DataLine(INDEX_DEMODULATED + 1 +
+							adcColumnCount(),
 							totalTimeSteps)};
       dataLine->fields.at(INDEX_SIGNAL) = signalVoltage;
       dataLine->fields.at(INDEX_LOCAL_OSC) = localOscRadians;
@@ -103,6 +217,7 @@ auto IqMixer::run(const string& outputFilename,
       dataLine->fields.at(INDEX_INPHASE) = signalVoltage * sin(localOscRadians);
       dataLine->fields.at(INDEX_QUADRATURE) = signalVoltage * cos(localOscRadians);
 
+      publish(*dataLine);
       add(dataLine);
     }
   }
@@ -117,6 +232,259 @@ auto IqMixer::run(const string& outputFilename,
 	  INDEX_FILTERED_QUADRATURE,
 	  INDEX_DEMODULATED);
 
-  outputData(outputFilename, headings, timeStepsPerCarrierCycle);  
+  // The sound card digitises the filtered mixer outputs, as the
+  // ZetaSDR's comes after its detector capacitors
+  if (adc) {
+    adcBaseband(INDEX_FILTERED_INPHASE, INDEX_FILTERED_QUADRATURE,
+		INDEX_DEMODULATED + 1);
+  }
+
+  outputData(output, headings, timeStepsPerCarrierCycle);
 }
 
+
+//===================================================================
+
+/**
+ * The fused engine.  Each block of time steps is synthesised, mixed,
+ * filtered and checked for the demodulator's DC offsets while it is
+ * still in the cache, and only the lines that are to be written are
+ * kept.  With a triggered capture that can be streamed, only the
+ * lines that it captures are kept.
+ *
+ * The results are the same as the normal engine's apart from the
+ * demodulated column.  The normal engine removes the mean over every
+ * time step, but this one estimates it from one time step every
+ * OUTPUT_RESOLUTION, so the demodulated column is shifted by a tiny
+ * DC level.
+ *
+ * @param output where the results go
+ * @param cycleCount number of carrier cycles to simulate
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ */
+auto IqMixer::runFused(OutputSink& output,
+		       size_t cycleCount,
+		       const Signal& signal,
+		       floating phaseAngleDeg) -> void {
+
+  reset();
+
+  // Add a few extra cycles to let the simulation stabilise
+  cycleCount += EXTRA_CYCLES;
+
+  auto timeStepsPerCarrierCycle = signal.getTimeStepsPerCarrierCycle(0);
+
+  // Whole number of time steps in each carrier cycle
+  auto timeStepsPerCycle = size_t{0};
+  for (auto timeStep = decltype(timeStepsPerCarrierCycle){1};
+       timeStep <= timeStepsPerCarrierCycle; timeStep++) {
+    timeStepsPerCycle++;
+  }
+  const auto totalTimeSteps = cycleCount * timeStepsPerCycle;
+  startTelemetry(HEADINGS, totalTimeSteps);
+
+  // Local oscillator is phaseAngle behind carrier
+  auto localOscillator = Signal{signal.getCarrierAmplitude(0),
+				signal.getCarrierFreqHz(0),
+				signal.getModFreqHz(0),
+				-phaseAngleDeg};
+
+  // Noise on the RF signal, and timing jitter on the local oscillator
+  auto signalNoise = optional<NoiseSource>{};
+  auto jitterNoise = optional<GaussianNoise>{};
+  if (noise && noise->rmsVolts) {
+    signalNoise.emplace(*noise, NOISE_STREAM_SIGNAL);
+  }
+  if (noise && noise->jitterSeconds) {
+    jitterNoise.emplace(noise->seed, NOISE_STREAM_LOCAL_OSCILLATOR);
+  }
+
+  auto inphaseFilter = optional<Butterworth>{};
+  auto quadratureFilter = optional<Butterworth>{};
+  if (lpFreqHz) {
+    inphaseFilter.emplace(2, lpFreqHz, false);
+    quadratureFilter.emplace(2, lpFreqHz, false);
+  }
+
+  auto waveform = getWaveform(signal, totalTimeSteps);
+  auto signalBlock = vector<floating>(FUSED_BLOCK_SIZE);
+  auto localOscBlock = vector<floating>(FUSED_BLOCK_SIZE);
+  auto jitterBlock = vector<double>(FUSED_BLOCK_SIZE);
+  auto inphaseBlock = vector<floating>(FUSED_BLOCK_SIZE);
+  auto quadratureBlock = vector<floating>(FUSED_BLOCK_SIZE);
+  auto filterInput = vector<double>(FUSED_BLOCK_SIZE);
+  auto filteredInphase = vector<double>(FUSED_BLOCK_SIZE);
+  auto filteredQuadrature = vector<double>(FUSED_BLOCK_SIZE);
+
+  // The demodulator's DC offsets come from the minima over the whole
+  // run, and its mean from a sample every OUTPUT_RESOLUTION
+  auto demodulator = RunningDemodulator{totalTimeSteps};
+
+  auto decimation = OutputDecimation{timeStepsPerCarrierCycle};
+  streamCapture(HEADINGS, timeStepsPerCarrierCycle);
+
+  for (auto first = size_t{1}; first <= totalTimeSteps;
+       first += FUSED_BLOCK_SIZE) {
+    const auto count = min(FUSED_BLOCK_SIZE, totalTimeSteps + 1 - first);
+
+    if (telemetry) {
+      telemetry->progress(first - 1);
+    }
+
+    if (waveform) {
+      copy_n(waveform->begin() + (first - 1), count, signalBlock.begin());
+    }
+    else {
+      signal.synthesise(first, count, signalBlock.data());
+    }
+    if (signalNoise) {
+      signalNoise->add(first, count, signalBlock.data());
+    }
+    if (jitterNoise) {
+      jitterNoise->generate(first, count, jitterBlock.data());
+    }
+
+    for (auto index = size_t{0}; index < count; index++) {
+      auto localOscRadians = localOscillator.getRadians(0, first + index);
+      if (jitterNoise) {
+	localOscRadians += 2.0 * M_PI * noise->jitterSeconds *
+	  jitterBlock[index] / (TIME_STEP_SIZE * timeStepsPerCarrierCycle);
+      }
+      localOscBlock[index] = localOscRadians;
+      inphaseBlock[index] = signalBlock[index] * sin(localOscRadians);
+      quadratureBlock[index] = signalBlock[index] * cos(localOscRadians);
+    }
+
+    if (inphaseFilter) {
+      for (auto index = size_t{0}; index < count; index++) {
+	filterInput[index] = static_cast<double>(inphaseBlock[index]);
+      }
+      inphaseFilter->apply(filterInput.data(), filteredInphase.data(), count);
+      for (auto index = size_t{0}; index < count; index++) {
+	filterInput[index] = static_cast<double>(quadratureBlock[index]);
+      }
+      quadratureFilter->apply(filterInput.data(),
+			      filteredQuadrature.data(), count);
+    }
+
+    for (auto index = size_t{0}; index < count; index++) {
+      const auto timeStep = first + index;
+      const auto inphase = inphaseFilter ?
+	static_cast<floating>(filteredInphase[index]) : inphaseBlock[index];
+      const auto quadrature = quadratureFilter ?
+	static_cast<floating>(filteredQuadrature[index]) :
+	quadratureBlock[index];
+
+      demodulator.add(timeStep, inphase, quadrature);
+
+      // The lines written and the lines published fall on different
+      // time steps
+      const auto selected = decimation.select(timeStep);
+      if (selected || (telemetry && timeStep % TELEMETRY_STEP == 0)) {
+	auto dataLine = unique_ptr<DataLine>{new DataLine(INDEX_DEMODULATED + 1,
+							  timeStep)};
+	dataLine->fields.at(INDEX_SIGNAL) = signalBlock[index];
+	dataLine->fields.at(INDEX_LOCAL_OSC) = localOscBlock[index];
+	dataLine->fields.at(INDEX_MODULATION) = signal.getAmplitude(0, timeStep);
+	dataLine->fields.at(INDEX_INPHASE) = inphaseBlock[index];
+	dataLine->fields.at(INDEX_QUADRATURE) = quadratureBlock[index];
+	dataLine->fields.at(INDEX_FILTERED_INPHASE) = inphase;
+	dataLine->fields.at(INDEX_FILTERED_QUADRATURE) = quadrature;
+	publish(*dataLine);
+	if (selected) {
+	  keep(dataLine);
+	}
+      }
+    }
+  }
+
+  // Demodulate the lines to be written, in the same way as amDemod
+  demodulator.apply(results, INDEX_FILTERED_INPHASE,
+		    INDEX_FILTERED_QUADRATURE, INDEX_DEMODULATED);
+
+  outputData(output, HEADINGS, timeStepsPerCarrierCycle);
+}
+
+//===================================================================
+
+/**
+ * Run the mixer and the low pass filters for a measurement, passing
+ * the filtered outputs to a probe a block at a time until it has seen
+ * enough.  Nothing is kept, so a measurement can run for as long as
+ * it needs to.
+ *
+ * @param probe gets the filtered outputs, and says when to stop
+ * @param maxTimeSteps stop after this many time steps anyway
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ * @return number of time steps simulated
+ */
+auto IqMixer::measure(BasebandProbe& probe,
+		      size_t maxTimeSteps,
+		      const Signal& signal,
+		      floating phaseAngleDeg) -> size_t {
+  auto timeStepsPerCarrierCycle = signal.getTimeStepsPerCarrierCycle(0);
+
+  // Local oscillator is phaseAngle behind carrier
+  auto localOscillator = Signal{signal.getCarrierAmplitude(0),
+				signal.getCarrierFreqHz(0),
+				signal.getModFreqHz(0),
+				-phaseAngleDeg};
+
+  auto signalNoise = optional<NoiseSource>{};
+  auto jitterNoise = optional<GaussianNoise>{};
+  if (noise && noise->rmsVolts) {
+    signalNoise.emplace(*noise, NOISE_STREAM_SIGNAL);
+  }
+  if (noise && noise->jitterSeconds) {
+    jitterNoise.emplace(noise->seed, NOISE_STREAM_LOCAL_OSCILLATOR);
+  }
+
+  auto inphaseFilter = Butterworth{2, lpFreqHz, false};
+  auto quadratureFilter = Butterworth{2, lpFreqHz, false};
+
+  auto signalBlock = vector<floating>(FUSED_BLOCK_SIZE);
+  auto jitterBlock = vector<double>(FUSED_BLOCK_SIZE);
+  auto inphase = vector<double>(FUSED_BLOCK_SIZE);
+  auto quadrature = vector<double>(FUSED_BLOCK_SIZE);
+  auto filteredInphase = vector<double>(FUSED_BLOCK_SIZE);
+  auto filteredQuadrature = vector<double>(FUSED_BLOCK_SIZE);
+
+  for (auto first = size_t{1}; first <= maxTimeSteps;
+       first += FUSED_BLOCK_SIZE) {
+    const auto count = min(FUSED_BLOCK_SIZE, maxTimeSteps + 1 - first);
+
+    signal.synthesise(first, count, signalBlock.data());
+    if (signalNoise) {
+      signalNoise->add(first, count, signalBlock.data());
+    }
+    if (jitterNoise) {
+      jitterNoise->generate(first, count, jitterBlock.data());
+    }
+
+    for (auto index = size_t{0}; index < count; index++) {
+      auto localOscRadians = localOscillator.getRadians(0, first + index);
+      if (jitterNoise) {
+	localOscRadians += 2.0 * M_PI * noise->jitterSeconds *
+	  jitterBlock[index] / (TIME_STEP_SIZE * timeStepsPerCarrierCycle);
+      }
+      inphase[index] =
+	static_cast<double>(signalBlock[index] * sin(localOscRadians));
+      quadrature[index] =
+	static_cast<double>(signalBlock[index] * cos(localOscRadians));
+    }
+
+    inphaseFilter.apply(inphase.data(), filteredInphase.data(), count);
+    quadratureFilter.apply(quadrature.data(), filteredQuadrature.data(),
+			   count);
+
+    if (!probe.observe(first, count, filteredInphase.data(),
+		       filteredQuadrature.data())) {
+      return first + count - 1;
+    }
+  }
+  return maxTimeSteps;
+}
@@ -25,11 +25,18 @@
  */
 
 #include <algorithm>
-#include <rtf_common.h>
+#include <cmath>
 #include <iostream>
-#include <fstream>
+#include <limits>
+#include <sstream>
+#include "Baseband.h"
+#include "Butterworth.h"
+#include "Compressed.h"
 #include "Mixer.h"
+#include "Plot.h"
+#include "Statistics.h"
 #include "Signal.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -50,22 +57,10 @@ auto Mixer::butterworth(size_t inputIndex,
 			unsigned poles,
 			floating cutoffHz,
 			bool highPass) -> void {
+  auto trace = TraceScope{"Mixer::butterworth"};
 
   if (cutoffHz) {
-    const auto normalisedCutoffFreq = 
-      cutoffHz * static_cast<floating>(TIME_STEP_SIZE);
-
-    auto filter =
-      hfilter{rtf_create_butterworth(1,
-				     RTF_DOUBLE,
-				     static_cast<double>(normalisedCutoffFreq),
-				     poles,
-				     static_cast<int>(highPass))};
-
-    if (filter == nullptr) {
-      cout << "Unable to create low pass filter" << endl;
-      exit(EXIT_FAILURE);
-    }
+    auto filter = Butterworth{poles, cutoffHz, highPass};
    
     auto size = results.size();
     auto inputVector = vector<double>{};
@@ -79,8 +74,7 @@ auto Mixer::butterworth(size_t inputIndex,
       outputVector.push_back(0.);
     }
     
-    rtf_filter(filter, inputVector.data(), outputVector.data(), size);
-    rtf_destroy_filter(filter);
+    filter.apply(inputVector.data(), outputVector.data(), size);
     
     auto index = size_t{0};
     for (auto&& dataLine : results) {
@@ -111,6 +105,7 @@ auto Mixer::butterworth(size_t inputIndex,
 auto Mixer::amDemod(size_t inphaseIndex,
 		    size_t quadratureIndex,
 		    size_t demodulatedOutputIndex) -> void {
+  auto trace = TraceScope{"Mixer::amDemod"};
 
   // Dealing with the signs is a bit problematic.  The easiest solution
   // is to add a DC offset so that all the I and Q values are positive
@@ -152,6 +147,329 @@ auto Mixer::amDemod(size_t inphaseIndex,
 
 //===================================================================
 
+/**
+ * Digitise the I/Q signal with the sound card ADC and put it through
+ * the fixed point baseband processing.  Each ADC sample is held until
+ * the next one, so the five output columns are piecewise constant at
+ * the simulation time step.  The outputs are ADC codes: the raw
+ * inphase and quadrature samples, the filtered inphase and quadrature
+ * samples, and the demodulated signal with its DC level removed.
+ *
+ * @param inphaseIndex index of inphase entry in the DataLine struct
+ * @param quadratureIndex index of the quadrature entry in the 
+ *                        DataLine struct
+ * @param firstOutputIndex index of the first of the five output
+ *                         entries in the DataLine struct
+ */
+auto Mixer::adcBaseband(size_t inphaseIndex,
+			size_t quadratureIndex,
+			size_t firstOutputIndex) -> void {
+  auto trace = TraceScope{"Mixer::adcBaseband"};
+  if (adc->sampleRateHz * TIME_STEP_SIZE > 1) {
+    cout << "ADC sample rate is faster than the simulation" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto inphaseAdc = Adc{*adc};
+  auto quadratureAdc = Adc{*adc};
+  auto inphase = vector<int32_t>{};
+  auto quadrature = vector<int32_t>{};
+  auto samplePeriod = 1 / adc->sampleRateHz;
+
+  for (auto&& dataLine : results) {
+    if (dataLine->timeStamp >= inphase.size() * samplePeriod) {
+      inphase.push_back(inphaseAdc.convert(dataLine->fields.at(inphaseIndex)));
+      quadrature.push_back(quadratureAdc.convert(dataLine->fields.at(quadratureIndex)));
+    }
+  }
+
+  auto clipped = inphaseAdc.getClipCount() + quadratureAdc.getClipCount();
+  if (clipped) {
+    cout << clipped << " ADC samples clipped" << endl;
+  }
+
+  const auto baseband = Baseband{adc->cutoffHz, adc->sampleRateHz, adc->bits};
+  auto filteredInphase = baseband.filter(inphase);
+  auto filteredQuadrature = baseband.filter(quadrature);
+  auto demodulated = baseband.demodulate(filteredInphase, filteredQuadrature);
+  baseband.removeDc(demodulated);
+
+  auto sample = size_t{0};
+  for (auto&& dataLine : results) {
+    while (sample + 1 < inphase.size() &&
+	   dataLine->timeStamp >= (sample + 1) * samplePeriod) {
+      sample++;
+    }
+    auto& fields = dataLine->fields;
+    fields.at(firstOutputIndex) = inphase.at(sample);
+    fields.at(firstOutputIndex + 1) = quadrature.at(sample);
+    fields.at(firstOutputIndex + 2) = filteredInphase.at(sample);
+    fields.at(firstOutputIndex + 3) = filteredQuadrature.at(sample);
+    fields.at(firstOutputIndex + 4) = demodulated.at(sample);
+  }
+}
+
+/**
+ * Get the number of extra columns that the ADC and baseband
+ * processing add
+ *
+ * @return column count, 0 if the ADC isn't simulated
+ */
+auto Mixer::adcColumnCount() const -> size_t {
+  return adc ? 5 : 0;
+}
+
+/**
+ * Get the headings of the extra columns that the ADC and baseband
+ * processing add
+ *
+ * @return headings, with a leading separator, or an empty string if
+ *         the ADC isn't simulated
+ */
+auto Mixer::adcHeadings() const -> string {
+  return adc ? ", adcInphase, adcQuadrature, basebandInphase, "
+    "basebandQuadrature, basebandDemodulated" : "";
+}
+
+/**
+ * Digitise the I/Q signal from now on, adding the ADC and fixed
+ * point baseband columns to the output.
+ *
+ * @param settings ADC characteristics
+ */
+auto Mixer::setAdc(const AdcSettings& settings) -> void {
+  adc = settings;
+}
+
+/**
+ * Stop digitising the I/Q signal
+ */
+auto Mixer::clearAdc() -> void {
+  adc.reset();
+}
+
+/**
+ * Add noise to the RF signal, and jitter to the local oscillator,
+ * from now on
+ *
+ * @param settings noise characteristics
+ */
+auto Mixer::setNoise(const NoiseSettings& settings) -> void {
+  noise = settings;
+}
+
+/**
+ * Go back to noise free signals
+ */
+auto Mixer::clearNoise() -> void {
+  noise.reset();
+}
+
+/**
+ * Reuse the results of earlier runs of the same scenario from now
+ * on, when writing to a file
+ *
+ * @param directory where to keep the cached results
+ */
+auto Mixer::setCache(const string& directory) -> void {
+  cache.emplace(directory);
+}
+
+/**
+ * Always simulate
+ */
+auto Mixer::clearCache() -> void {
+  cache.reset();
+}
+
+/**
+ * Choose between writing the results files as CSV and as compressed
+ * binary files with a block index
+ *
+ * @param enable true for compressed files
+ */
+auto Mixer::setCompressed(bool enable) -> void {
+  compressed = enable;
+}
+
+/**
+ * Write files reduced to what a plot of this width can show, rather
+ * than every line of results.  This takes precedence over compressing
+ * them.
+ *
+ * @param width plot width in pixels, 0 to write every line
+ */
+auto Mixer::setPlotWidth(size_t width) -> void {
+  plotWidth = width;
+}
+
+/**
+ * Write a small file of summary statistics for each run, rather than
+ * the results.  This takes precedence over the other formats.
+ *
+ * @param enable true for statistics files
+ */
+auto Mixer::setStatistics(bool enable) -> void {
+  statistics = enable;
+}
+
+/**
+ * Take the RF signal from a waveform cache from now on, rather than
+ * synthesising it for every run.  The cache can be shared with other
+ * mixers.
+ *
+ * @param cache waveform cache
+ */
+auto Mixer::setWaveformCache(const shared_ptr<WaveformCache>& cache) -> void {
+  waveforms = cache;
+}
+
+/**
+ * Go back to synthesising the RF signal for every run.
+ */
+auto Mixer::clearWaveformCache() -> void {
+  waveforms.reset();
+}
+
+/**
+ * Publish the progress of each run, and samples of some of its
+ * columns, from now on.  The publisher can be shared with other
+ * mixers.
+ *
+ * @param publisher where to publish them
+ */
+auto Mixer::setTelemetry(const shared_ptr<TelemetryPublisher>& publisher)
+  -> void {
+  telemetry = publisher;
+}
+
+/**
+ * Stop publishing the runs
+ */
+auto Mixer::clearTelemetry() -> void {
+  telemetry.reset();
+}
+
+/**
+ * Tell the telemetry viewer, if there is one, that a run is starting
+ *
+ * @param headings the run's column headings
+ * @param totalTimeSteps number of time steps in the run
+ */
+auto Mixer::startTelemetry(const string& headings,
+			   size_t totalTimeSteps) -> void {
+  if (telemetry) {
+    telemetry->beginRun(headings, totalTimeSteps);
+  }
+}
+
+/**
+ * Get the RF signal for a whole run from the waveform cache.
+ *
+ * @param signal signal characteristics
+ * @param timeSteps number of time steps in the run, starting at 1
+ * @return the signal voltages, or an empty pointer if there is no
+ *         waveform cache
+ */
+auto Mixer::getWaveform(const Signal& signal, size_t timeSteps) const
+  -> shared_ptr<const WaveformCache::Waveform> {
+  if (!waveforms) {
+    return {};
+  }
+  return waveforms->get(signal, 1, timeSteps);
+}
+
+//===================================================================
+
+/**
+ * Describe the options that apply to both simulations, exactly, for
+ * the result cache
+ *
+ * @return description
+ */
+auto Mixer::describeOptions() const -> string {
+  auto stream = ostringstream{};
+  stream << hexfloat;
+  if (capture) {
+    stream << "capture " << capture->trigger.column
+	   << " " << static_cast<int>(capture->trigger.mode)
+	   << " " << capture->trigger.level
+	   << " " << capture->trigger.windowStart
+	   << " " << capture->trigger.windowEnd
+	   << " " << capture->preTrigger
+	   << " " << capture->postTrigger
+	   << " " << capture->maxSegments << "\n";
+  }
+  if (adc) {
+    stream << "adc " << adc->bits
+	   << " " << adc->sampleRateHz
+	   << " " << adc->fullScale
+	   << " " << adc->cutoffHz << "\n";
+  }
+  if (noise) {
+    stream << "noise " << noise->rmsVolts
+	   << " " << noise->bandwidthHz
+	   << " " << noise->jitterSeconds
+	   << " " << noise->seed << "\n";
+  }
+  return stream.str();
+}
+
+/**
+ * Write the results of a run to a file, or copy them from the cache
+ * if this exact scenario has been run before
+ *
+ * @param outputFilename output filename
+ * @param description exact description of the scenario
+ * @param simulate runs the simulation, writing to the sink it is given
+ */
+auto Mixer::writeResults(const string& outputFilename,
+			 const string& description,
+			 const function<auto (OutputSink&) -> void>& simulate)
+  -> void {
+  auto trace = TraceScope{"Mixer::writeResults", outputFilename};
+  auto key = description;
+  if (statistics) {
+    key += "format statistics\n";
+  }
+  else if (plotWidth) {
+    key += "format plot " + to_string(plotWidth) + "\n";
+  }
+  else if (compressed) {
+    key += "format compressed\n";
+  }
+  if (cache && cache->fetch(key, outputFilename)) {
+    cout << "Reusing " << outputFilename << " from the cache" << endl;
+    return;
+  }
+
+  cout << "Writing " << outputFilename << endl;
+  if (telemetry) {
+    telemetry->setRunName(outputFilename);
+  }
+  if (statistics) {
+    auto file = StatisticsFile{outputFilename};
+    simulate(file);
+  }
+  else if (plotWidth) {
+    auto file = PlotFile{outputFilename, plotWidth};
+    simulate(file);
+  }
+  else if (compressed) {
+    auto file = CompressedFile{outputFilename};
+    simulate(file);
+  }
+  else {
+    auto file = CsvFile{outputFilename};
+    simulate(file);
+  }
+  if (cache) {
+    cache->store(key, outputFilename);
+  }
+}
+
+//===================================================================
+
 /**
  * Add another DataLine entry to the results list
  *
@@ -161,6 +479,39 @@ auto Mixer::add(unique_ptr<DataLine>& dataLine) -> void {
   results.emplace_back(move(dataLine));
 }
 
+/**
+ * Keep a line of results.  When the run is being streamed through the
+ * triggered capture, it is only kept if it is one of the lines
+ * written and the capture passes it on.
+ *
+ * @param dataLine the line, which is moved from if it is kept
+ */
+auto Mixer::keep(unique_ptr<DataLine>& dataLine) -> void {
+  if (!streamingCapture) {
+    add(dataLine);
+  }
+  else if (streamingDecimation->select(dataLine->timeStep)) {
+    streamingCapture->write(dataLine->timeStep, dataLine->timeStamp,
+			    dataLine->fields);
+  }
+}
+
+/**
+ * Publish a line to the telemetry viewer, if there is one, when it
+ * falls on one of the sampled time steps.  The engines call this as
+ * they work each time step out, whether or not the line is kept, so
+ * the columns worked out after the run are still zero.
+ *
+ * @param dataLine the line
+ */
+auto Mixer::publish(const DataLine& dataLine) -> void {
+  if (telemetry && dataLine.timeStep % TELEMETRY_STEP == 0) {
+    telemetry->sample(dataLine.timeStep, dataLine.timeStamp,
+		      dataLine.fields);
+    telemetry->progress(dataLine.timeStep);
+  }
+}
+
 //===================================================================
 
 /**
@@ -168,47 +519,273 @@ auto Mixer::add(unique_ptr<DataLine>& dataLine) -> void {
  */
 auto Mixer::reset() -> void {
   results.clear();
+  streamingCapture.reset();
+  capturedLines.reset();
+  streamingDecimation.reset();
 }
 
 //===================================================================
 
 /**
- * Write the output file, and deallocate the results list.
+ * Only write the lines around a trigger condition from now on,
+ * rather than the whole run.
  *
- * @param outputFilename output filename
+ * @param settings trigger condition and capture lengths
+ */
+auto Mixer::setCapture(const CaptureSettings& settings) -> void {
+  capture = settings;
+}
+
+/**
+ * Go back to writing the whole run.
+ */
+auto Mixer::clearCapture() -> void {
+  capture.reset();
+}
+
+/**
+ * Find out whether a run can be streamed through the triggered
+ * capture, which needs each line to be tested against the trigger as
+ * soon as it has been worked out.  The demodulated column and the ADC
+ * columns can't be, as they need the whole run.
+ *
+ * @return true if there is a capture that can be streamed
+ */
+auto Mixer::canStreamCapture() const -> bool {
+  return capture && !adc &&
+    (capture->trigger.mode == Trigger::Mode::WINDOW ||
+     capture->trigger.column != "demodulated");
+}
+
+/**
+ * Stream the run through the triggered capture, if it can be, so that
+ * only the capture's ring buffer and the captured lines are kept
+ * rather than the whole run.
+ *
+ * @param headings column headings
+ * @param timeStepsPerCarrierCycle times steps per carrier cycle, for
+ *              excluding the first cycles
+ * @return true if the run is streamed, in which case every line goes
+ *         to keep() and the demodulated column is worked out by a
+ *         RunningDemodulator
+ */
+auto Mixer::streamCapture(const string& headings,
+			  floating timeStepsPerCarrierCycle) -> bool {
+  if (!canStreamCapture()) {
+    return false;
+  }
+  capturedLines = make_unique<CapturedLines>(results);
+  streamingCapture = make_unique<Capture>(*capture, *capturedLines);
+  streamingCapture->begin(headings);
+  streamingDecimation.emplace(timeStepsPerCarrierCycle);
+  return true;
+}
+
+//===================================================================
+
+/**
+ * Pass the results to an output sink, via the triggered capture if
+ * one has been set up.
+ *
+ * @param sink where the results go
  * @param column headings
  * @param timeStepsPerCarrierCycle times steps per carrier cycle, for
  *              excluding the first cycles
  */
-auto Mixer::outputData(const string& outputFilename,
+auto Mixer::outputData(OutputSink& sink,
 		       const string& headings,
 		       floating timeStepsPerCarrierCycle) -> void {
-  auto file = ofstream(outputFilename);
-  file.precision(9);
-  file << scientific << "# " << headings << "\n";  
+  auto trace = TraceScope{"Mixer::outputData"};
+  if (streamingCapture) {
+    streamingCapture->end();
+    capturedLines->replay(sink, headings);
+    streamingCapture.reset();
+    capturedLines.reset();
+    streamingDecimation.reset();
+    return;
+  }
+
+  auto captureSink = unique_ptr<Capture>{};
+  if (capture) {
+    captureSink = make_unique<Capture>(*capture, sink);
+  }
+  auto& output = captureSink ? *captureSink : sink;
+  output.begin(headings);
 
+  auto decimation = OutputDecimation{timeStepsPerCarrierCycle};
+  for (auto&& dataLine : results) {
+    if (decimation.select(dataLine->timeStep)) {
+      output.write(dataLine->timeStep, dataLine->timeStamp, dataLine->fields);
+    }
+  }
+  output.end();
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param timeStepsPerCarrierCycle times steps per carrier cycle, for
+ *              excluding the first cycles
+ */
+Mixer::OutputDecimation::OutputDecimation(floating timeStepsPerCarrierCycle) {
   const auto startTimeStepF = EXTRA_CYCLES * timeStepsPerCarrierCycle;
-  const auto startTimeStep = static_cast<size_t>(startTimeStepF);
+  startTimeStep = static_cast<size_t>(startTimeStepF);
   // Output a result every 100 ns
   auto stepF = floating{OUTPUT_RESOLUTION / TIME_STEP_SIZE};
-  auto step = static_cast<size_t>(stepF);
-  
-  auto started = false;
-  auto oldTimeStep = size_t{0};
+  step = static_cast<size_t>(stepF);
+}
 
-  for (auto&& dataLine : results) {
-    auto timeStep = dataLine->timeStep;
-    if (!started && timeStep >= startTimeStep) {
-      started = true;
-    }
+/**
+ * Decide whether a time step is written.  The time steps must be
+ * passed in increasing order.
+ *
+ * @param timeStep time step
+ * @return true if the time step is to be written
+ */
+auto Mixer::OutputDecimation::select(size_t timeStep) -> bool {
+  if (!started && timeStep >= startTimeStep) {
+    started = true;
+  }
     
-    if (started && timeStep >= oldTimeStep + step) {
-      file << timeStep << "," << dataLine->timeStamp;
-      for (auto&& field : (*dataLine).fields) {
-	file << "," << field;
-      }
-      file << "\n";
-      oldTimeStep = timeStep; 
+  if (started && timeStep >= oldTimeStep + step) {
+    oldTimeStep = timeStep; 
+    return true;
+  }
+  return false;
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param totalTimeSteps number of time steps in the run
+ */
+Mixer::RunningDemodulator::RunningDemodulator(size_t totalTimeSteps) :
+  minI{numeric_limits<floating>::infinity()},
+  minQ{numeric_limits<floating>::infinity()} {
+  auto sampleStepF = floating{OUTPUT_RESOLUTION / TIME_STEP_SIZE};
+  sampleStep = static_cast<size_t>(sampleStepF);
+  sampledInphase.reserve(totalTimeSteps / sampleStep + 1);
+  sampledQuadrature.reserve(totalTimeSteps / sampleStep + 1);
+}
+
+/**
+ * Take in one time step's inphase and quadrature values.  The time
+ * steps must be passed in increasing order.
+ *
+ * @param timeStep time step
+ * @param inphase inphase value
+ * @param quadrature quadrature value
+ */
+auto Mixer::RunningDemodulator::add(size_t timeStep,
+				    floating inphase,
+				    floating quadrature) -> void {
+  minI = min(minI, inphase);
+  minQ = min(minQ, quadrature);
+  if (timeStep % sampleStep == 0) {
+    sampledInphase.push_back(inphase);
+    sampledQuadrature.push_back(quadrature);
+  }
+}
+
+/**
+ * Demodulate the lines that were kept, once the whole run has been
+ * taken in
+ *
+ * @param lines the lines
+ * @param inphaseIndex index of inphase entry in the DataLine struct
+ * @param quadratureIndex index of the quadrature entry in the
+ *                        DataLine struct
+ * @param demodulatedIndex index of the demodulated output entry in
+ *                         the DataLine struct
+ */
+auto Mixer::RunningDemodulator::apply(list<unique_ptr<DataLine>>& lines,
+				      size_t inphaseIndex,
+				      size_t quadratureIndex,
+				      size_t demodulatedIndex) const -> void {
+  const auto offsetI = (minI < 0) ? - minI : 0;
+  const auto offsetQ = (minQ < 0) ? - minQ : 0;
+
+  auto demodulate = [&](floating inphase, floating quadrature) {
+    auto inphaseValue = inphase + offsetI;
+    auto quadratureValue = quadrature + offsetQ;
+    return sqrt(quadratureValue * quadratureValue +
+		inphaseValue * inphaseValue);
+  };
+
+  auto meanValue = floating{0};
+  for (auto index = size_t{0}; index < sampledInphase.size(); index++) {
+    meanValue += demodulate(sampledInphase[index], sampledQuadrature[index]);
+  }
+  if (!sampledInphase.empty()) {
+    meanValue = meanValue / sampledInphase.size();
+  }
+
+  for (auto&& dataLine : lines) {
+    dataLine->fields.at(demodulatedIndex) =
+      demodulate(dataLine->fields.at(inphaseIndex),
+		 dataLine->fields.at(quadratureIndex)) - meanValue;
+  }
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param lines where the captured lines go
+ */
+Mixer::CapturedLines::CapturedLines(list<unique_ptr<DataLine>>& lines) :
+  lines{lines} {}
+
+/**
+ * Keep a captured line
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto Mixer::CapturedLines::write(size_t timeStep,
+				 floating,
+				 const vector<floating>& fields) -> void {
+  auto dataLine = make_unique<DataLine>(0, timeStep);
+  dataLine->fields = fields;
+  lines.push_back(move(dataLine));
+}
+
+/**
+ * Note where a captured segment starts
+ *
+ * @param index segment number
+ * @param triggerTimeStep time step at which the trigger fired
+ */
+auto Mixer::CapturedLines::segment(size_t, size_t triggerTimeStep) -> void {
+  segmentStarts.push_back(lines.size());
+  triggerTimeSteps.push_back(triggerTimeStep);
+}
+
+/**
+ * Pass the captured lines, and the starts of the segments, on to an
+ * output sink
+ *
+ * @param sink where the results go
+ * @param headings column headings
+ */
+auto Mixer::CapturedLines::replay(OutputSink& sink,
+				  const string& headings) const -> void {
+  sink.begin(headings);
+  auto segment = size_t{0};
+  auto line = size_t{0};
+  for (auto&& dataLine : lines) {
+    if (segment < segmentStarts.size() && segmentStarts[segment] == line) {
+      sink.segment(segment, triggerTimeSteps[segment]);
+      segment++;
     }
+    sink.write(dataLine->timeStep, dataLine->timeStamp, dataLine->fields);
+    line++;
   }
+  sink.end();
 }
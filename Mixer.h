@@ -27,9 +27,20 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
+#include <optional>
 #include "misc.h"
+#include "Adc.h"
+#include "Capture.h"
+#include "DigitalLogic.h"
+#include "Noise.h"
+#include "ResultCache.h"
+#include "StateSpace.h"
+#include "Telemetry.h"
+#include "WaveformCache.h"
 
 class Signal;
+struct PipelineBlock;
 
 class Mixer {
   
@@ -48,14 +59,94 @@ class Mixer {
 	}
       }
   };
-  
+
+  /**
+   * Picks out the time steps that get written, which are one every
+   * OUTPUT_RESOLUTION once the extra settling cycles are over.
+   */
+  class OutputDecimation {
+  private:
+    std::size_t startTimeStep;
+    std::size_t step;
+    bool started = false;
+    std::size_t oldTimeStep = 0;
+
+  public:
+    OutputDecimation(floating timeStepsPerCarrierCycle);
+    auto select(std::size_t timeStep) -> bool;
+  };
+
+  /**
+   * Works out the demodulated signal in the same way as amDemod, for
+   * runs that only keep some of their lines.  It sees every time
+   * step's inphase and quadrature values for their minima, but only
+   * keeps one every OUTPUT_RESOLUTION for the mean.
+   */
+  class RunningDemodulator {
+  private:
+    std::size_t sampleStep;
+    floating minI;
+    floating minQ;
+    std::vector<floating> sampledInphase;
+    std::vector<floating> sampledQuadrature;
+
+  public:
+    RunningDemodulator(std::size_t totalTimeSteps);
+    auto add(std::size_t timeStep,
+	     floating inphase,
+	     floating quadrature) -> void;
+    auto apply(std::list<std::unique_ptr<DataLine>>& lines,
+	       std::size_t inphaseIndex,
+	       std::size_t quadratureIndex,
+	       std::size_t demodulatedIndex) const -> void;
+  };
+
+  /**
+   * Keeps the lines that a triggered capture passes on while a run is
+   * streamed through it, and where each segment starts, until the
+   * columns worked out at the end of the run have been filled in.
+   */
+  class CapturedLines : public OutputSink {
+  private:
+    std::list<std::unique_ptr<DataLine>>& lines;
+    std::vector<std::size_t> segmentStarts;
+    std::vector<std::size_t> triggerTimeSteps;
+
+  public:
+    CapturedLines(std::list<std::unique_ptr<DataLine>>& lines);
+    auto begin(const std::string&) -> void override {}
+    auto write(std::size_t timeStep,
+	       floating timeStamp,
+	       const std::vector<floating>& fields) -> void override;
+    auto segment(std::size_t index,
+		 std::size_t triggerTimeStep) -> void override;
+    auto replay(OutputSink& sink, const std::string& headings) const -> void;
+  };
+
   std::list<std::unique_ptr<DataLine>> results;
+  std::optional<CaptureSettings> capture;
+  std::unique_ptr<CapturedLines> capturedLines;
+  std::unique_ptr<Capture> streamingCapture;
+  std::optional<OutputDecimation> streamingDecimation;
+  std::optional<AdcSettings> adc;
+  std::optional<NoiseSettings> noise;
+  std::optional<ResultCache> cache;
+  std::shared_ptr<WaveformCache> waveforms;
+  std::shared_ptr<TelemetryPublisher> telemetry;
+  bool compressed = false;
+  std::size_t plotWidth = 0;
+  bool statistics = false;
 
   Mixer() = default;
 
   auto reset() -> void;
   
   auto add(std::unique_ptr<DataLine>& newLine) -> void;
+  auto keep(std::unique_ptr<DataLine>& newLine) -> void;
+  auto publish(const DataLine& dataLine) -> void;
+  auto canStreamCapture() const -> bool;
+  auto streamCapture(const std::string& headings,
+		     floating timeStepsPerCarrierCycle) -> bool;
 
   auto butterworth(std::size_t inputIndex,
 		   std::size_t outputIndex,
@@ -67,10 +158,47 @@ class Mixer {
 	       std::size_t quadratureVectorIndex,
 	       std::size_t demodulatedOutputVector) -> void;
 
-  auto outputData(const std::string& filename,
+  auto adcBaseband(std::size_t inphaseIndex,
+		   std::size_t quadratureIndex,
+		   std::size_t firstOutputIndex) -> void;
+
+  auto adcColumnCount() const -> std::size_t;
+  auto adcHeadings() const -> std::string;
+
+  auto outputData(OutputSink& sink,
 		  const std::string& headings,
 		  floating timeStepsPerCarrierCycle) -> void;
-  
+
+  auto getWaveform(const Signal& signal, std::size_t timeSteps) const
+    -> std::shared_ptr<const WaveformCache::Waveform>;
+
+  auto startTelemetry(const std::string& headings,
+		      std::size_t totalTimeSteps) -> void;
+
+  auto describeOptions() const -> std::string;
+  auto writeResults(const std::string& outputFilename,
+		    const std::string& description,
+		    const std::function<auto (OutputSink&) -> void>& simulate)
+    -> void;
+
+ public:
+  auto setCapture(const CaptureSettings& settings) -> void;
+  auto clearCapture() -> void;
+  auto setAdc(const AdcSettings& settings) -> void;
+  auto clearAdc() -> void;
+  auto setNoise(const NoiseSettings& settings) -> void;
+  auto clearNoise() -> void;
+  auto setCache(const std::string& directory) -> void;
+  auto clearCache() -> void;
+  auto setCompressed(bool enable) -> void;
+  auto setPlotWidth(std::size_t width) -> void;
+  auto setStatistics(bool enable) -> void;
+  auto setWaveformCache(const std::shared_ptr<WaveformCache>& cache) -> void;
+  auto clearWaveformCache() -> void;
+  auto setTelemetry(const std::shared_ptr<TelemetryPublisher>& publisher)
+    -> void;
+  auto clearTelemetry() -> void;
+
   virtual ~Mixer() = default;
 
 };
@@ -80,13 +208,75 @@ class Mixer {
 class ZetaSdr : public Mixer {
  private:
   const Circuit& circuit;
+  std::optional<OpAmpFilter> opAmpFilter;
+  bool pipelined;
+  std::size_t phases;
+  std::size_t chunks;
+  floating chunkOverlapSeconds;
+  bool checkChunks;
+  bool fixedCircuit;
+  std::optional<LogicTiming> logicTiming;
+
+  template <typename Detector>
+  auto makeDetector(floating carrierFreqHz,
+		    floating phaseOffset) const -> Detector;
+  template <typename Detector>
+  auto simulate(std::size_t timeSteps,
+		const Signal& signal,
+		floating phaseOffset,
+		std::size_t fieldCount) -> void;
+  template <typename Detector>
+  auto simulatePipelined(std::size_t timeSteps,
+			 const Signal& signal,
+			 floating phaseOffset,
+			 std::size_t fieldCount,
+			 RunningDemodulator* demodulator) -> void;
+  template <typename Detector>
+  auto simulateChunked(std::size_t timeSteps,
+		       const Signal& signal,
+		       floating phaseOffset,
+		       std::size_t fieldCount) -> void;
+  auto makeDataLine(const PipelineBlock& block,
+		    std::size_t index,
+		    std::size_t fieldCount) const -> std::unique_ptr<DataLine>;
+  auto carryOpAmpState(
+    std::vector<std::list<std::unique_ptr<DataLine>>>& chunkLines,
+    const std::vector<std::vector<floating>>& endStates) const -> void;
+  auto reportChunkErrors(const std::list<std::unique_ptr<DataLine>>& chunked,
+			 const std::string& headings) const -> void;
+  template <typename Detector>
+  auto measureWith(BasebandProbe& probe,
+		   std::size_t maxTimeSteps,
+		   const Signal& signal,
+		   floating phaseOffset) -> std::size_t;
 
  public: 
   ZetaSdr(const Circuit& circuit);
+  auto setOpAmpFilter(const OpAmpFilter& filter) -> void;
+  auto clearOpAmpFilter() -> void;
+  auto setPipelined(bool enable) -> void;
+  auto setPhases(std::size_t count) -> void;
+  auto setFixedCircuit(bool fixed) -> void;
+  auto setChunks(std::size_t count,
+		 floating overlapSeconds,
+		 bool check = false) -> void;
+  auto setLogicTiming(const LogicTiming& timing) -> void;
+  auto clearLogicTiming() -> void;
+  auto measure(BasebandProbe& probe,
+	       std::size_t maxTimeSteps,
+	       const Signal& signal,
+	       floating phaseAngleDeg) -> std::size_t;
+  auto describe(std::size_t cycleCount,
+		const Signal& signal,
+		floating phaseAngleDeg) const -> std::string;
   auto run(const std::string& outputFilename,
 	   std::size_t cycleCount,
 	   const Signal& signal,
 	   floating phaseAngleDeg) -> void;
+  auto run(OutputSink& output,
+	   std::size_t cycleCount,
+	   const Signal& signal,
+	   floating phaseAngleDeg) -> void;
   virtual ~ZetaSdr() = default;
 };
 
@@ -95,13 +285,31 @@ class ZetaSdr : public Mixer {
 class IqMixer : public Mixer {
  private:
   const floating lpFreqHz;
+  bool fused;
+
+  auto runFused(OutputSink& output,
+		std::size_t cycleCount,
+		const Signal& signal,
+		floating phaseAngleDeg) -> void;
   
  public:
   IqMixer(floating lpFreqHz);
+  auto setFused(bool enable) -> void;
+  auto measure(BasebandProbe& probe,
+	       std::size_t maxTimeSteps,
+	       const Signal& signal,
+	       floating phaseAngleDeg) -> std::size_t;
+  auto describe(std::size_t cycleCount,
+		const Signal& signal,
+		floating phaseAngleDeg) const -> std::string;
   auto run(const std::string& outputFilename,
 	   std::size_t cycleCount,
 	   const Signal& signal,
 	   floating phaseAngleDeg) -> void;
+  auto run(OutputSink& output,
+	   std::size_t cycleCount,
+	   const Signal& signal,
+	   floating phaseAngleDeg) -> void;
 
   virtual ~IqMixer() = default;
 };
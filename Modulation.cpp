@@ -0,0 +1,80 @@
+/**
+ * Modulation kernels for the carriers in a Signal
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "Modulation.h"
+
+using namespace std;
+
+/**
+ * Parse a modulation specification from the command line.  This is
+ * one of
+ *
+ *   am:modFreqHz
+ *   fm:modFreqHz:deviationHz
+ *   usb:toneHz or lsb:toneHz
+ *   cw:keyFreqHz:riseSeconds
+ *   twotone:lowToneHz:highToneHz
+ *
+ * @param specification modulation specification
+ * @return the modulation
+ */
+auto parseModulation(const string& specification) -> Modulation {
+  auto stream = istringstream{specification};
+  auto parts = vector<string>{};
+  auto part = string{};
+  while (getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+
+  try {
+    const auto& kind = parts.at(0);
+    if (kind == "am" && parts.size() == 2) {
+      return AmModulation{stold(parts.at(1))};
+    }
+    if (kind == "fm" && parts.size() == 3 && stold(parts.at(1)) > 0) {
+      return FmModulation{stold(parts.at(1)), stold(parts.at(2))};
+    }
+    if ((kind == "usb" || kind == "lsb") && parts.size() == 2) {
+      return SsbModulation{stold(parts.at(1)), kind == "usb"};
+    }
+    if (kind == "cw" && parts.size() == 3 && stold(parts.at(1)) > 0 &&
+	stold(parts.at(2)) * 2 * stold(parts.at(1)) <= 1) {
+      return CwModulation{stold(parts.at(1)), stold(parts.at(2))};
+    }
+    if (kind == "twotone" && parts.size() == 3) {
+      return TwoToneModulation{stold(parts.at(1)), stold(parts.at(2))};
+    }
+  }
+  catch (const logic_error&) {
+  }
+
+  cout << "Bad modulation specification " << specification << endl;
+  exit(EXIT_FAILURE);
+}
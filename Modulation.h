@@ -0,0 +1,286 @@
+/**
+ * Modulation kernels for the carriers in a Signal
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <variant>
+#include "misc.h"
+
+/*
+ * Each kernel is a small value type with the same member functions,
+ * and Modulation is a variant of them.  Signal visits the
+ * variant once per carrier for each block of time steps, so the loop
+ * over the time steps is compiled separately for each kind of
+ * modulation and the kernel calls can be inlined into it.
+ *
+ * amplitude() is the envelope, which is what the output files show
+ * in the modulation column.  signal() is the instantaneous RF
+ * voltage given the carrier phase at that time step.  describe()
+ * writes the kind of modulation and its parameters, for the result
+ * cache.  bandwidthHz() is how far from the carrier the modulation
+ * puts any significant part of the signal, which the crowded band
+ * synthesis in Signal needs to know.
+ *
+ * Every kernel's signal() is the imaginary part of the carrier phasor
+ * times a complex envelope, so it is linear in the sine and cosine of
+ * the carrier phase.
+ */
+
+/**
+ * Radians of a modulating tone at a time step
+ *
+ * @param freqHz tone frequency
+ * @param timeStep time step
+ * @return phase of the tone, not reduced to a single cycle
+ */
+inline auto toneRadians(floating freqHz, std::size_t timeStep) -> floating {
+  return floating{2.0 * M_PI * freqHz} * timeStep * TIME_STEP_SIZE;
+}
+
+//===================================================================
+
+/**
+ * Double sideband full carrier AM with a single modulating tone.
+ * The modulating tone starts at the same phase angle as the carrier.
+ */
+struct AmModulation {
+  floating modFreqHz;
+
+  auto getModFreqHz() const -> floating {
+    return modFreqHz;
+  }
+
+  auto describe(std::ostream& stream) const -> void {
+    stream << "am " << modFreqHz;
+  }
+
+  auto bandwidthHz() const -> floating {
+    return modFreqHz;
+  }
+
+  auto amplitude(floating carrierAmplitude,
+		 floating initialPhaseRadians,
+		 std::size_t timeStep) const -> floating {
+    auto radiansPerSecond = floating{2.0 * M_PI * modFreqHz};
+    auto radians = radiansPerSecond * timeStep * TIME_STEP_SIZE;
+    radians += initialPhaseRadians;
+    return carrierAmplitude * std::cos(radians);
+  }
+
+  auto signal(floating carrierAmplitude,
+	      floating initialPhaseRadians,
+	      floating carrierRadians,
+	      std::size_t timeStep) const -> floating {
+    return amplitude(carrierAmplitude, initialPhaseRadians, timeStep) *
+      std::sin(carrierRadians);
+  }
+};
+
+//===================================================================
+
+/**
+ * Frequency modulation with a single modulating tone
+ */
+struct FmModulation {
+  floating modFreqHz;
+  floating deviationHz;
+
+  auto getModFreqHz() const -> floating {
+    return modFreqHz;
+  }
+
+  auto describe(std::ostream& stream) const -> void {
+    stream << "fm " << modFreqHz << " " << deviationHz;
+  }
+
+  // Carson's rule
+  auto bandwidthHz() const -> floating {
+    return deviationHz + modFreqHz;
+  }
+
+  auto amplitude(floating carrierAmplitude,
+		 floating,
+		 std::size_t) const -> floating {
+    return carrierAmplitude;
+  }
+
+  auto signal(floating carrierAmplitude,
+	      floating,
+	      floating carrierRadians,
+	      std::size_t timeStep) const -> floating {
+    const auto modulationIndex = deviationHz / modFreqHz;
+    return carrierAmplitude *
+      std::sin(carrierRadians +
+	       modulationIndex * std::sin(toneRadians(modFreqHz, timeStep)));
+  }
+};
+
+//===================================================================
+
+/**
+ * Suppressed carrier single sideband with a single modulating tone,
+ * which is just a carrier offset by the tone frequency
+ */
+struct SsbModulation {
+  floating modFreqHz;
+  bool upperSideband;
+
+  auto getModFreqHz() const -> floating {
+    return modFreqHz;
+  }
+
+  auto describe(std::ostream& stream) const -> void {
+    stream << (upperSideband ? "usb " : "lsb ") << modFreqHz;
+  }
+
+  auto bandwidthHz() const -> floating {
+    return modFreqHz;
+  }
+
+  auto amplitude(floating carrierAmplitude,
+		 floating,
+		 std::size_t) const -> floating {
+    return carrierAmplitude;
+  }
+
+  auto signal(floating carrierAmplitude,
+	      floating,
+	      floating carrierRadians,
+	      std::size_t timeStep) const -> floating {
+    const auto offset = toneRadians(modFreqHz, timeStep);
+    return carrierAmplitude *
+      std::sin(upperSideband ? carrierRadians + offset :
+	       carrierRadians - offset);
+  }
+};
+
+//===================================================================
+
+/**
+ * On-off keyed carrier, sending continuous dots.  The carrier is on
+ * for the first half of each keying period, and the edges are shaped
+ * with a raised cosine to limit key clicks.
+ */
+struct CwModulation {
+  floating keyFreqHz;
+  floating riseSeconds;
+
+  auto getModFreqHz() const -> floating {
+    return keyFreqHz;
+  }
+
+  auto describe(std::ostream& stream) const -> void {
+    stream << "cw " << keyFreqHz << " " << riseSeconds;
+  }
+
+  // The edges spread the signal out about as far as one over their
+  // rise time, and hard keying spreads it out as far as it can go
+  auto bandwidthHz() const -> floating {
+    return riseSeconds > 0 ? std::max(keyFreqHz, 1 / riseSeconds) :
+      1 / (2 * TIME_STEP_SIZE);
+  }
+
+  auto amplitude(floating carrierAmplitude,
+		 floating,
+		 std::size_t timeStep) const -> floating {
+    const auto period = 1 / keyFreqHz;
+    const auto halfPeriod = period / 2;
+    const auto time = std::fmod(timeStep * TIME_STEP_SIZE, period);
+    auto envelope = floating{0};
+    if (time < riseSeconds) {
+      envelope = (1 - std::cos(M_PI * time / riseSeconds)) / 2;
+    }
+    else if (time < halfPeriod) {
+      envelope = 1;
+    }
+    else if (time < halfPeriod + riseSeconds) {
+      envelope = (1 + std::cos(M_PI * (time - halfPeriod) / riseSeconds)) / 2;
+    }
+    return carrierAmplitude * envelope;
+  }
+
+  auto signal(floating carrierAmplitude,
+	      floating initialPhaseRadians,
+	      floating carrierRadians,
+	      std::size_t timeStep) const -> floating {
+    return amplitude(carrierAmplitude, initialPhaseRadians, timeStep) *
+      std::sin(carrierRadians);
+  }
+};
+
+//===================================================================
+
+/**
+ * Two equal tones in the upper sideband, each at half the carrier
+ * amplitude, which is the usual SSB intermodulation test signal
+ */
+struct TwoToneModulation {
+  floating lowToneHz;
+  floating highToneHz;
+
+  auto getModFreqHz() const -> floating {
+    return lowToneHz;
+  }
+
+  auto describe(std::ostream& stream) const -> void {
+    stream << "twotone " << lowToneHz << " " << highToneHz;
+  }
+
+  auto bandwidthHz() const -> floating {
+    return highToneHz;
+  }
+
+  auto amplitude(floating carrierAmplitude,
+		 floating,
+		 std::size_t timeStep) const -> floating {
+    return carrierAmplitude *
+      std::fabs(std::cos(toneRadians(highToneHz - lowToneHz, timeStep) / 2));
+  }
+
+  auto signal(floating carrierAmplitude,
+	      floating,
+	      floating carrierRadians,
+	      std::size_t timeStep) const -> floating {
+    return carrierAmplitude / 2 *
+      (std::sin(carrierRadians + toneRadians(lowToneHz, timeStep)) +
+       std::sin(carrierRadians + toneRadians(highToneHz, timeStep)));
+  }
+};
+
+//===================================================================
+
+using Modulation = std::variant<AmModulation,
+				FmModulation,
+				SsbModulation,
+				CwModulation,
+				TwoToneModulation>;
+
+auto parseModulation(const std::string& specification) -> Modulation;
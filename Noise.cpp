@@ -0,0 +1,228 @@
+/**
+ * Reproducible noise for the RF signal and the local oscillator
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include "Noise.h"
+
+using namespace std;
+
+// Four lanes of the counter hash at a time
+using v4du = uint64_t __attribute__((vector_size(32)));
+using v4df = double __attribute__((vector_size(32)));
+
+// Weyl sequence increment, from splitmix64
+constexpr auto GOLDEN_GAMMA = uint64_t{0x9e3779b97f4a7c15};
+
+// Spreads the stream numbers across the key space
+constexpr auto STREAM_MULTIPLIER = uint64_t{0xd1b54a32d192ed03};
+
+//===================================================================
+
+/**
+ * Parse a noise specification from the command line, which is
+ * rmsVolts[:bandwidthHz[:jitterSeconds[:seed]]].  A bandwidth of 0
+ * leaves the noise white up to half the simulation rate.
+ *
+ * @param specification noise specification
+ * @return noise settings
+ */
+auto NoiseSettings::parse(const string& specification) -> NoiseSettings {
+  auto stream = istringstream{specification};
+  auto parts = vector<string>{};
+  auto part = string{};
+  while (getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+
+  auto settings = NoiseSettings{-1, 0, 0, 1};
+  try {
+    if (!parts.empty() && parts.size() <= 4) {
+      settings.rmsVolts = stold(parts.at(0));
+      if (parts.size() > 1) {
+	settings.bandwidthHz = stold(parts.at(1));
+      }
+      if (parts.size() > 2) {
+	settings.jitterSeconds = stold(parts.at(2));
+      }
+      if (parts.size() > 3) {
+	settings.seed = stoull(parts.at(3));
+      }
+    }
+  }
+  catch (const logic_error&) {
+    settings.rmsVolts = -1;
+  }
+
+  if (settings.rmsVolts < 0 || settings.bandwidthHz < 0 ||
+      settings.jitterSeconds < 0) {
+    cout << "Bad noise specification " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+  return settings;
+}
+
+//===================================================================
+
+/**
+ * The splitmix64 output function, which works on single values and on
+ * vectors of them.  The value is mixed in place because passing the
+ * vectors by value would depend on the instruction set.
+ *
+ * @param z value to mix
+ */
+template<typename T>
+static auto mix(T& z) -> void {
+  z = (z ^ (z >> 30)) * uint64_t{0xbf58476d1ce4e5b9};
+  z = (z ^ (z >> 27)) * uint64_t{0x94d049bb133111eb};
+  z ^= z >> 31;
+}
+
+/**
+ * Mix a single value
+ *
+ * @param z value to mix
+ * @return mixed value
+ */
+static auto mixed(uint64_t z) -> uint64_t {
+  mix(z);
+  return z;
+}
+
+/**
+ * Box-Muller transform of two uniform values in (0, 1).  Only the
+ * cosine half is used, so that each counter gives one value.
+ *
+ * @param u1 first uniform value
+ * @param u2 second uniform value
+ * @return Gaussian value with unit variance
+ */
+static auto boxMuller(double u1, double u2) -> double {
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * Constructor
+ *
+ * @param seed run seed
+ * @param stream which stream within the run
+ */
+GaussianNoise::GaussianNoise(uint64_t seed, uint64_t stream) :
+  key{mixed(mixed(seed) ^ (stream * STREAM_MULTIPLIER))} {}
+
+/**
+ * Generate the values for a block of consecutive counters.  Each
+ * counter is hashed to 64 bits, which are split into the two 32 bit
+ * uniform values for the Box-Muller transform.  The hashing is done
+ * four counters at a time.
+ *
+ * @param firstCounter counter for the first value
+ * @param count number of values
+ * @param output receives count values with unit variance
+ */
+auto GaussianNoise::generate(size_t firstCounter,
+			     size_t count,
+			     double* output) const -> void {
+  constexpr auto UNIFORM_SCALE = 0x1p-32;
+  constexpr auto LOW_BITS = uint64_t{0xffffffff};
+
+  auto n = size_t{0};
+  for (; n + 4 <= count; n += 4) {
+    const auto counter = uint64_t{firstCounter + n};
+    auto counters = v4du{counter, counter + 1, counter + 2, counter + 3};
+    auto bits = counters * GOLDEN_GAMMA + key;
+    mix(bits);
+    auto u1 = (__builtin_convertvector(bits >> 32, v4df) + 0.5) *
+      UNIFORM_SCALE;
+    auto u2 = (__builtin_convertvector(bits & LOW_BITS, v4df) + 0.5) *
+      UNIFORM_SCALE;
+    for (auto lane = 0; lane < 4; lane++) {
+      output[n + lane] = boxMuller(u1[lane], u2[lane]);
+    }
+  }
+  for (; n < count; n++) {
+    auto bits = mixed(uint64_t{firstCounter + n} * GOLDEN_GAMMA + key);
+    auto u1 = (static_cast<double>(bits >> 32) + 0.5) * UNIFORM_SCALE;
+    auto u2 = (static_cast<double>(bits & LOW_BITS) + 0.5) * UNIFORM_SCALE;
+    output[n] = boxMuller(u1, u2);
+  }
+}
+
+//===================================================================
+
+/**
+ * Work out how much to scale the white noise by so that it has the
+ * wanted RMS voltage after the band limiting filter
+ *
+ * @param settings noise settings
+ * @return standard deviation of the white noise
+ */
+static auto whiteNoiseScale(const NoiseSettings& settings) -> double {
+  if (!settings.bandwidthHz) {
+    return static_cast<double>(settings.rmsVolts);
+  }
+  // Equivalent noise bandwidth of a Butterworth low pass filter
+  const auto poles = floating{NOISE_FILTER_POLES};
+  const auto noiseBandwidthHz = settings.bandwidthHz *
+    (M_PI / (2 * poles)) / sin(M_PI / (2 * poles));
+  return static_cast<double>(settings.rmsVolts /
+			     sqrt(2 * noiseBandwidthHz * TIME_STEP_SIZE));
+}
+
+/**
+ * Constructor
+ *
+ * @param settings noise settings
+ * @param stream which stream within the run
+ */
+NoiseSource::NoiseSource(const NoiseSettings& settings, uint64_t stream) :
+  gaussian{settings.seed, stream},
+  scale{whiteNoiseScale(settings)},
+  filter{NOISE_FILTER_POLES, settings.bandwidthHz, false} {}
+
+/**
+ * Add the noise for a block of time steps to the signal
+ *
+ * @param firstTimeStep first time step in the block
+ * @param count number of time steps
+ * @param signal signal voltages to add the noise to
+ */
+auto NoiseSource::add(size_t firstTimeStep,
+		      size_t count,
+		      floating* signal) -> void {
+  buffer.resize(count);
+  gaussian.generate(firstTimeStep, count, buffer.data());
+  for (auto&& value : buffer) {
+    value *= scale;
+  }
+  filter.apply(buffer.data(), buffer.data(), count);
+  for (auto index = size_t{0}; index < count; index++) {
+    signal[index] += buffer[index];
+  }
+}
@@ -0,0 +1,100 @@
+/**
+ * Reproducible noise for the RF signal and the local oscillator
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Butterworth.h"
+#include "misc.h"
+
+// Poles in the filter that band limits the RF noise
+constexpr auto NOISE_FILTER_POLES = 2u;
+
+// Noise streams within a run, so that each noise source is
+// independent of the others
+constexpr auto NOISE_STREAM_SIGNAL = std::uint64_t{0};
+constexpr auto NOISE_STREAM_LOCAL_OSCILLATOR = std::uint64_t{1};
+
+/**
+ * Noise characteristics.  The RF noise is added to the signal before
+ * the detector.  The jitter is white phase noise on the local
+ * oscillator, expressed as an RMS timing error.  Runs with different
+ * seeds get independent noise, and runs with the same seed get
+ * exactly the same noise.
+ */
+struct NoiseSettings {
+  floating rmsVolts;
+  floating bandwidthHz;
+  floating jitterSeconds;
+  std::uint64_t seed;
+
+  static auto parse(const std::string& specification) -> NoiseSettings;
+};
+
+//===================================================================
+
+/**
+ * Counter based Gaussian random number generator.  The value for
+ * each counter is a hash of the counter, the seed and the stream, so
+ * any block of values can be generated without generating the ones
+ * before it, and the values don't depend on how the run is split into
+ * blocks or threads.
+ */
+class GaussianNoise {
+private:
+  const std::uint64_t key;
+
+public:
+  GaussianNoise(std::uint64_t seed, std::uint64_t stream);
+  auto generate(std::size_t firstCounter,
+		std::size_t count,
+		double* output) const -> void;
+};
+
+//===================================================================
+
+/**
+ * Additive noise for the RF signal, optionally band limited by a low
+ * pass filter.  The RMS voltage is after the band limiting.  The
+ * filter keeps its state between calls, so the blocks must be added
+ * in time step order.
+ */
+class NoiseSource {
+private:
+  const GaussianNoise gaussian;
+  const double scale;
+  Butterworth filter;
+  std::vector<double> buffer;
+
+public:
+  NoiseSource(const NoiseSettings& settings, std::uint64_t stream);
+  auto add(std::size_t firstTimeStep,
+	   std::size_t count,
+	   floating* signal) -> void;
+};
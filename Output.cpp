@@ -0,0 +1,154 @@
+/**
+ * Destinations for the simulation results
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sstream>
+#include "Output.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ *
+ * @param filename output filename
+ */
+CsvFile::CsvFile(const string& filename) : file{filename} {
+  file.precision(9);
+}
+
+/**
+ * Write the column headings
+ *
+ * @param headings column headings
+ */
+auto CsvFile::begin(const string& headings) -> void {
+  file << scientific << "# " << headings << "\n";
+}
+
+/**
+ * Write one line of results
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto CsvFile::write(size_t timeStep,
+		    floating timeStamp,
+		    const vector<floating>& fields) -> void {
+  file << timeStep << "," << timeStamp;
+  for (auto&& field : fields) {
+    file << "," << field;
+  }
+  file << "\n";
+}
+
+/**
+ * Mark the start of a captured segment with a comment line, so that
+ * the file can still be read as CSV
+ *
+ * @param index segment number
+ * @param triggerTimeStep time step at which the trigger fired
+ */
+auto CsvFile::segment(size_t index, size_t triggerTimeStep) -> void {
+  file << "# segment " << index << ", trigger at timestep "
+       << triggerTimeStep << "\n";
+}
+
+//===================================================================
+
+/**
+ * Set up one empty column per heading
+ *
+ * @param headings column headings
+ */
+auto ColumnSink::begin(const string& headings) -> void {
+  names = splitHeadings(headings);
+  columns.clear();
+  columns.resize(names.size());
+}
+
+/**
+ * Append one line of results to the columns
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto ColumnSink::write(size_t timeStep,
+		       floating timeStamp,
+		       const vector<floating>& fields) -> void {
+  if (columns.size() < fields.size() + 2) {
+    columns.resize(fields.size() + 2);
+  }
+  columns.at(0).push_back(static_cast<double>(timeStep));
+  columns.at(1).push_back(static_cast<double>(timeStamp));
+  auto index = size_t{2};
+  for (auto&& field : fields) {
+    columns.at(index++).push_back(static_cast<double>(field));
+  }
+}
+
+//===================================================================
+
+/**
+ * Split the comma separated column headings into names, without the
+ * surrounding spaces.
+ *
+ * @param headings comma separated column headings
+ * @return column names
+ */
+auto splitHeadings(const string& headings) -> vector<string> {
+  auto names = vector<string>{};
+  auto stream = istringstream{headings};
+  auto heading = string{};
+  while (getline(stream, heading, ',')) {
+    auto first = heading.find_first_not_of(' ');
+    auto last = heading.find_last_not_of(' ');
+    names.push_back(first == string::npos ?
+		    string{} : heading.substr(first, last - first + 1));
+  }
+  return names;
+}
+
+/**
+ * Find the position of the named column in the fields vector of a
+ * DataLine.  The first two headings are the time step and time,
+ * which are not part of the fields vector.
+ *
+ * @param headings comma separated column headings
+ * @param name column to look for
+ * @return index into the fields vector, or nothing if there is no
+ *         such field
+ */
+auto findField(const string& headings,
+	       const string& name) -> optional<size_t> {
+  auto names = splitHeadings(headings);
+  for (auto column = size_t{2}; column < names.size(); column++) {
+    if (names.at(column) == name) {
+      return column - 2;
+    }
+  }
+  return {};
+}
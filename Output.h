@@ -0,0 +1,138 @@
+/**
+ * Destinations for the simulation results
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <optional>
+#include "misc.h"
+
+/**
+ * Mixer::outputData passes each line of results that is to be
+ * written to one of these.
+ */
+class OutputSink {
+public:
+  virtual auto begin(const std::string& headings) -> void = 0;
+  virtual auto write(std::size_t timeStep,
+		     floating timeStamp,
+		     const std::vector<floating>& fields) -> void = 0;
+
+  /**
+   * Start of a new, non-contiguous, segment of results.  Only the
+   * triggered capture generates these.
+   *
+   * @param index segment number, starting at 0
+   * @param triggerTimeStep time step at which the trigger fired
+   */
+  virtual auto segment(std::size_t,
+		       std::size_t) -> void {}
+  virtual auto end() -> void {}
+  virtual ~OutputSink() = default;
+};
+
+//===================================================================
+
+/**
+ * Writes the results as comma separated values.  This is the format
+ * that plot.py reads.
+ */
+class CsvFile : public OutputSink {
+private:
+  std::ofstream file;
+
+public:
+  CsvFile(const std::string& filename);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto segment(std::size_t index,
+	       std::size_t triggerTimeStep) -> void override;
+  virtual ~CsvFile() = default;
+};
+
+//===================================================================
+
+/**
+ * Keeps the results in memory as one contiguous array of doubles per
+ * column, including the time step and time columns.  This is what the
+ * shared library hands back to its callers.
+ */
+class ColumnSink : public OutputSink {
+private:
+  std::vector<std::string> names;
+  std::vector<std::vector<double>> columns;
+
+public:
+  ColumnSink() = default;
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto getNames() const -> const std::vector<std::string>& {
+    return names;
+  }
+  auto getColumns() const -> const std::vector<std::vector<double>>& {
+    return columns;
+  }
+  auto getRowCount() const -> std::size_t {
+    return columns.empty() ? 0 : columns.front().size();
+  }
+  virtual ~ColumnSink() = default;
+};
+
+//===================================================================
+
+/**
+ * Gets the filtered inphase and quadrature outputs a block at a time
+ * while a measurement is running, rather than the whole run at the
+ * end.  It decides when the measurement has gone on long enough.
+ */
+class BasebandProbe {
+public:
+  /**
+   * Look at the next block of filtered outputs
+   *
+   * @param firstTimeStep time step of the first entry
+   * @param count number of time steps
+   * @param inphase filtered inphase output
+   * @param quadrature filtered quadrature output
+   * @return false to stop the measurement
+   */
+  virtual auto observe(std::size_t firstTimeStep,
+		       std::size_t count,
+		       const double* inphase,
+		       const double* quadrature) -> bool = 0;
+  virtual ~BasebandProbe() = default;
+};
+
+//===================================================================
+
+auto splitHeadings(const std::string& headings) -> std::vector<std::string>;
+auto findField(const std::string& headings,
+	       const std::string& name) -> std::optional<std::size_t>;
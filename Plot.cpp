@@ -0,0 +1,238 @@
+/**
+ * Display resolution results for plotting
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include "Plot.h"
+
+using namespace std;
+
+/**
+ * Pick out the minimum and maximum in each of a number of equal
+ * buckets of values.  Drawing just these as a line looks the same as
+ * drawing all of them, when each bucket is one pixel wide.
+ *
+ * @param values values to pick from
+ * @param buckets number of buckets
+ * @return indices of the picked values in increasing order, which is
+ *         every index if there are no more than two per bucket
+ */
+auto minMaxIndices(const vector<double>& values,
+		   size_t buckets) -> vector<size_t> {
+  auto indices = vector<size_t>{};
+  const auto size = values.size();
+  if (buckets == 0 || size <= 2 * buckets) {
+    for (auto index = size_t{0}; index < size; index++) {
+      indices.push_back(index);
+    }
+    return indices;
+  }
+
+  indices.reserve(2 * buckets);
+  for (auto bucket = size_t{0}; bucket < buckets; bucket++) {
+    const auto first = bucket * size / buckets;
+    const auto last = (bucket + 1) * size / buckets;
+    auto minimum = first;
+    auto maximum = first;
+    for (auto index = first + 1; index < last; index++) {
+      if (values[index] < values[minimum]) {
+	minimum = index;
+      }
+      if (values[index] > values[maximum]) {
+	maximum = index;
+      }
+    }
+    indices.push_back(min(minimum, maximum));
+    if (minimum != maximum) {
+      indices.push_back(max(minimum, maximum));
+    }
+  }
+  return indices;
+}
+
+/**
+ * Largest triangle three buckets downsampling.  The first and last
+ * points are kept, and the rest are split into equal buckets.  From
+ * each bucket it keeps the point making the largest triangle with the
+ * point kept from the bucket before and the average of the bucket
+ * after.
+ *
+ * @param times x values
+ * @param values y values
+ * @param points number of points to keep
+ * @return indices of the kept points in increasing order, which is
+ *         every index if there are no more than points of them
+ */
+auto lttbIndices(const vector<double>& times,
+		 const vector<double>& values,
+		 size_t points) -> vector<size_t> {
+  auto indices = vector<size_t>{};
+  const auto size = values.size();
+  if (points < 3 || size <= points) {
+    for (auto index = size_t{0}; index < size; index++) {
+      indices.push_back(index);
+    }
+    return indices;
+  }
+
+  indices.reserve(points);
+  indices.push_back(0);
+
+  // The first and last points have buckets of their own
+  const auto buckets = points - 2;
+  const auto inner = size - 2;
+  auto kept = size_t{0};
+  for (auto bucket = size_t{0}; bucket < buckets; bucket++) {
+    const auto first = 1 + bucket * inner / buckets;
+    const auto last = 1 + (bucket + 1) * inner / buckets;
+
+    // Average of the next bucket, which is just the last point at the
+    // end
+    const auto nextFirst = last;
+    const auto nextLast = bucket + 1 < buckets ?
+      1 + (bucket + 2) * inner / buckets : size;
+    auto averageTime = double{0};
+    auto averageValue = double{0};
+    for (auto index = nextFirst; index < nextLast; index++) {
+      averageTime += times[index];
+      averageValue += values[index];
+    }
+    averageTime /= nextLast - nextFirst;
+    averageValue /= nextLast - nextFirst;
+
+    auto largestArea = double{-1};
+    auto largest = first;
+    for (auto index = first; index < last; index++) {
+      // Twice the area, which picks the same point
+      const auto area =
+	abs((times[kept] - averageTime) * (values[index] - values[kept]) -
+	    (times[kept] - times[index]) * (averageValue - values[kept]));
+      if (area > largestArea) {
+	largestArea = area;
+	largest = index;
+      }
+    }
+    indices.push_back(largest);
+    kept = largest;
+  }
+
+  indices.push_back(size - 1);
+  return indices;
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param filename output filename
+ * @param width plot width in pixels
+ */
+PlotFile::PlotFile(const string& filename, size_t width) :
+  filename{filename}, width{width} {}
+
+/**
+ * Start collecting the columns
+ *
+ * @param headings column headings
+ */
+auto PlotFile::begin(const string& headings) -> void {
+  columns.begin(headings);
+}
+
+/**
+ * Collect one line of results
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto PlotFile::write(size_t timeStep,
+		     floating timeStamp,
+		     const vector<floating>& fields) -> void {
+  columns.write(timeStep, timeStamp, fields);
+}
+
+/**
+ * Start of a new captured segment, which is reduced separately
+ *
+ * @param index segment number
+ * @param triggerTimeStep time step at which the trigger fired
+ */
+auto PlotFile::segment(size_t, size_t) -> void {
+  segmentStarts.push_back(columns.getRowCount());
+}
+
+/**
+ * Reduce each column, a segment at a time if it was captured, and
+ * write the file
+ */
+auto PlotFile::end() -> void {
+  auto file = ofstream{filename};
+  if (!file) {
+    cout << "Unable to write " << filename << endl;
+    exit(EXIT_FAILURE);
+  }
+  file.precision(9);
+  file << scientific;
+
+  const auto& names = columns.getNames();
+  const auto& data = columns.getColumns();
+  file << "# plot, " << width << ", " << columns.getRowCount() << "\n";
+  if (data.size() < 2) {
+    return;
+  }
+
+  // Where each segment, or the whole run, starts and ends
+  auto ends = segmentStarts.empty() ? vector<size_t>{0} : segmentStarts;
+  ends.push_back(columns.getRowCount());
+
+  // The first two columns are the time step and the time
+  for (auto column = size_t{2}; column < data.size(); column++) {
+    const auto name = column < names.size() ? names.at(column) : string{};
+    for (auto range = size_t{0}; range + 1 < ends.size(); range++) {
+      const auto first = data.at(1).begin() + ends[range];
+      const auto last = data.at(1).begin() + ends[range + 1];
+      const auto times = vector<double>(first, last);
+      const auto values =
+	vector<double>(data.at(column).begin() + ends[range],
+		       data.at(column).begin() + ends[range + 1]);
+      const auto label = segmentStarts.empty() ? name :
+	name + ", segment " + to_string(range);
+
+      file << "# envelope, " << label << "\n";
+      for (auto index : minMaxIndices(values, width)) {
+	file << times[index] << "," << values[index] << "\n";
+      }
+
+      file << "# lttb, " << label << "\n";
+      for (auto index : lttbIndices(times, values, width)) {
+	file << times[index] << "," << values[index] << "\n";
+      }
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/**
+ * Display resolution results for plotting
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "misc.h"
+#include "Output.h"
+
+auto minMaxIndices(const std::vector<double>& values,
+		   std::size_t buckets) -> std::vector<std::size_t>;
+auto lttbIndices(const std::vector<double>& times,
+		 const std::vector<double>& values,
+		 std::size_t points) -> std::vector<std::size_t>;
+
+//===================================================================
+
+/**
+ * Writes the results reduced to about as many points per column as a
+ * plot of the given width in pixels can show, rather than every line.
+ * Each column is written twice.  The envelope has the minimum and the
+ * maximum of each pixel's worth of lines, in the order they happened,
+ * so every peak and glitch is still there when it is drawn as a line.
+ * The LTTB series is chosen by largest triangle three buckets, which
+ * keeps the shape of the trace with one point per pixel.
+ *
+ * The file is comma separated time and value pairs, with a comment
+ * line before each series naming it.  plot.py reads it in place of
+ * the full results file if it is there.  Each segment of a triggered
+ * capture is reduced on its own, with its own series, so no point
+ * stands for lines either side of a gap.
+ */
+class PlotFile : public OutputSink {
+private:
+  const std::string filename;
+  const std::size_t width;
+  ColumnSink columns;
+  std::vector<std::size_t> segmentStarts;
+
+public:
+  PlotFile(const std::string& filename, std::size_t width);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto segment(std::size_t index,
+	       std::size_t triggerTimeStep) -> void override;
+  auto end() -> void override;
+  virtual ~PlotFile() = default;
+};
@@ -0,0 +1,268 @@
+/**
+ * Sweeps that put their points where the response changes
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <set>
+#include <thread>
+#include <vector>
+#include "misc.h"
+
+// Most points an adaptive sweep measures if it isn't told otherwise
+constexpr auto DEFAULT_REFINEMENT_BUDGET = std::size_t{200};
+
+/**
+ * A sweep over one parameter that starts with a coarse grid and then
+ * adds points only where the response isn't a straight line.  A grid
+ * point is tested against the line through its neighbours, and if
+ * any metric is further from it than the tolerance, the intervals
+ * either side of it get a point in the middle.  Each new point is
+ * tested against the line through the ends of its interval in the
+ * same way, halving again where it is off the line, until the
+ * intervals get down to the smallest step.
+ *
+ * The measurements run in a pool of threads, and each new point is
+ * queued as soon as the point that showed it was needed is done,
+ * widest interval first.  Which points get measured depends only on
+ * the points either side of them, so the result is the same however
+ * the threads run, unless the budget runs out first.
+ *
+ * A measurement can decline a point that can't be measured, and the
+ * sweep then leaves it out and doesn't refine either side of it.
+ *
+ * @param Result what a measurement gives
+ */
+template <typename Result>
+class AdaptiveSweep {
+public:
+  using Measure = std::function<auto (floating x) -> std::optional<Result>>;
+  using Metrics = std::function<auto (const Result&) -> std::vector<floating>>;
+
+private:
+  // A point waiting to be measured, and the interval it is the middle
+  // of, if it isn't on the grid
+  struct Job {
+    floating x;
+    floating from;
+    floating to;
+    bool refinement;
+
+    auto operator<(const Job& other) const -> bool {
+      return to - from < other.to - other.from;
+    }
+  };
+
+  const Measure measure;
+  const Metrics metrics;
+  const floating tolerance;
+  const floating minStep;
+  const std::size_t budget;
+  const std::size_t workers;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::priority_queue<Job> pending;
+  std::map<floating, Result> done;
+  std::set<floating> scheduled;
+  std::vector<floating> grid;
+  std::vector<bool> gridTested;
+  std::size_t running = 0;
+  bool budgetReached = false;
+
+  /**
+   * Find out whether a point is further than the tolerance from the
+   * line between two others, in any of the metrics
+   *
+   * @param from point at one end of the line
+   * @param x the point
+   * @param to point at the other end of the line
+   * @return true if it is off the line
+   */
+  auto offLine(floating from, floating x, floating to) const -> bool {
+    const auto before = metrics(done.at(from));
+    const auto middle = metrics(done.at(x));
+    const auto after = metrics(done.at(to));
+    const auto fraction = (x - from) / (to - from);
+    for (auto index = std::size_t{0}; index < middle.size(); index++) {
+      const auto line = before[index] +
+	fraction * (after[index] - before[index]);
+      if (std::isfinite(line) && std::isfinite(middle[index]) &&
+	  std::fabs(middle[index] - line) > tolerance) {
+	return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Queue the middle of an interval to be measured, unless the
+   * interval is already as small as it is allowed to be, or the
+   * budget has been spent
+   *
+   * @param from start of the interval
+   * @param to end of the interval
+   */
+  auto refine(floating from, floating to) -> void {
+    const auto x = (from + to) / 2;
+    if (to - from < 2 * minStep || scheduled.count(x)) {
+      return;
+    }
+    if (scheduled.size() >= budget) {
+      budgetReached = true;
+      return;
+    }
+    scheduled.insert(x);
+    pending.push(Job{x, from, to, true});
+  }
+
+  /**
+   * Decide where else to measure, now that a point has been measured
+   *
+   * @param job the point
+   */
+  auto test(const Job& job) -> void {
+    if (job.refinement) {
+      if (offLine(job.from, job.x, job.to)) {
+	refine(job.from, job.x);
+	refine(job.x, job.to);
+      }
+      return;
+    }
+    for (auto index = std::size_t{1}; index + 1 < grid.size(); index++) {
+      if (!gridTested[index] && done.count(grid[index - 1]) &&
+	  done.count(grid[index]) && done.count(grid[index + 1])) {
+	gridTested[index] = true;
+	if (offLine(grid[index - 1], grid[index], grid[index + 1])) {
+	  refine(grid[index - 1], grid[index]);
+	  refine(grid[index], grid[index + 1]);
+	}
+      }
+    }
+  }
+
+  /**
+   * Measure points until there are none left to measure
+   */
+  auto work() -> void {
+    auto lock = std::unique_lock<std::mutex>{mutex};
+    while (true) {
+      changed.wait(lock, [this]() {
+	  return !pending.empty() || running == 0;
+	});
+      if (pending.empty()) {
+	return;
+      }
+      const auto job = pending.top();
+      pending.pop();
+      running++;
+      lock.unlock();
+      auto result = measure(job.x);
+      lock.lock();
+      running--;
+      if (result) {
+	done.emplace(job.x, std::move(*result));
+	test(job);
+      }
+      changed.notify_all();
+    }
+  }
+
+public:
+  /**
+   * Constructor
+   *
+   * @param measure measures one point, or gives nothing if it can't
+   * @param metrics picks the numbers out of a measurement that
+   *                should follow a straight line
+   * @param tolerance how far from the line they can be
+   * @param minStep smallest interval to halve down to
+   * @param budget most points to measure, including the grid
+   * @param workers number of threads to measure them in
+   */
+  AdaptiveSweep(Measure measure,
+		Metrics metrics,
+		floating tolerance,
+		floating minStep,
+		std::size_t budget = DEFAULT_REFINEMENT_BUDGET,
+		std::size_t workers = std::thread::hardware_concurrency()) :
+    measure{std::move(measure)},
+    metrics{std::move(metrics)},
+    tolerance{tolerance},
+    minStep{minStep},
+    budget{budget},
+    workers{std::max(std::size_t{1}, workers)} {}
+
+  AdaptiveSweep(const AdaptiveSweep&) = delete;
+  AdaptiveSweep& operator=(const AdaptiveSweep&) = delete;
+
+  /**
+   * Run the sweep.  With an infinite tolerance this just measures the
+   * grid, in parallel.
+   *
+   * @param coarseGrid points to start with, in order
+   * @return every point measured, in order
+   */
+  auto run(const std::vector<floating>& coarseGrid)
+    -> std::map<floating, Result> {
+    grid = coarseGrid;
+    gridTested.assign(grid.size(), false);
+    for (auto&& x : grid) {
+      if (scheduled.insert(x).second) {
+	pending.push(Job{x, 0, std::numeric_limits<floating>::infinity(),
+			 false});
+      }
+    }
+
+    auto threads = std::vector<std::thread>{};
+    for (auto index = std::size_t{0}; index < workers; index++) {
+      threads.emplace_back([this]() { work(); });
+    }
+    for (auto&& thread : threads) {
+      thread.join();
+    }
+    return std::move(done);
+  }
+
+  /**
+   * Find out whether the sweep stopped refining because it ran out of
+   * budget, rather than because it had met the tolerance
+   *
+   * @return true if it ran out of budget
+   */
+  auto wasCut() const -> bool {
+    return budgetReached;
+  }
+};
@@ -0,0 +1,189 @@
+/**
+ * Content addressed cache of result files
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include "misc.h"
+#include "ResultCache.h"
+
+using namespace std;
+
+/**
+ * 64 bit FNV-1a hash
+ *
+ * @param text text to hash
+ * @return hash value
+ */
+static auto fnv1a(const string& text) -> uint64_t {
+  auto hash = uint64_t{0xcbf29ce484222325};
+  for (auto&& character : text) {
+    hash ^= static_cast<unsigned char>(character);
+    hash *= uint64_t{0x100000001b3};
+  }
+  return hash;
+}
+
+/**
+ * Read a whole file
+ *
+ * @param filename file to read
+ * @param contents receives the contents
+ * @return false if it couldn't be read
+ */
+static auto readFile(const string& filename, string& contents) -> bool {
+  auto file = ifstream{filename, ios::binary};
+  if (!file) {
+    return false;
+  }
+  auto stream = ostringstream{};
+  stream << file.rdbuf();
+  contents = stream.str();
+  return true;
+}
+
+/**
+ * Copy a file to a temporary name next to its destination, and then
+ * rename it into place
+ *
+ * @param from file to copy
+ * @param to destination
+ * @return false if it couldn't be copied
+ */
+static auto copyAtomically(const string& from, const string& to) -> bool {
+  const auto temporary = to + ".tmp" + to_string(getpid());
+  auto error = error_code{};
+  filesystem::copy_file(from, temporary,
+			filesystem::copy_options::overwrite_existing, error);
+  if (!error) {
+    filesystem::rename(temporary, to, error);
+  }
+  if (error) {
+    filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Add the engine version and the global simulation constants to the
+ * description of a scenario, as they affect all the results
+ *
+ * @param description description of the scenario
+ * @return the full description
+ */
+static auto fullDescription(const string& description) -> string {
+  auto stream = ostringstream{};
+  stream << hexfloat
+	 << "engine " << ENGINE_VERSION << "\n"
+	 << "timestep " << TIME_STEP_SIZE << "\n"
+	 << "extra cycles " << EXTRA_CYCLES << "\n"
+	 << "output resolution " << OUTPUT_RESOLUTION << "\n"
+	 << description;
+  return stream.str();
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param directory where to keep the cached files, which is created
+ *                  if it doesn't exist
+ */
+ResultCache::ResultCache(const string& directory) : directory{directory} {
+  auto error = error_code{};
+  filesystem::create_directories(directory, error);
+  if (error) {
+    cout << "Unable to create cache directory " << directory << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Get the name of a file in the cache
+ *
+ * @param description full description of the scenario
+ * @param extension file extension
+ * @return path to the file
+ */
+auto ResultCache::path(const string& description,
+		       const string& extension) const -> string {
+  auto stream = ostringstream{};
+  stream << hex << setw(16) << setfill('0')
+	 << fnv1a(description) << extension;
+  return (filesystem::path{directory} / stream.str()).string();
+}
+
+/**
+ * Copy the cached results for a scenario to the output file, if
+ * there are any
+ *
+ * @param description exact description of the scenario
+ * @param filename output file
+ * @return true if the results were in the cache
+ */
+auto ResultCache::fetch(const string& description,
+			const string& filename) const -> bool {
+  const auto full = fullDescription(description);
+  auto stored = string{};
+  if (!readFile(path(full, ".key"), stored) || stored != full) {
+    return false;
+  }
+  return copyAtomically(path(full, ".txt"), filename);
+}
+
+/**
+ * Add the results for a scenario to the cache.  Failing to do so
+ * isn't fatal, as the results can always be simulated again.
+ *
+ * @param description exact description of the scenario
+ * @param filename file holding the results
+ */
+auto ResultCache::store(const string& description,
+			const string& filename) const -> void {
+  const auto full = fullDescription(description);
+  const auto key = path(full, ".key");
+  const auto temporary = key + ".tmp" + to_string(getpid());
+  {
+    auto file = ofstream{temporary, ios::binary};
+    file << full;
+  }
+  // The results go in first, so that a key file is never there
+  // without the results it describes
+  auto error = error_code{};
+  if (copyAtomically(filename, path(full, ".txt"))) {
+    filesystem::rename(temporary, key, error);
+  }
+  else {
+    cout << "Unable to cache " << filename << endl;
+  }
+  filesystem::remove(temporary, error);
+}
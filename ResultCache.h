@@ -0,0 +1,58 @@
+/**
+ * Content addressed cache of result files
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+
+// Change this whenever a change to the simulation changes its
+// results, so that results cached by older versions are not reused
+constexpr auto ENGINE_VERSION = 4;
+
+/**
+ * Keeps a copy of each result file, named after a hash of an exact
+ * description of everything that went into it.  If the same scenario
+ * is run again the copy is used instead of simulating it again.  The
+ * description is kept next to the copy, and checked, so that a hash
+ * collision can't give the wrong results.
+ *
+ * Files are written under temporary names and renamed into place, so
+ * that runs sharing a cache never see a partly written file.
+ */
+class ResultCache {
+private:
+  const std::string directory;
+
+  auto path(const std::string& description,
+	    const std::string& extension) const -> std::string;
+
+public:
+  ResultCache(const std::string& directory);
+  auto fetch(const std::string& description,
+	     const std::string& filename) const -> bool;
+  auto store(const std::string& description,
+	     const std::string& filename) const -> void;
+};
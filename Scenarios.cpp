@@ -0,0 +1,206 @@
+/**
+ * The standard scenarios that program and verify run
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "Scenarios.h"
+
+using namespace std;
+
+/**
+ * Get the scenarios that make up the plots in the report, in the
+ * order that program runs them.
+ *
+ * @param modulation modulation of the wanted 7 MHz carrier in the
+ *                   modulated scenarios
+ * @return the scenarios
+ */
+auto standardScenarios(const Modulation& modulation) -> vector<Scenario> {
+
+  // Signals to use
+  const auto unmodulatedSignal = Signal{CARRIER_AMPLITUDE,
+					CARRIER_FREQUENCY,
+					NO_MODULATION};
+
+  const auto modulatedSignal = Signal{CARRIER_AMPLITUDE,
+				      CARRIER_FREQUENCY,
+				      modulation};
+
+  // Same signal as before but with additional signal 0.5 MHz away
+  auto adjacentSignal = modulatedSignal;
+  adjacentSignal.add(CARRIER_AMPLITUDE,
+		     ADJ_CARRIER_FREQUENCY,
+		     ADJ_MODULATION_FREQUENCY);
+
+  // The ZetaSDR radio simulation and the IQ mixer tune themselves to
+  // the first element of the signal object.  So swap the two elements
+  // over to get these simulators to tune to the adjacent frequency
+  // instead.
+  auto tunedToAdjacentSignal = Signal(CARRIER_AMPLITUDE,
+				      ADJ_CARRIER_FREQUENCY,
+				      ADJ_MODULATION_FREQUENCY);
+  tunedToAdjacentSignal.add(CARRIER_AMPLITUDE,
+			    CARRIER_FREQUENCY,
+			    modulation);
+
+  return {
+    /*
+     * Unmodulated carrier, in phase with local oscillator
+     */
+    {"zetasdr_unmodulated_0", Receiver::ZETASDR, 4,
+     unmodulatedSignal, 0},
+
+    /*
+     * Unmodulated carrier, with 35 degree phase difference in start
+     * state compared to local oscillator
+     */
+    {"zetasdr_unmodulated_35", Receiver::ZETASDR, 4,
+     unmodulatedSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Modulated carrier, in phase with local oscillator
+     */
+    {"zetasdr_modulated_0", Receiver::ZETASDR, CYCLES,
+     modulatedSignal, 0},
+
+    /*
+     * Modulated carrier with 35 degree phase difference in initial
+     * state compared to local oscillator
+     */
+    {"zetasdr_modulated_35", Receiver::ZETASDR, CYCLES,
+     modulatedSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Modulated carrier with 35 degree phase difference in initial
+     * state compared to local oscillator, plus another signal 0.5 MHz
+     * higher frequency.
+     */
+    {"zetasdr_adjacent_35", Receiver::ZETASDR, CYCLES,
+     adjacentSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Ideal multiplying IQ mixer.
+     */
+    {"iq_modulated_0", Receiver::IQMIXER, CYCLES,
+     modulatedSignal, 0},
+
+    /*
+     * Ideal multiplying IQ mixer with 35 degree phase difference
+     */
+    {"iq_modulated_35", Receiver::IQMIXER, CYCLES,
+     modulatedSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Ideal multiplying IQ mixer with adjacent signal present
+     */
+    {"iq_adjacent_35", Receiver::IQMIXER, CYCLES,
+     adjacentSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Tune the ZetaSDR to the adjacent channel and see what that looks
+     * like.
+     */
+    {"zetasdr_tuned_adjacent_35", Receiver::ZETASDR, CYCLES,
+     tunedToAdjacentSignal, PHASE_ANGLE_DEGREES},
+
+    /*
+     * Tune the IQ mixer to the adjacent channel and see what that looks
+     * like.
+     */
+    {"iq_tuned_adjacent_35", Receiver::IQMIXER, CYCLES,
+     tunedToAdjacentSignal, PHASE_ANGLE_DEGREES}
+  };
+}
+
+//===================================================================
+
+/**
+ * Parse a crowded band specification, stations[:spanHz[:seed]]
+ *
+ * @param specification the specification
+ * @return the settings
+ */
+auto BandSettings::parse(const string& specification) -> BandSettings {
+  auto stream = istringstream{specification};
+  auto parts = vector<string>{};
+  auto part = string{};
+  while (getline(stream, part, ':')) {
+    parts.push_back(part);
+  }
+
+  auto settings = BandSettings{0, BAND_SPAN, 1};
+  try {
+    if (!parts.empty() && parts.size() <= 3) {
+      settings.stations = stoul(parts.at(0));
+      if (parts.size() > 1) {
+	settings.spanHz = stold(parts.at(1));
+      }
+      if (parts.size() > 2) {
+	settings.seed = stoull(parts.at(2));
+      }
+    }
+  }
+  catch (const logic_error&) {
+    settings.stations = 0;
+  }
+
+  if (settings.stations == 0 || settings.spanHz <= 2 * BAND_GUARD) {
+    cout << "Bad band specification " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+  return settings;
+}
+
+/**
+ * Add a crowded band of AM stations to a signal, spread at random
+ * over the span around its first carrier, but not within the guard of
+ * it.  The same settings always give the same stations.
+ *
+ * @param signal signal to add them to
+ * @param settings the band
+ */
+auto addCrowdedBand(Signal& signal, const BandSettings& settings) -> void {
+  const auto wantedHz = signal.getCarrierFreqHz(0);
+  auto generator = mt19937_64{settings.seed};
+  auto offset = uniform_real_distribution<double>{
+    static_cast<double>(BAND_GUARD), static_cast<double>(settings.spanHz / 2)};
+  auto side = bernoulli_distribution{0.5};
+  auto amplitude = uniform_real_distribution<double>{0.1, 1};
+  auto tone = uniform_real_distribution<double>{
+    static_cast<double>(BAND_LOWEST_TONE),
+    static_cast<double>(BAND_HIGHEST_TONE)};
+  auto phase = uniform_real_distribution<double>{0, 360};
+
+  for (auto station = size_t{0}; station < settings.stations; station++) {
+    const auto stationOffset = offset(generator);
+    const auto frequencyHz = side(generator) ? wantedHz + stationOffset :
+      wantedHz - stationOffset;
+    const auto stationAmplitude = amplitude(generator) * CARRIER_AMPLITUDE;
+    const auto stationTone = tone(generator);
+    signal.add(stationAmplitude, frequencyHz, stationTone, phase(generator));
+  }
+}
@@ -0,0 +1,131 @@
+/**
+ * The standard scenarios that program and verify run
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "misc.h"
+#include "Modulation.h"
+#include "Signal.h"
+
+// 7 MHz RF carrier frequency
+constexpr auto CARRIER_FREQUENCY =  floating{7e6};
+
+// 100 kHz amplitude modulation
+constexpr auto MODULATION_FREQUENCY = floating{1e5};
+
+// 7.5 MHz adjacent frequency
+constexpr auto ADJ_CARRIER_FREQUENCY = floating{7.6e6};
+
+// 83 kHz adjacent signal amplitude modulation
+constexpr auto ADJ_MODULATION_FREQUENCY = floating{8.3e4};
+
+// Use this where we don't want modulation
+constexpr auto NO_MODULATION = floating{0};
+
+// 1 mV
+constexpr auto CARRIER_AMPLITUDE = floating{1e-3};
+
+constexpr auto PHASE_ANGLE_DEGREES = floating{35};
+
+// Two 74HC4052 channels in parallel at 70 ohms each
+// = 50 ohm antenna impedance + 35 ohm through 74HC4052
+constexpr auto RESISTANCE = floating{85};
+
+// Detector capacitors C2-C5
+constexpr auto CAPACITANCE = floating{0.022e-6}; // 0.022 uF
+
+// 400 kHz cutoff
+constexpr auto FILTER_CUTOFF = floating{4e5};
+
+// Number of carrier cycles
+constexpr auto CYCLES = 200;
+
+// Time each chunk of a chunked run is given to settle.  The low pass
+// filter takes the longest, and this is several of its time constants
+constexpr auto DEFAULT_CHUNK_OVERLAP = floating{10e-6};
+
+/**
+ * The ZetaSDR circuit above as compile time constants, for the
+ * detector that has it built in
+ */
+struct ZetaSdrDesign {
+  static constexpr auto resistance = RESISTANCE;
+  static constexpr auto capacitance = CAPACITANCE;
+  static constexpr auto lpFreqHz = FILTER_CUTOFF;
+};
+
+// Width of the crowded band around the wanted carrier, the whole of
+// the 40 m band in ITU region 2
+constexpr auto BAND_SPAN = floating{3e5};
+
+// Stations in the crowded band are kept this far from the wanted carrier
+constexpr auto BAND_GUARD = floating{1e4};
+
+// Range of the stations' AM audio tones
+constexpr auto BAND_LOWEST_TONE = floating{300};
+constexpr auto BAND_HIGHEST_TONE = floating{3000};
+
+//===================================================================
+
+/**
+ * Crowded band of AM stations around the wanted carrier, at random
+ * frequencies, amplitudes, tones and phases
+ */
+struct BandSettings {
+  std::size_t stations;
+  floating spanHz;
+  std::uint64_t seed;
+
+  static auto parse(const std::string& specification) -> BandSettings;
+};
+
+//===================================================================
+
+// Which simulation a scenario runs
+enum class Receiver {
+  ZETASDR,
+  IQMIXER
+};
+
+/**
+ * One run of one of the simulations.  The name is the output filename
+ * without the .txt.
+ */
+struct Scenario {
+  std::string name;
+  Receiver receiver;
+  std::size_t cycleCount;
+  Signal signal;
+  floating phaseAngleDeg;
+};
+
+auto standardScenarios(const Modulation& modulation)
+  -> std::vector<Scenario>;
+auto addCrowdedBand(Signal& signal, const BandSettings& settings) -> void;
@@ -0,0 +1,254 @@
+/**
+ * Selectivity and image rejection measurement
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include "Mixer.h"
+#include "Selectivity.h"
+#include "Signal.h"
+
+using namespace std;
+
+// Rate at which the Goertzel detectors see samples
+constexpr auto SAMPLE_RATE_HZ = 1 / (SELECTIVITY_SAMPLE_STEP * TIME_STEP_SIZE);
+
+/**
+ * Check that a level hasn't changed since the last window
+ *
+ * @param previous level in the last window
+ * @param latest level in this window
+ * @param reference level that counts as being passed in full
+ * @param tolerance largest change, relative to the level
+ * @return true if it hasn't changed
+ */
+static auto settled(floating previous,
+		    floating latest,
+		    floating reference,
+		    floating tolerance) -> bool {
+  return abs(latest - previous) <=
+    tolerance * max(latest, SELECTIVITY_FLOOR * reference);
+}
+
+/**
+ * Convert an amplitude ratio to dB
+ *
+ * @param ratio amplitude ratio
+ * @return the ratio in dB
+ */
+static auto decibels(floating ratio) -> floating {
+  return 20 * log10(ratio);
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param offsetHz frequency of the interfering carrier relative to
+ *                 the wanted one, which mustn't be zero
+ * @param tolerance largest relative change in the levels between one
+ *                  window and the next for the measurement to be
+ *                  finished
+ */
+SelectivityProbe::SelectivityProbe(floating offsetHz, floating tolerance) :
+  tolerance{tolerance},
+  windowLength{static_cast<size_t>(round(SELECTIVITY_WINDOW_CYCLES *
+					 SAMPLE_RATE_HZ / abs(offsetHz)))},
+  inphaseWanted{0, SAMPLE_RATE_HZ},
+  quadratureWanted{0, SAMPLE_RATE_HZ},
+  inphaseOffset{abs(offsetHz), SAMPLE_RATE_HZ},
+  quadratureOffset{abs(offsetHz), SAMPLE_RATE_HZ},
+  demodulatedWanted{0, SAMPLE_RATE_HZ},
+  demodulatedBeat{abs(offsetHz), SAMPLE_RATE_HZ} {}
+
+/**
+ * Pass the next block of outputs to the Goertzel detectors
+ *
+ * @param firstTimeStep time step of the first entry
+ * @param count number of time steps
+ * @param inphase filtered inphase output
+ * @param quadrature filtered quadrature output
+ * @return false once the levels have converged
+ */
+auto SelectivityProbe::observe(size_t firstTimeStep,
+			       size_t count,
+			       const double* inphase,
+			       const double* quadrature) -> bool {
+  for (auto index = size_t{0}; index < count; index++) {
+    if ((firstTimeStep + index) % SELECTIVITY_SAMPLE_STEP != 0) {
+      continue;
+    }
+
+    // Hann window
+    auto weight = floating{0.5} - floating{0.5} *
+      cos(2 * M_PI * windowPosition / windowLength);
+    inphaseWanted.add(inphase[index], weight);
+    quadratureWanted.add(quadrature[index], weight);
+    inphaseOffset.add(inphase[index], weight);
+    quadratureOffset.add(quadrature[index], weight);
+
+    // Envelope, which is what the demodulator gives apart from its DC
+    // offset
+    auto envelope = hypot(floating{inphase[index]},
+			  floating{quadrature[index]});
+    demodulatedWanted.add(envelope, weight);
+    demodulatedBeat.add(envelope, weight);
+
+    if (++windowPosition == windowLength) {
+      endWindow();
+      if (converged) {
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * Work out the levels at the end of a window, see if they have
+ * converged, and start the next window
+ */
+auto SelectivityProbe::endWindow() -> void {
+  const auto inphase = inphaseOffset.getBin();
+  const auto quadrature = quadratureOffset.getBin();
+  const auto j = complex<floating>{0, 1};
+
+  // The I/Q output is a complex signal, so the interferer and its
+  // image are at opposite frequencies.  Whichever is larger is the
+  // interferer.
+  const auto positive = abs(inphase + j * quadrature);
+  const auto negative = abs(conj(inphase) + j * conj(quadrature));
+
+  const auto levels = Levels{
+    abs(inphaseWanted.getBin() + j * quadratureWanted.getBin()),
+    max(positive, negative),
+    min(positive, negative),
+    demodulatedWanted.getAmplitude(),
+    demodulatedBeat.getAmplitude()
+  };
+
+  if (latest) {
+    const auto reference = levels.wanted * INTERFERER_LEVEL;
+    const auto demodulatedReference =
+      levels.demodulatedWanted * INTERFERER_LEVEL;
+    converged =
+      settled(latest->wanted, levels.wanted, levels.wanted, tolerance) &&
+      settled(latest->interferer, levels.interferer, reference, tolerance) &&
+      settled(latest->image, levels.image, reference, tolerance) &&
+      settled(latest->demodulatedWanted, levels.demodulatedWanted,
+	      levels.demodulatedWanted, tolerance) &&
+      settled(latest->demodulatedBeat, levels.demodulatedBeat,
+	      demodulatedReference, tolerance);
+  }
+  latest = levels;
+
+  windowPosition = 0;
+  inphaseWanted.reset();
+  quadratureWanted.reset();
+  inphaseOffset.reset();
+  quadratureOffset.reset();
+  demodulatedWanted.reset();
+  demodulatedBeat.reset();
+}
+
+/**
+ * Get the measurement from the last complete window
+ *
+ * @param interfererHz interfering carrier frequency
+ * @param timeSteps number of time steps simulated
+ * @return the measurement, with NaN levels if not even one window
+ *         was completed
+ */
+auto SelectivityProbe::getPoint(floating interfererHz,
+				size_t timeSteps) const -> SelectivityPoint {
+  auto point = SelectivityPoint{interfererHz,
+				numeric_limits<floating>::quiet_NaN(),
+				numeric_limits<floating>::quiet_NaN(),
+				numeric_limits<floating>::quiet_NaN(),
+				timeSteps,
+				converged};
+  if (latest) {
+    point.selectivityDb =
+      decibels(latest->interferer / (latest->wanted * INTERFERER_LEVEL));
+    point.imageRejectionDb = decibels(latest->interferer / latest->image);
+    point.demodulatedDb =
+      decibels(latest->demodulatedBeat /
+	       (latest->demodulatedWanted * INTERFERER_LEVEL));
+  }
+  return point;
+}
+
+//===================================================================
+
+/**
+ * Measure how well a receiver tuned to CARRIER_FREQUENCY rejects an
+ * unmodulated interfering carrier.  The simulation only runs until
+ * the levels have converged.
+ *
+ * @param receiver which receiver to simulate
+ * @param interfererHz interfering carrier frequency
+ * @param phaseAngleDeg phase of the wanted carrier compared to the
+ *                      local oscillator
+ * @param tolerance largest relative change in the levels between one
+ *                  window and the next for the measurement to be
+ *                  finished
+ * @param maxTimeSteps give up after this many time steps
+ * @param detectorPhases number of phases of the ZetaSDR's Tayloe
+ *                       detector
+ * @return the measurement
+ */
+auto measureSelectivity(Receiver receiver,
+			floating interfererHz,
+			floating phaseAngleDeg,
+			floating tolerance,
+			size_t maxTimeSteps,
+			size_t detectorPhases) -> SelectivityPoint {
+  auto signal = Signal{CARRIER_AMPLITUDE, CARRIER_FREQUENCY, NO_MODULATION};
+  signal.add(CARRIER_AMPLITUDE * INTERFERER_LEVEL, interfererHz,
+	     NO_MODULATION);
+
+  if (interfererHz == CARRIER_FREQUENCY) {
+    cout << "The interfering carrier can't be on the wanted carrier"
+	 << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto probe = SelectivityProbe{interfererHz - CARRIER_FREQUENCY, tolerance};
+  auto timeSteps = size_t{0};
+  if (receiver == Receiver::ZETASDR) {
+    const auto circuit = Circuit{RESISTANCE, CAPACITANCE, FILTER_CUTOFF};
+    auto zetasdr = ZetaSdr{circuit};
+    zetasdr.setPhases(detectorPhases);
+    timeSteps = zetasdr.measure(probe, maxTimeSteps, signal, phaseAngleDeg);
+  }
+  else {
+    auto iqmixer = IqMixer{FILTER_CUTOFF};
+    timeSteps = iqmixer.measure(probe, maxTimeSteps, signal, phaseAngleDeg);
+  }
+  return probe.getPoint(interfererHz, timeSteps);
+}
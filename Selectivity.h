@@ -0,0 +1,117 @@
+/**
+ * Selectivity and image rejection measurement
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include "misc.h"
+#include "Goertzel.h"
+#include "Output.h"
+#include "Scenarios.h"
+
+// Time steps between the samples that the Goertzel detectors see
+constexpr auto SELECTIVITY_SAMPLE_STEP = std::size_t{100};
+
+// Cycles of the offset frequency in each measurement window
+constexpr auto SELECTIVITY_WINDOW_CYCLES = 4;
+
+// Interfering carrier amplitude relative to the wanted carrier.  It
+// is small so that the demodulator stays linear for the beat between
+// them.
+constexpr auto INTERFERER_LEVEL = floating{0.1};
+
+// Levels below this, relative to an interferer that is passed as well
+// as the wanted carrier, only have to converge to this absolute level
+constexpr auto SELECTIVITY_FLOOR = floating{1e-4};
+
+/**
+ * Result of measuring one interfering carrier frequency.  The levels
+ * are in dB relative to the wanted carrier, corrected for the
+ * interferer being weaker, so 0 dB means the interferer gets through
+ * as well as the wanted carrier does.
+ */
+struct SelectivityPoint {
+  floating interfererHz;
+  // Level of the interferer in the filtered I/Q output
+  floating selectivityDb;
+  // Level of the interferer relative to its image in the I/Q output
+  floating imageRejectionDb;
+  // Level of the beat between the interferer and the wanted carrier
+  // in the demodulated output
+  floating demodulatedDb;
+  std::size_t timeSteps;
+  bool converged;
+};
+
+/**
+ * Watches the filtered I/Q outputs of a receiver tuned to a wanted
+ * carrier, with an interfering carrier at an offset.  It measures
+ * the wanted carrier at 0 Hz, and the interferer and its image at
+ * plus and minus the offset, with Goertzel detectors over successive
+ * Hann windows.  It stops when a window gives the same answer as the
+ * one before, to within the tolerance.
+ */
+class SelectivityProbe : public BasebandProbe {
+private:
+  struct Levels {
+    floating wanted;
+    floating interferer;
+    floating image;
+    floating demodulatedWanted;
+    floating demodulatedBeat;
+  };
+
+  const floating tolerance;
+  const std::size_t windowLength;
+  std::size_t windowPosition = 0;
+  Goertzel inphaseWanted;
+  Goertzel quadratureWanted;
+  Goertzel inphaseOffset;
+  Goertzel quadratureOffset;
+  Goertzel demodulatedWanted;
+  Goertzel demodulatedBeat;
+  std::optional<Levels> latest;
+  bool converged = false;
+
+  auto endWindow() -> void;
+
+public:
+  SelectivityProbe(floating offsetHz, floating tolerance);
+  auto observe(std::size_t firstTimeStep,
+	       std::size_t count,
+	       const double* inphase,
+	       const double* quadrature) -> bool override;
+  auto getPoint(floating interfererHz,
+		std::size_t timeSteps) const -> SelectivityPoint;
+};
+
+auto measureSelectivity(Receiver receiver,
+			floating interfererHz,
+			floating phaseAngleDeg,
+			floating tolerance,
+			std::size_t maxTimeSteps,
+			std::size_t detectorPhases) -> SelectivityPoint;
@@ -0,0 +1,647 @@
+/**
+ * Simulation server, which keeps its caches warm between requests
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include "Butterworth.h"
+#include "Mixer.h"
+#include "Server.h"
+
+using namespace std;
+
+/**
+ * Split a string at a separator
+ *
+ * @param text string to split
+ * @param separator character between the parts
+ * @return the parts
+ */
+static auto split(const string& text, char separator) -> vector<string> {
+  auto parts = vector<string>{};
+  auto stream = istringstream{text};
+  auto part = string{};
+  while (getline(stream, part, separator)) {
+    parts.push_back(part);
+  }
+  return parts;
+}
+
+/**
+ * Send all of a buffer down a socket
+ *
+ * @param connection the socket
+ * @param data what to send
+ * @param length its length in bytes
+ * @return false if the client has gone
+ */
+static auto sendAll(int connection, const char* data, size_t length) -> bool {
+  while (length) {
+    const auto count = ::send(connection, data, length, MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    data += count;
+    length -= count;
+  }
+  return true;
+}
+
+//===================================================================
+
+/**
+ * Parse a request line
+ *
+ * @param line KEY=VALUE words separated by spaces
+ * @return the request
+ */
+auto ServerRequest::parse(const string& line) -> ServerRequest {
+  auto request = ServerRequest{Receiver::ZETASDR, CYCLES,
+			       PHASE_ANGLE_DEGREES, {},
+			       RESISTANCE, CAPACITANCE, FILTER_CUTOFF,
+			       4, {}};
+  request.signal.emplace(CARRIER_AMPLITUDE, CARRIER_FREQUENCY,
+			 MODULATION_FREQUENCY);
+
+  auto stream = istringstream{line};
+  auto word = string{};
+  auto carriers = size_t{0};
+  while (stream >> word) {
+    const auto equals = word.find('=');
+    if (equals == string::npos) {
+      throw invalid_argument{"Expected KEY=VALUE, not " + word};
+    }
+    const auto key = word.substr(0, equals);
+    const auto value = word.substr(equals + 1);
+
+    if (key == "scenario") {
+      const auto scenarios =
+	standardScenarios(AmModulation{MODULATION_FREQUENCY});
+      const auto scenario = find_if(scenarios.begin(), scenarios.end(),
+				    [&](const Scenario& candidate) {
+				      return candidate.name == value;
+				    });
+      if (scenario == scenarios.end()) {
+	throw invalid_argument{"No scenario called " + value};
+      }
+      request.receiver = scenario->receiver;
+      request.cycleCount = scenario->cycleCount;
+      request.signal.emplace(scenario->signal);
+      request.phaseAngleDeg = scenario->phaseAngleDeg;
+    }
+    else if (key == "receiver") {
+      if (value != "zetasdr" && value != "iqmixer") {
+	throw invalid_argument{"The receiver is zetasdr or iqmixer, not " +
+			       value};
+      }
+      request.receiver = value == "zetasdr" ?
+	Receiver::ZETASDR : Receiver::IQMIXER;
+    }
+    else if (key == "cycles") {
+      request.cycleCount = stoul(value);
+      if (request.cycleCount > SERVER_MAX_TIME_STEPS) {
+	throw invalid_argument{"Too many cycles, " + value};
+      }
+    }
+    else if (key == "phase") {
+      request.phaseAngleDeg = stold(value);
+    }
+    else if (key == "carrier") {
+      const auto fields = split(value, ':');
+      if (fields.size() < 3 || fields.size() > 4) {
+	throw invalid_argument{"A carrier is AMPLITUDE:FREQUENCY:MODULATION"
+			       "[:PHASE], not " + value};
+      }
+      const auto amplitude = stold(fields[0]);
+      const auto frequency = stold(fields[1]);
+      const auto modulation = stold(fields[2]);
+      const auto phase = fields.size() > 3 ? stold(fields[3]) : 0;
+      checkCarrier(amplitude, frequency, modulation, phase);
+      if (carriers++ == 0) {
+	request.signal.emplace(amplitude, frequency, modulation, phase);
+      }
+      else {
+	request.signal->add(amplitude, frequency, modulation, phase);
+      }
+    }
+    else if (key == "resistance") {
+      request.resistance = stold(value);
+    }
+    else if (key == "capacitance") {
+      request.capacitance = stold(value);
+    }
+    else if (key == "cutoff") {
+      request.lpFreqHz = stold(value);
+    }
+    else if (key == "phases") {
+      request.phases = stoul(value);
+      if (request.phases != 4 && request.phases != 8 &&
+	  request.phases != 16) {
+	throw invalid_argument{"The detector can have 4, 8 or 16 phases, "
+			       "not " + value};
+      }
+    }
+    else if (key == "columns") {
+      request.columns = split(value, ',');
+    }
+    else {
+      throw invalid_argument{"Unknown key " + key};
+    }
+  }
+
+  if (!(request.resistance > 0 && request.capacitance > 0) ||
+      !isfinite(request.resistance) || !isfinite(request.capacitance)) {
+    throw invalid_argument{"The circuit values must be positive"};
+  }
+  checkCutoff(request.lpFreqHz);
+
+  const auto timeSteps = (request.cycleCount + EXTRA_CYCLES) *
+    request.signal->getTimeStepsPerCarrierCycle(0);
+  if (timeSteps > SERVER_MAX_TIME_STEPS) {
+    throw invalid_argument{"The run would be longer than " +
+			   to_string(SERVER_MAX_TIME_STEPS) + " time steps"};
+  }
+  return request;
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param maxBytes most memory to take for the results
+ */
+ResultMemory::ResultMemory(size_t maxBytes) : maxBytes{maxBytes} {}
+
+/**
+ * Look for a result
+ *
+ * @param description exact description of the run
+ * @return its text, or null if it isn't kept
+ */
+auto ResultMemory::find(const string& description)
+  -> shared_ptr<const string> {
+  auto lock = lock_guard<std::mutex>{mutex};
+  const auto entry = entries.find(description);
+  if (entry == entries.end()) {
+    return nullptr;
+  }
+  uses.splice(uses.end(), uses, entry->second.use);
+  return entry->second.text;
+}
+
+/**
+ * Keep a result, dropping the least recently used ones if there is
+ * no longer room for everything
+ *
+ * @param description exact description of the run
+ * @param text the results
+ */
+auto ResultMemory::keep(const string& description,
+			shared_ptr<const string> text) -> void {
+  auto lock = lock_guard<std::mutex>{mutex};
+  if (text->size() > maxBytes || entries.count(description)) {
+    return;
+  }
+  bytes += text->size();
+  uses.push_back(description);
+  entries.emplace(description, Entry{move(text), prev(uses.end())});
+  while (bytes > maxBytes) {
+    const auto oldest = entries.find(uses.front());
+    bytes -= oldest->second.text->size();
+    entries.erase(oldest);
+    uses.pop_front();
+  }
+}
+
+/**
+ * Get the number of results kept
+ *
+ * @return the count
+ */
+auto ResultMemory::getCount() -> size_t {
+  auto lock = lock_guard<std::mutex>{mutex};
+  return entries.size();
+}
+
+/**
+ * Get the memory taken by the results kept
+ *
+ * @return size in bytes
+ */
+auto ResultMemory::getBytes() -> size_t {
+  auto lock = lock_guard<std::mutex>{mutex};
+  return bytes;
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param columns names of the columns to keep, all of them if empty
+ * @param send gets the text as it is written
+ */
+CsvText::CsvText(const vector<string>& columns,
+		 function<auto (const char* data, size_t length) -> void>
+		 send) :
+  wanted{columns}, send{move(send)} {
+  line.precision(9);
+  line << scientific;
+}
+
+/**
+ * Work out where the wanted columns are, and write their headings
+ *
+ * @param headings column headings
+ */
+auto CsvText::begin(const string& headings) -> void {
+  const auto names = splitHeadings(headings);
+  columns.clear();
+  for (auto&& name : wanted) {
+    const auto found = find(names.begin(), names.end(), name);
+    if (found == names.end()) {
+      throw invalid_argument{"No column called " + name};
+    }
+    columns.push_back(found - names.begin());
+  }
+
+  text += "# ";
+  if (wanted.empty()) {
+    text += headings;
+  }
+  else {
+    for (auto&& name : wanted) {
+      text += (&name == &wanted.front() ? "" : ", ") + name;
+    }
+  }
+  text += "\n";
+}
+
+/**
+ * Write one line of results
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto CsvText::write(size_t timeStep,
+		    floating timeStamp,
+		    const vector<floating>& fields) -> void {
+  line.str("");
+  if (columns.empty()) {
+    line << timeStep << "," << timeStamp;
+    for (auto&& field : fields) {
+      line << "," << field;
+    }
+  }
+  else {
+    for (auto&& column : columns) {
+      if (&column != &columns.front()) {
+	line << ",";
+      }
+      if (column == 0) {
+	line << timeStep;
+      }
+      else if (column == 1) {
+	line << timeStamp;
+      }
+      else {
+	line << fields.at(column - 2);
+      }
+    }
+  }
+  line << "\n";
+  text += line.str();
+  sendWaiting(SERVER_SEND_BYTES);
+}
+
+/**
+ * Send whatever hasn't been sent yet
+ */
+auto CsvText::end() -> void {
+  sendWaiting(1);
+}
+
+/**
+ * Send what hasn't been sent yet, if there's enough of it
+ *
+ * @param atLeast least number of bytes worth sending
+ */
+auto CsvText::sendWaiting(size_t atLeast) -> void {
+  if (text.size() - sent >= atLeast) {
+    send(text.data() + sent, text.size() - sent);
+    sent = text.size();
+  }
+}
+
+//===================================================================
+
+/**
+ * Constructor creates the socket and starts listening on it.  If
+ * there is already a socket there that nothing is listening on, it
+ * is left over from a server that didn't exit cleanly, and replaced.
+ *
+ * @param socketPath filename of the socket
+ * @param maxRunning most simulations to run at once
+ * @param memoryBytes most memory to take for the results kept
+ */
+SimulationServer::SimulationServer(const string& socketPath,
+				   size_t maxRunning,
+				   size_t memoryBytes) :
+  socketPath{socketPath},
+  maxRunning{max(size_t{1}, maxRunning)},
+  waveforms{make_shared<WaveformCache>()},
+  results{memoryBytes} {
+  auto address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    cout << "Socket name " << socketPath << " is too long" << endl;
+    exit(EXIT_FAILURE);
+  }
+  strcpy(address.sun_path, socketPath.c_str());
+  const auto socketAddress = reinterpret_cast<const sockaddr*>(&address);
+
+  listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listener < 0) {
+    cout << "Unable to create a socket" << endl;
+    exit(EXIT_FAILURE);
+  }
+  if (bind(listener, socketAddress, sizeof(address)) != 0 &&
+      errno == EADDRINUSE) {
+    const auto probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const auto inUse = connect(probe, socketAddress, sizeof(address)) == 0;
+    close(probe);
+    if (inUse) {
+      cout << "There is already a server on " << socketPath << endl;
+      exit(EXIT_FAILURE);
+    }
+    unlink(socketPath.c_str());
+    bind(listener, socketAddress, sizeof(address));
+  }
+  if (listen(listener, SOMAXCONN) != 0) {
+    cout << "Unable to listen on " << socketPath << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Take connections until told to stop, giving each one a thread of
+ * its own.  The threads don't take the signals that stop the server,
+ * so that they interrupt the wait for a connection.
+ *
+ * @param stop set by a signal handler to stop the server
+ */
+auto SimulationServer::serve(const volatile sig_atomic_t& stop) -> void {
+  auto stopSignals = sigset_t{};
+  sigemptyset(&stopSignals);
+  sigaddset(&stopSignals, SIGINT);
+  sigaddset(&stopSignals, SIGTERM);
+
+  cout << "Listening on " << socketPath << endl;
+  while (!stop) {
+    const auto connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+	continue;
+      }
+      cout << "Unable to accept a connection: " << strerror(errno) << endl;
+      return;
+    }
+
+    {
+      auto lock = lock_guard<std::mutex>{mutex};
+      connections.push_back(connection);
+    }
+    auto previous = sigset_t{};
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+    thread{[this, connection]() { converse(connection); }}.detach();
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+  }
+}
+
+/**
+ * Answer the requests on one connection until the client closes it
+ *
+ * @param connection the connection
+ */
+auto SimulationServer::converse(int connection) -> void {
+  auto buffer = string{};
+  auto chunk = array<char, 4096>{};
+  auto open = true;
+  while (open) {
+    const auto count = recv(connection, chunk.data(), chunk.size(), 0);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      break;
+    }
+    buffer.append(chunk.data(), count);
+
+    auto newline = string::npos;
+    while (open && (newline = buffer.find('\n')) != string::npos) {
+      auto line = buffer.substr(0, newline);
+      buffer.erase(0, newline + 1);
+      if (!line.empty() && line.back() == '\r') {
+	line.pop_back();
+      }
+      if (line.find_first_not_of(" \t") != string::npos) {
+	open = answer(connection, line);
+      }
+    }
+    if (buffer.size() > SERVER_REQUEST_LENGTH) {
+      const auto error = "# error Request too long\n"s;
+      sendAll(connection, error.data(), error.size());
+      break;
+    }
+  }
+
+  auto lock = lock_guard<std::mutex>{mutex};
+  connections.erase(find(connections.begin(), connections.end(),
+			 connection));
+  close(connection);
+  changed.notify_all();
+}
+
+/**
+ * Answer one request, from the results kept if it has been asked
+ * for before, otherwise by simulating it
+ *
+ * @param connection where the answer goes
+ * @param line the request
+ * @return false if the client has gone
+ */
+auto SimulationServer::answer(int connection, const string& line) -> bool {
+  if (line == "status") {
+    const auto text = status() + "# end\n";
+    return sendAll(connection, text.data(), text.size());
+  }
+
+  {
+    auto lock = lock_guard<std::mutex>{mutex};
+    requestCount++;
+  }
+  auto trailer = string{};
+  try {
+    const auto request = ServerRequest::parse(line);
+    const auto circuit = Circuit{request.resistance,
+				 request.capacitance,
+				 request.lpFreqHz};
+    auto zetasdr = ZetaSdr{circuit};
+    zetasdr.setPhases(request.phases);
+    auto description = request.receiver == Receiver::ZETASDR ?
+      zetasdr.describe(request.cycleCount, *request.signal,
+		       request.phaseAngleDeg) :
+      IqMixer{request.lpFreqHz}.describe(request.cycleCount,
+					 *request.signal,
+					 request.phaseAngleDeg);
+    description += "columns";
+    for (auto&& column : request.columns) {
+      description += " " + column;
+    }
+    description += "\n";
+
+    if (auto text = results.find(description)) {
+      if (!sendAll(connection, text->data(), text->size())) {
+	return false;
+      }
+      trailer = "# end from memory\n";
+    }
+    else {
+      const auto start = chrono::steady_clock::now();
+      simulate(request, description, connection);
+      const auto seconds = chrono::duration<double>(
+	chrono::steady_clock::now() - start).count();
+      trailer = "# end simulated in " + to_string(seconds) + " s\n";
+    }
+  }
+  catch (const exception& e) {
+    trailer = "# error "s + e.what() + "\n";
+  }
+  return sendAll(connection, trailer.data(), trailer.size());
+}
+
+/**
+ * Run a simulation once there is room for it, sending the results as
+ * they are written and keeping them for next time
+ *
+ * @param request what to simulate
+ * @param description exact description of the run
+ * @param connection where the results go
+ */
+auto SimulationServer::simulate(const ServerRequest& request,
+				const string& description,
+				int connection) -> void {
+  {
+    auto lock = unique_lock<std::mutex>{mutex};
+    changed.wait(lock, [this]() { return running < maxRunning; });
+    running++;
+  }
+  auto finished = [this]() {
+    auto lock = lock_guard<std::mutex>{mutex};
+    running--;
+    simulatedCount++;
+    changed.notify_all();
+  };
+
+  auto connected = true;
+  auto sink = CsvText{request.columns,
+		      [&](const char* data, size_t length) {
+			connected = connected &&
+			  sendAll(connection, data, length);
+		      }};
+  const auto circuit = Circuit{request.resistance,
+			       request.capacitance,
+			       request.lpFreqHz};
+  try {
+    if (request.receiver == Receiver::ZETASDR) {
+      auto zetasdr = ZetaSdr{circuit};
+      zetasdr.setWaveformCache(waveforms);
+      zetasdr.setPhases(request.phases);
+      zetasdr.run(sink, request.cycleCount, *request.signal,
+		  request.phaseAngleDeg);
+    }
+    else {
+      auto iqmixer = IqMixer{request.lpFreqHz};
+      iqmixer.setWaveformCache(waveforms);
+      iqmixer.run(sink, request.cycleCount, *request.signal,
+		  request.phaseAngleDeg);
+    }
+  }
+  catch (...) {
+    finished();
+    throw;
+  }
+  finished();
+
+  results.keep(description, make_shared<const string>(sink.takeText()));
+}
+
+/**
+ * Describe how much the caches have saved
+ *
+ * @return comment lines
+ */
+auto SimulationServer::status() -> string {
+  auto stream = ostringstream{};
+  auto lock = lock_guard<std::mutex>{mutex};
+  stream << "# requests " << requestCount
+	 << ", simulated " << simulatedCount
+	 << ", running " << running
+	 << ", connections " << connections.size() << "\n"
+	 << "# waveforms reused " << waveforms->getHits()
+	 << ", synthesised " << waveforms->getMisses() << "\n"
+	 << "# results kept " << results.getCount()
+	 << ", bytes " << results.getBytes() << "\n";
+  return stream.str();
+}
+
+/**
+ * Destructor stops listening, removes the socket, and waits for the
+ * connections to finish what they are doing
+ */
+SimulationServer::~SimulationServer() {
+  close(listener);
+  unlink(socketPath.c_str());
+  auto lock = unique_lock<std::mutex>{mutex};
+  for (auto&& connection : connections) {
+    shutdown(connection, SHUT_RD);
+  }
+  changed.wait(lock, [this]() { return connections.empty(); });
+}
@@ -0,0 +1,206 @@
+/**
+ * Simulation server, which keeps its caches warm between requests
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <csignal>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "misc.h"
+#include "Output.h"
+#include "Scenarios.h"
+#include "Signal.h"
+#include "WaveformCache.h"
+
+// Socket that the server listens on if no other is given
+constexpr auto DEFAULT_SERVER_SOCKET = "zetasdr.sock";
+
+// Default limit on the memory taken by the results kept for reuse
+constexpr auto DEFAULT_RESULT_MEMORY_BYTES = std::size_t{256} << 20;
+
+// Longest request line the server accepts
+constexpr auto SERVER_REQUEST_LENGTH = std::size_t{65536};
+
+// Results are sent on to the client whenever this much is waiting
+constexpr auto SERVER_SEND_BYTES = std::size_t{65536};
+
+// Longest run that a request can ask for, in time steps.  The mixers
+// hold every time step of a run, at a few hundred bytes each, so this
+// is about twice the standard scenarios' runs.
+constexpr auto SERVER_MAX_TIME_STEPS = std::size_t{10000000};
+
+/**
+ * One request to the server, a line of KEY=VALUE words.  It starts as
+ * the standard zetasdr_modulated_35 scenario, and each word changes
+ * part of it, in order:
+ *
+ * - scenario=NAME takes everything from a standard scenario
+ * - receiver=zetasdr|iqmixer
+ * - cycles=N and phase=DEGREES
+ * - carrier=AMPLITUDE:FREQUENCY:MODULATION[:PHASE], once for each
+ *   carrier, the first being the one that the receiver tunes to
+ * - resistance=OHMS, capacitance=FARADS and cutoff=HZ
+ * - phases=4|8|16, the number of detector phases
+ * - columns=NAME,NAME,... the columns to send back, default all
+ */
+struct ServerRequest {
+  Receiver receiver;
+  std::size_t cycleCount;
+  floating phaseAngleDeg;
+  std::optional<Signal> signal;
+  floating resistance;
+  floating capacitance;
+  floating lpFreqHz;
+  std::size_t phases;
+  std::vector<std::string> columns;
+
+  static auto parse(const std::string& line) -> ServerRequest;
+};
+
+//===================================================================
+
+/**
+ * Keeps the text of recent results in memory, under an exact
+ * description of everything that went into them, so that asking for
+ * the same thing again costs nothing.  Any number of threads can use
+ * it at once.  When it is over its limit, the least recently used
+ * results are dropped.
+ */
+class ResultMemory {
+private:
+  struct Entry {
+    std::shared_ptr<const std::string> text;
+    std::list<std::string>::iterator use;
+  };
+
+  const std::size_t maxBytes;
+  std::mutex mutex;
+  std::map<std::string, Entry> entries;
+  std::list<std::string> uses;
+  std::size_t bytes = 0;
+
+public:
+  ResultMemory(std::size_t maxBytes = DEFAULT_RESULT_MEMORY_BYTES);
+  auto find(const std::string& description)
+    -> std::shared_ptr<const std::string>;
+  auto keep(const std::string& description,
+	    std::shared_ptr<const std::string> text) -> void;
+  auto getCount() -> std::size_t;
+  auto getBytes() -> std::size_t;
+};
+
+//===================================================================
+
+/**
+ * Writes the results as the same comma separated values as CsvFile,
+ * keeping only the wanted columns, into memory.  Whenever enough has
+ * built up it is handed to a function, which sends it on, so that
+ * the client gets the results as they are written.
+ */
+class CsvText : public OutputSink {
+private:
+  const std::vector<std::string> wanted;
+  const std::function<auto (const char* data, std::size_t length) -> void>
+    send;
+  std::vector<std::size_t> columns;
+  std::ostringstream line;
+  std::string text;
+  std::size_t sent = 0;
+
+  auto sendWaiting(std::size_t atLeast) -> void;
+
+public:
+  CsvText(const std::vector<std::string>& columns,
+	  std::function<auto (const char* data, std::size_t length) -> void>
+	  send);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto end() -> void override;
+  auto takeText() -> std::string {
+    return std::move(text);
+  }
+  virtual ~CsvText() = default;
+};
+
+//===================================================================
+
+/**
+ * A long running simulation server listening on a UNIX domain socket,
+ * so that analysis scripts don't pay for starting a process and
+ * synthesising the signals for every run.  Each connection gets a
+ * thread of its own, and sends one request per line; the results
+ * come back as CSV, as in the output files, followed by a "# end"
+ * line, or a "# error" line if the request was no good.  A line
+ * saying "status" gets the cache statistics instead.
+ *
+ * The synthesised signals are shared by every request through a
+ * WaveformCache, and the results are kept in a ResultMemory, so
+ * repeating a request, or changing only the receiver or the phase
+ * angle, skips most or all of the work.  At most a given number of
+ * simulations run at once, and the rest wait for one to finish.
+ */
+class SimulationServer {
+private:
+  const std::string socketPath;
+  const std::size_t maxRunning;
+  int listener;
+  std::shared_ptr<WaveformCache> waveforms;
+  ResultMemory results;
+
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::size_t running = 0;
+  std::vector<int> connections;
+  std::size_t requestCount = 0;
+  std::size_t simulatedCount = 0;
+
+  auto converse(int connection) -> void;
+  auto answer(int connection, const std::string& line) -> bool;
+  auto simulate(const ServerRequest& request,
+		const std::string& description,
+		int connection) -> void;
+  auto status() -> std::string;
+
+public:
+  SimulationServer(const std::string& socketPath,
+		   std::size_t maxRunning,
+		   std::size_t memoryBytes = DEFAULT_RESULT_MEMORY_BYTES);
+  SimulationServer(const SimulationServer&) = delete;
+  SimulationServer& operator=(const SimulationServer&) = delete;
+  auto serve(const volatile std::sig_atomic_t& stop) -> void;
+  ~SimulationServer();
+};
@@ -24,7 +24,11 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <complex>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include "Signal.h"
 
 using namespace std;
@@ -34,16 +38,16 @@ using namespace std;
  *
  * @param carrierAmplitude carrier amplitude
  * @param carrierFreqHz carrier frequency
- * @param modFreqHz modulation frequency
+ * @param modulation how the carrier is modulated
  * @param phaseAngleDegrees phase angle of signal
  */
 Signal::SingleSignal::SingleSignal(floating carrierAmplitude,
 				   floating carrierFreqHz,
-				   floating modFreqHz,
+				   const Modulation& modulation,
 				   floating initialPhaseAngleDegrees) :
   carrierAmplitude{carrierAmplitude},
   carrierFreqHz{carrierFreqHz},
-  modFreqHz{modFreqHz},
+  modulation{modulation},
   initialPhaseAngleRadians{initialPhaseAngleDegrees * M_PI / 180.0},
   timeStepsPerCarrierCycle{1.0 / (TIME_STEP_SIZE * carrierFreqHz)} {}
 
@@ -65,20 +69,11 @@ auto Signal::SingleSignal::getRadians(size_t timeStep) const -> floating {
  * @return instananeous signal amplitude due to modulation
  */
 auto Signal::SingleSignal::getAmplitude(size_t timeStep) const -> floating {
-  auto radiansPerSecond = floating{2.0 * M_PI * modFreqHz};
-  auto radians = radiansPerSecond * timeStep * TIME_STEP_SIZE;
-  radians += initialPhaseAngleRadians;
-  return carrierAmplitude * cos(radians);
-}
-
-/**
- * Get the instantanous signal level.
- *
- * @param timeStep time step
- * @return signal level
- */
-auto Signal::SingleSignal::getSignal(size_t timeStep) const -> floating {
-  return getAmplitude(timeStep) * sin(getRadians(timeStep));
+  return visit([&](const auto& kernel) {
+      return kernel.amplitude(carrierAmplitude,
+			      initialPhaseAngleRadians,
+			      timeStep);
+    }, modulation);
 }
 
 /**
@@ -99,7 +94,7 @@ auto Signal::SingleSignal::timeStepsIntoACycle(size_t timeStep) const
 //===================================================================
 
 /**
- * Adds another single signal to the signal vector
+ * Adds another amplitude modulated single signal to the signal vector
  *
  * @param carrierAmplitude carrier amplitude
  * @param carrierFreqHz carrier frequency
@@ -110,9 +105,27 @@ auto Signal::add(floating carrierAmplitude,
 		 floating carrierFreqHz,
 		 floating modFreqHz,
 		 floating phaseAngleDegrees) -> void {
+  add(carrierAmplitude,
+      carrierFreqHz,
+      AmModulation{modFreqHz},
+      phaseAngleDegrees);
+}
+
+/**
+ * Adds another single signal to the signal vector
+ *
+ * @param carrierAmplitude carrier amplitude
+ * @param carrierFreqHz carrier frequency
+ * @param modulation how the carrier is modulated
+ * @param phaseAngleDegrees phase angle of signal
+ */
+auto Signal::add(floating carrierAmplitude,
+		 floating carrierFreqHz,
+		 const Modulation& modulation,
+		 floating phaseAngleDegrees) -> void {
   signals.push_back(SingleSignal(carrierAmplitude,
 				 carrierFreqHz,
-				 modFreqHz,
+				 modulation,
 				 phaseAngleDegrees));
 }
 
@@ -133,6 +146,24 @@ Signal::Signal(floating carrierAmplitude,
       modFreqHz,
       phaseAngleDegrees);
 }
+
+/**
+ * Constructor adds a single signal to the signal vector
+ *
+ * @param carrierAmplitude carrier amplitude
+ * @param carrierFreqHz carrier frequency
+ * @param modulation how the carrier is modulated
+ * @param phaseAngleDegrees phase angle of signal
+ */
+Signal::Signal(floating carrierAmplitude,
+	       floating carrierFreqHz,
+	       const Modulation& modulation,
+	       floating phaseAngleDegrees) {
+  add(carrierAmplitude,
+      carrierFreqHz,
+      modulation,
+      phaseAngleDegrees);
+}
   
 /**
  * Get the current value of the modulated signal
@@ -146,6 +177,15 @@ auto Signal::getAmplitude(size_t index, size_t timeStep)
   return signals.at(index).getAmplitude(timeStep);
 }
 
+/**
+ * Get the number of single signals
+ *
+ * @return number of carriers
+ */
+auto Signal::getCarrierCount() const -> size_t {
+  return signals.size();
+}
+
 /**
  * Get the carrier amplitude
  *
@@ -164,7 +204,9 @@ auto Signal::getCarrierAmplitude(size_t index)
  * @return modulation frequency
  */
 auto Signal::getModFreqHz(size_t index) const -> floating {
-  return signals.at(index).modFreqHz;
+  return visit([](const auto& kernel) {
+      return kernel.getModFreqHz();
+    }, signals.at(index).modulation);
 }
 
 /**
@@ -201,15 +243,209 @@ auto Signal::getRadians(size_t index,
 }
 
 /**
- * Get total signal voltage at specified time step.
+ * Get total signal voltage at specified time step.  This sums every
+ * single signal, as the crowded band synthesis only pays for itself
+ * over a block of time steps.
  *
  * @param timeStep time step
  * @return sum of all the single signals at this time
  */
 auto Signal::getTotalSignal(size_t timeStep) const -> floating {
   auto signalVoltage = floating{0};
+  synthesiseDirect(timeStep, 1, &signalVoltage);
+  return signalVoltage;
+}
+
+/**
+ * Describe the signal exactly, one line per single signal, for the
+ * result cache
+ *
+ * @return description
+ */
+auto Signal::describe() const -> string {
+  auto stream = ostringstream{};
+  stream << hexfloat;
   for (auto&& signal : signals) {
-    signalVoltage += signal.getSignal(timeStep);
+    stream << "carrier " << signal.carrierAmplitude
+	   << " " << signal.carrierFreqHz
+	   << " " << signal.initialPhaseAngleRadians << " ";
+    visit([&](const auto& kernel) {
+	kernel.describe(stream);
+      }, signal.modulation);
+    stream << "\n";
+  }
+  return stream.str();
+}
+
+/**
+ * Get the total signal voltage for a block of consecutive time
+ * steps.  A crowded band of carriers is summed by synthesiseBand(),
+ * whose cost hardly depends on the number of carriers, and anything
+ * less by synthesiseDirect().
+ *
+ * @param firstTimeStep first time step in the block
+ * @param count number of time steps
+ * @param output receives count signal voltages
+ */
+auto Signal::synthesise(size_t firstTimeStep,
+			size_t count,
+			floating* output) const -> void {
+  if (signals.size() >= BAND_SYNTHESIS_CARRIERS) {
+    synthesiseBand(firstTimeStep, count, output);
+  }
+  else {
+    synthesiseDirect(firstTimeStep, count, output);
+  }
+}
+
+/**
+ * Get the total signal voltage for a block of consecutive time
+ * steps, working out every single signal at every time step.  The
+ * modulation of each single signal is looked up once for the whole
+ * block rather than once per time step.
+ *
+ * @param firstTimeStep first time step in the block
+ * @param count number of time steps
+ * @param output receives count signal voltages
+ */
+auto Signal::synthesiseDirect(size_t firstTimeStep,
+			      size_t count,
+			      floating* output) const -> void {
+  fill(output, output + count, floating{0});
+  for (auto&& signal : signals) {
+    visit([&](const auto& kernel) {
+	for (auto index = size_t{0}; index < count; index++) {
+	  const auto timeStep = firstTimeStep + index;
+	  output[index] += kernel.signal(signal.carrierAmplitude,
+					 signal.initialPhaseAngleRadians,
+					 signal.getRadians(timeStep),
+					 timeStep);
+	}
+      }, signal.modulation);
+  }
+}
+
+/**
+ * Get the total signal voltage for a block of consecutive time
+ * steps, for a crowded band of carriers.  Every single signal is its
+ * carrier phasor times a complex envelope, so the whole band is a
+ * phasor at the centre of the band times the sum of each envelope
+ * rotated by its carrier's offset from the centre.  That sum only
+ * changes as fast as the widest offset, so it is worked out for all
+ * the carriers every so many time steps, and cubic interpolation
+ * fills in between.  The cost of each time step is then the
+ * interpolation and the centre phasor, plus a small share of the
+ * envelope samples.
+ *
+ * @param firstTimeStep first time step in the block
+ * @param count number of time steps
+ * @param output receives count signal voltages
+ */
+auto Signal::synthesiseBand(size_t firstTimeStep,
+			    size_t count,
+			    floating* output) const -> void {
+  if (count == 0) {
+    return;
+  }
+
+  // Centre of the band, and how far from it the band reaches
+  auto lowestHz = signals.front().carrierFreqHz;
+  auto highestHz = lowestHz;
+  for (auto&& signal : signals) {
+    lowestHz = min(lowestHz, signal.carrierFreqHz);
+    highestHz = max(highestHz, signal.carrierFreqHz);
+  }
+  const auto centreHz = (lowestHz + highestHz) / 2;
+  auto reachHz = floating{0};
+  for (auto&& signal : signals) {
+    visit([&](const auto& kernel) {
+	reachHz = max(reachHz, fabs(signal.carrierFreqHz - centreHz) +
+		      kernel.bandwidthHz());
+      }, signal.modulation);
+  }
+  const auto decimation = reachHz > 0 ?
+    static_cast<size_t>(clamp(1 / (TIME_STEP_SIZE * BAND_OVERSAMPLING *
+				   reachHz),
+			      floating{1},
+			      floating{BAND_MAX_DECIMATION})) :
+    BAND_MAX_DECIMATION;
+
+  const auto centreRadians = [&](size_t timeStep) {
+    const auto cycles = timeStep * centreHz * TIME_STEP_SIZE;
+    return 2 * M_PI * (cycles - floor(cycles));
+  };
+
+  // Envelope samples are at whole multiples of the decimation.  Each
+  // time step is interpolated from the two samples either side of
+  // it, except before the second sample, where it uses the first four
+  const auto firstSample = [&](size_t timeStep) {
+    const auto sample = timeStep / decimation;
+    return sample ? sample - 1 : 0;
+  };
+  const auto lastTimeStep = firstTimeStep + count - 1;
+  const auto base = firstSample(firstTimeStep);
+  auto envelope = vector<complex<floating>>(firstSample(lastTimeStep) + 4 -
+					    base);
+  for (auto&& signal : signals) {
+    visit([&](const auto& kernel) {
+	for (auto index = size_t{0}; index < envelope.size(); index++) {
+	  const auto timeStep = (base + index) * decimation;
+	  const auto inphase = kernel.signal(signal.carrierAmplitude,
+					     signal.initialPhaseAngleRadians,
+					     M_PI / 2, timeStep);
+	  const auto quadrature = kernel.signal(signal.carrierAmplitude,
+						signal.initialPhaseAngleRadians,
+						0, timeStep);
+	  envelope[index] += complex<floating>{inphase, quadrature} *
+	    polar(floating{1},
+		  signal.getRadians(timeStep) - centreRadians(timeStep));
+	}
+      }, signal.modulation);
+  }
+
+  for (auto index = size_t{0}; index < count; index++) {
+    const auto timeStep = firstTimeStep + index;
+    const auto first = firstSample(timeStep);
+    const auto x = static_cast<floating>(timeStep - first * decimation) /
+      decimation;
+    const auto* samples = &envelope[first - base];
+    const floating weights[] = {-(x - 1) * (x - 2) * (x - 3) / 6,
+				x * (x - 2) * (x - 3) / 2,
+				-x * (x - 1) * (x - 3) / 2,
+				x * (x - 1) * (x - 2) / 6};
+    auto inphase = floating{0};
+    auto quadrature = floating{0};
+    for (auto sample = 0; sample < 4; sample++) {
+      inphase += weights[sample] * samples[sample].real();
+      quadrature += weights[sample] * samples[sample].imag();
+    }
+    const auto radians = centreRadians(timeStep);
+    output[index] = sin(radians) * inphase + cos(radians) * quadrature;
+  }
+}
+
+//===================================================================
+
+/**
+ * Check the values for a carrier that come from outside, before
+ * simulating it
+ *
+ * @param carrierAmplitude carrier amplitude
+ * @param carrierFreqHz carrier frequency
+ * @param modFreqHz modulation frequency
+ * @param initialPhaseAngleDegrees phase angle of signal
+ */
+auto checkCarrier(floating carrierAmplitude,
+		  floating carrierFreqHz,
+		  floating modFreqHz,
+		  floating initialPhaseAngleDegrees) -> void {
+  if (!(carrierFreqHz > 0 && carrierFreqHz < NYQUIST_HZ)) {
+    throw invalid_argument{"The carrier frequency must be positive and "
+			   "below half the simulation rate"};
+  }
+  if (!isfinite(carrierAmplitude) || !(modFreqHz >= 0) ||
+      !isfinite(modFreqHz) || !isfinite(initialPhaseAngleDegrees)) {
+    throw invalid_argument{"The carrier values must be finite, and the "
+			   "modulation frequency not negative"};
   }
-  return signalVoltage;
 }
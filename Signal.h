@@ -27,10 +27,23 @@
 #pragma once
 
 #include "misc.h"
+#include "Modulation.h"
 #include <cmath>
 #include <cstddef>
+#include <string>
 #include <vector>
 
+// Number of carriers from which synthesise() sums them as one band
+// rather than one at a time
+constexpr auto BAND_SYNTHESIS_CARRIERS = std::size_t{16};
+
+// Envelope samples in each cycle of the band's highest frequency
+// offset, which keeps the interpolation error below 1e-6
+constexpr auto BAND_OVERSAMPLING = floating{128};
+
+// Most time steps between envelope samples
+constexpr auto BAND_MAX_DECIMATION = std::size_t{65536};
+
 //===================================================================
  
 class Signal {
@@ -38,18 +51,17 @@ private:
   struct SingleSignal {
     const floating carrierAmplitude;
     const floating carrierFreqHz;
-    const floating modFreqHz;
+    const Modulation modulation;
     const floating initialPhaseAngleRadians;
     const floating timeStepsPerCarrierCycle;
     
     SingleSignal(floating carrierAmplitude,
 		 floating carrierFreqHz,
-		 floating modFreqHz,
+		 const Modulation& modulation,
 		 floating initialPhaseAngleDegrees);
 
     auto getAmplitude(std::size_t timeStep) const -> floating;
     auto getRadians(std::size_t timeStep) const -> floating;
-    auto getSignal(std::size_t timeStep) const -> floating;
     auto timeStepsIntoACycle(std::size_t timeStep) const -> floating;
   };
 
@@ -61,12 +73,21 @@ public:
 	 floating carrierFreqHz,
 	 floating modFreqHz,
 	 floating initialPhaseAngleDegrees = 0);
+  Signal(floating carrierAmplitude,
+	 floating carrierFreqHz,
+	 const Modulation& modulation,
+	 floating initialPhaseAngleDegrees = 0);
     
   auto add(floating carrierAmplitude,
 	   floating carrierFreqHz,
 	   floating modFreqHz,
 	   floating initialPhaseAngleDegrees = 0) -> void;
+  auto add(floating carrierAmplitude,
+	   floating carrierFreqHz,
+	   const Modulation& modulation,
+	   floating initialPhaseAngleDegrees = 0) -> void;
   
+  auto getCarrierCount() const -> std::size_t;
   auto getCarrierAmplitude(std::size_t index) const -> floating;
   auto getAmplitude(std::size_t index, std::size_t timeStep) const -> floating;
   auto getModFreqHz(std::size_t index) const -> floating;
@@ -76,6 +97,19 @@ public:
   auto getRadians(std::size_t index,
 		  std::size_t timeStep) const -> floating;
   auto getTotalSignal(std::size_t timeStep) const -> floating;
+  auto describe() const -> std::string;
+  auto synthesise(std::size_t firstTimeStep,
+		  std::size_t count,
+		  floating* output) const -> void;
+  auto synthesiseDirect(std::size_t firstTimeStep,
+			std::size_t count,
+			floating* output) const -> void;
+  auto synthesiseBand(std::size_t firstTimeStep,
+		      std::size_t count,
+		      floating* output) const -> void;
 };
 
-
+auto checkCarrier(floating carrierAmplitude,
+		  floating carrierFreqHz,
+		  floating modFreqHz,
+		  floating initialPhaseAngleDegrees) -> void;
@@ -0,0 +1,101 @@
+/**
+ * Bounded lock-free single producer, single consumer queue
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include "Trace.h"
+
+/**
+ * Bounded queue for passing items from one thread to exactly one
+ * other thread, without locks.  The producer waits when the queue is
+ * full, so a slow consumer holds back the stages in front of it
+ * rather than letting the queue grow.
+ */
+template<typename T>
+class SpscQueue {
+private:
+  // Keep the two indexes on separate cache lines so that the threads
+  // don't keep taking the line from each other
+  static constexpr auto CACHE_LINE = std::size_t{64};
+
+  std::vector<T> slots;
+  alignas(CACHE_LINE) std::atomic<std::size_t> head;
+  alignas(CACHE_LINE) std::atomic<std::size_t> tail;
+
+public:
+  /**
+   * Constructor
+   *
+   * @param capacity maximum number of items in the queue
+   */
+  SpscQueue(std::size_t capacity) : slots(capacity + 1), head{0}, tail{0} {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /**
+   * Add an item, waiting for space if the queue is full.  Only call
+   * this from the producer thread.  Any wait shows up in the trace.
+   *
+   * @param item item to add
+   */
+  auto push(T&& item) -> void {
+    const auto position = tail.load(std::memory_order_relaxed);
+    const auto next = (position + 1) % slots.size();
+    if (next == head.load(std::memory_order_acquire)) {
+      auto wait = TraceScope{"queue full"};
+      while (next == head.load(std::memory_order_acquire)) {
+	std::this_thread::yield();
+      }
+    }
+    slots[position] = std::move(item);
+    tail.store(next, std::memory_order_release);
+  }
+
+  /**
+   * Remove the oldest item, waiting for one if the queue is empty.
+   * Only call this from the consumer thread.  Any wait shows up in
+   * the trace.
+   *
+   * @return the item
+   */
+  auto pop() -> T {
+    const auto position = head.load(std::memory_order_relaxed);
+    if (position == tail.load(std::memory_order_acquire)) {
+      auto wait = TraceScope{"queue empty"};
+      while (position == tail.load(std::memory_order_acquire)) {
+	std::this_thread::yield();
+      }
+    }
+    auto item = std::move(slots[position]);
+    head.store((position + 1) % slots.size(), std::memory_order_release);
+    return item;
+  }
+};
@@ -0,0 +1,336 @@
+/**
+ * Linear state space model for the analogue circuit blocks
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "StateSpace.h"
+
+using namespace std;
+
+// Number of Taylor series terms in the matrix exponential.  The
+// matrix is scaled down to a norm of less than 0.5 first, so this is
+// well beyond long double precision.
+constexpr auto TAYLOR_TERMS = 24;
+
+/**
+ * Constructor, for a matrix of zeros
+ *
+ * @param rows number of rows
+ * @param columns number of columns
+ */
+Matrix::Matrix(size_t rows, size_t columns) :
+  rows{rows},
+  columns{columns},
+  values(rows * columns, 0) {}
+
+/**
+ * Make an identity matrix
+ *
+ * @param size number of rows and columns
+ * @return identity matrix
+ */
+auto Matrix::identity(size_t size) -> Matrix {
+  auto result = Matrix{size, size};
+  for (auto index = size_t{0}; index < size; index++) {
+    result(index, index) = 1;
+  }
+  return result;
+}
+
+/**
+ * Matrix product
+ *
+ * @param other right hand side
+ * @return product
+ */
+auto Matrix::operator*(const Matrix& other) const -> Matrix {
+  auto result = Matrix{rows, other.columns};
+  for (auto row = size_t{0}; row < rows; row++) {
+    for (auto inner = size_t{0}; inner < columns; inner++) {
+      auto value = (*this)(row, inner);
+      for (auto column = size_t{0}; column < other.columns; column++) {
+	result(row, column) += value * other(inner, column);
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * Matrix sum
+ *
+ * @param other right hand side, same shape as this
+ * @return sum
+ */
+auto Matrix::operator+(const Matrix& other) const -> Matrix {
+  auto result = *this;
+  for (auto index = size_t{0}; index < values.size(); index++) {
+    result.values[index] += other.values[index];
+  }
+  return result;
+}
+
+/**
+ * Multiply every element by a factor
+ *
+ * @param factor scale factor
+ * @return scaled matrix
+ */
+auto Matrix::scale(floating factor) const -> Matrix {
+  auto result = *this;
+  for (auto&& value : result.values) {
+    value *= factor;
+  }
+  return result;
+}
+
+/**
+ * Infinity norm, the largest row sum of absolute values
+ *
+ * @return norm
+ */
+auto Matrix::norm() const -> floating {
+  auto largest = floating{0};
+  for (auto row = size_t{0}; row < rows; row++) {
+    auto sum = floating{0};
+    for (auto column = size_t{0}; column < columns; column++) {
+      sum += fabs((*this)(row, column));
+    }
+    largest = max(largest, sum);
+  }
+  return largest;
+}
+
+/**
+ * Matrix exponential by scaling and squaring
+ *
+ * @return e to the power of this square matrix
+ */
+auto Matrix::exponential() const -> Matrix {
+  auto squarings = 0;
+  auto currentNorm = norm();
+  while (currentNorm > 0.5) {
+    currentNorm /= 2;
+    squarings++;
+  }
+  auto scaled = scale(ldexp(floating{1}, -squarings));
+
+  auto result = identity(rows);
+  auto term = identity(rows);
+  for (auto power = 1; power <= TAYLOR_TERMS; power++) {
+    term = (term * scaled).scale(floating{1} / power);
+    result = result + term;
+  }
+
+  for (auto count = 0; count < squarings; count++) {
+    result = result * result;
+  }
+  return result;
+}
+
+//===================================================================
+
+/**
+ * Constructor.  Works out the discrete time transition matrices for
+ * the step size, using the exponential of the augmented matrix
+ * [A B; 0 0] so that A does not need to be inverted.
+ *
+ * @param a state matrix
+ * @param b input matrix
+ * @param c output matrix
+ * @param d feedthrough matrix
+ * @param stepSize time step in seconds
+ */
+StateSpace::StateSpace(const Matrix& a,
+		       const Matrix& b,
+		       const Matrix& c,
+		       const Matrix& d,
+		       floating stepSize) :
+  c{c},
+  d{d},
+  stateCount{a.getRows()},
+  inputCount{b.getColumns()},
+  state(a.getRows(), 0),
+  scratch(a.getRows(), 0) {
+
+  const auto size = stateCount + inputCount;
+  auto augmented = Matrix{size, size};
+  for (auto row = size_t{0}; row < stateCount; row++) {
+    for (auto column = size_t{0}; column < stateCount; column++) {
+      augmented(row, column) = a(row, column) * stepSize;
+    }
+    for (auto column = size_t{0}; column < inputCount; column++) {
+      augmented(row, stateCount + column) = b(row, column) * stepSize;
+    }
+  }
+  transitions.push_back(augmented.exponential());
+}
+
+/**
+ * Get the augmented transition matrix for 2^power time steps,
+ * working out any missing powers by squaring.
+ *
+ * @param power log2 of the number of time steps
+ * @return transition matrix
+ */
+auto StateSpace::transition(unsigned power) -> const Matrix& {
+  while (transitions.size() <= power) {
+    const auto& last = transitions.back();
+    transitions.push_back(last * last);
+  }
+  return transitions.at(power);
+}
+
+/**
+ * Advance by one time step
+ *
+ * @param input input values, held over the time step
+ */
+auto StateSpace::step(const vector<floating>& input) -> void {
+  const auto& m = transitions.front();
+  for (auto row = size_t{0}; row < stateCount; row++) {
+    auto value = floating{0};
+    for (auto column = size_t{0}; column < stateCount; column++) {
+      value += m(row, column) * state[column];
+    }
+    for (auto column = size_t{0}; column < inputCount; column++) {
+      value += m(row, stateCount + column) * input[column];
+    }
+    scratch[row] = value;
+  }
+  state.swap(scratch);
+}
+
+/**
+ * Advance by many time steps with a constant input.  This takes one
+ * matrix-vector product per set bit in the step count, so it is a
+ * cheap way of letting long time constants settle.  Chunked ZetaSDR
+ * runs use it to carry the active filters' state from the start of
+ * one chunk to the start of the next.
+ *
+ * @param input input values, held over all the steps
+ * @param steps number of time steps
+ */
+auto StateSpace::advance(const vector<floating>& input,
+			 size_t steps) -> void {
+  for (auto power = 0u; steps != 0; power++, steps >>= 1) {
+    if ((steps & 1) == 0) {
+      continue;
+    }
+    const auto& m = transition(power);
+    for (auto row = size_t{0}; row < stateCount; row++) {
+      auto value = floating{0};
+      for (auto column = size_t{0}; column < stateCount; column++) {
+	value += m(row, column) * state[column];
+      }
+      for (auto column = size_t{0}; column < inputCount; column++) {
+	value += m(row, stateCount + column) * input[column];
+      }
+      scratch[row] = value;
+    }
+    state.swap(scratch);
+  }
+}
+
+/**
+ * Get the current outputs
+ *
+ * @param input current input values
+ * @return output values
+ */
+auto StateSpace::output(const vector<floating>& input) const
+  -> vector<floating> {
+  auto result = vector<floating>(c.getRows(), 0);
+  for (auto row = size_t{0}; row < result.size(); row++) {
+    for (auto column = size_t{0}; column < stateCount; column++) {
+      result[row] += c(row, column) * state[column];
+    }
+    for (auto column = size_t{0}; column < inputCount; column++) {
+      result[row] += d(row, column) * input[column];
+    }
+  }
+  return result;
+}
+
+/**
+ * Discharge all the capacitors
+ */
+auto StateSpace::reset() -> void {
+  fill(state.begin(), state.end(), 0);
+}
+
+/**
+ * Charge the capacitors to a state from another run of the same
+ * block
+ *
+ * @param values state values
+ */
+auto StateSpace::setState(const vector<floating>& values) -> void {
+  copy(values.begin(), values.end(), state.begin());
+}
+
+//===================================================================
+
+/**
+ * Build the state space model for both active filter channels.  The
+ * inputs are the IC2A and IC2B input voltage differences and the
+ * outputs are the voltages at the sound card.  Each channel has two
+ * states, the op-amp output voltage v, which is set by the current
+ * balance at the inverting input,
+ *
+ *   Cf v' = -v / Rf - vin / Rin
+ *
+ * and the voltage across the coupling capacitor vc,
+ *
+ *   Cc vc' = (v - vc) / Rload
+ *
+ * with the sound card seeing v - vc.
+ *
+ * @param stepSize time step in seconds
+ * @return state space block
+ */
+auto OpAmpFilter::makeStateSpace(floating stepSize) const -> StateSpace {
+  auto a = Matrix{4, 4};
+  auto b = Matrix{4, 2};
+  auto c = Matrix{2, 4};
+  auto d = Matrix{2, 2};
+
+  const auto feedbackRate = 1 / (feedbackResistance * feedbackCapacitance);
+  const auto inputRate = 1 / (inputResistance * feedbackCapacitance);
+  const auto couplingRate = 1 / (loadResistance * couplingCapacitance);
+
+  for (auto channel = size_t{0}; channel < 2; channel++) {
+    const auto opamp = 2 * channel;
+    const auto coupling = opamp + 1;
+    a(opamp, opamp) = -feedbackRate;
+    b(opamp, channel) = -inputRate;
+    a(coupling, opamp) = couplingRate;
+    a(coupling, coupling) = -couplingRate;
+    c(channel, opamp) = 1;
+    c(channel, coupling) = -1;
+  }
+  return StateSpace{a, b, c, d, stepSize};
+}
@@ -0,0 +1,136 @@
+/**
+ * Linear state space model for the analogue circuit blocks
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "misc.h"
+
+/**
+ * Small dense matrix, stored row by row
+ */
+class Matrix {
+private:
+  std::size_t rows;
+  std::size_t columns;
+  std::vector<floating> values;
+
+public:
+  Matrix(std::size_t rows, std::size_t columns);
+  static auto identity(std::size_t size) -> Matrix;
+
+  auto operator()(std::size_t row, std::size_t column) -> floating& {
+    return values[row * columns + column];
+  }
+  auto operator()(std::size_t row, std::size_t column) const -> floating {
+    return values[row * columns + column];
+  }
+  auto operator*(const Matrix& other) const -> Matrix;
+  auto operator+(const Matrix& other) const -> Matrix;
+  auto scale(floating factor) const -> Matrix;
+  auto norm() const -> floating;
+  auto exponential() const -> Matrix;
+
+  auto getRows() const {
+    return rows;
+  }
+  auto getColumns() const {
+    return columns;
+  }
+};
+
+//===================================================================
+
+/**
+ * Linear time invariant block, x' = Ax + Bu, y = Cx + Du.  The inputs
+ * are held constant over each time step, so the discrete transition
+ * matrices are exact and are only worked out once, when the block is
+ * constructed for a particular step size.
+ */
+class StateSpace {
+private:
+  const Matrix c;
+  const Matrix d;
+  // Augmented transition matrix [Ad Bd; 0 I], and its powers of two
+  std::vector<Matrix> transitions;
+  const std::size_t stateCount;
+  const std::size_t inputCount;
+  std::vector<floating> state;
+  std::vector<floating> scratch;
+
+  auto transition(unsigned power) -> const Matrix&;
+
+public:
+  StateSpace(const Matrix& a,
+	     const Matrix& b,
+	     const Matrix& c,
+	     const Matrix& d,
+	     floating stepSize);
+
+  auto step(const std::vector<floating>& input) -> void;
+  auto advance(const std::vector<floating>& input,
+	       std::size_t steps) -> void;
+  auto output(const std::vector<floating>& input) const
+    -> std::vector<floating>;
+  auto reset() -> void;
+  auto setState(const std::vector<floating>& values) -> void;
+
+  auto getState() const -> const std::vector<floating>& {
+    return state;
+  }
+};
+
+//===================================================================
+
+/**
+ * Component values for the IC2A and IC2B active filters.  Each op-amp
+ * is an inverting amplifier with a parallel RC in its feedback path,
+ * and its output goes to the sound card through a coupling
+ * capacitor.  The input resistance is what the detector capacitors
+ * see through the 74HC4052.
+ */
+struct OpAmpFilter {
+  floating inputResistance;
+  floating feedbackResistance;
+  floating feedbackCapacitance;
+  floating couplingCapacitance;
+  floating loadResistance;
+
+  auto makeStateSpace(floating stepSize) const -> StateSpace;
+};
+
+// R4 and R9
+constexpr auto OPAMP_FEEDBACK_RESISTANCE = floating{5.1e3};
+
+// C9 and C10
+constexpr auto OPAMP_FEEDBACK_CAPACITANCE = floating{330e-12};
+
+// C7 and C8
+constexpr auto OPAMP_COUPLING_CAPACITANCE = floating{0.1e-6};
+
+// Typical sound card line input impedance
+constexpr auto SOUND_CARD_INPUT_RESISTANCE = floating{10e3};
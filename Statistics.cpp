@@ -0,0 +1,305 @@
+/**
+ * Summary statistics of the results, instead of the waveforms
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include "Statistics.h"
+
+using namespace std;
+
+/**
+ * Convert a power ratio to decibels
+ *
+ * @param ratio power ratio
+ * @return decibels
+ */
+static auto powerDecibels(floating ratio) -> floating {
+  return 10 * log10(ratio);
+}
+
+//===================================================================
+
+/**
+ * Add the next value
+ *
+ * @param value the value
+ */
+auto RunningMoments::add(floating value) -> void {
+  if (count == 0) {
+    minimum = value;
+    maximum = value;
+  }
+  else {
+    minimum = min(minimum, value);
+    maximum = max(maximum, value);
+  }
+  count++;
+  const auto difference = value - mean;
+  mean += difference / count;
+  sumSquares += difference * (value - mean);
+}
+
+/**
+ * Get the variance of the values so far
+ *
+ * @return variance, 0 if there are no values
+ */
+auto RunningMoments::getVariance() const -> floating {
+  return count ? sumSquares / count : 0;
+}
+
+/**
+ * Get the RMS of the values so far, including their mean
+ *
+ * @return RMS
+ */
+auto RunningMoments::getRms() const -> floating {
+  return sqrt(mean * mean + getVariance());
+}
+
+//===================================================================
+
+/**
+ * Add the next pair of values
+ *
+ * @param x first value
+ * @param y second value
+ */
+auto RunningCovariance::add(floating x, floating y) -> void {
+  count++;
+  const auto differenceX = x - meanX;
+  const auto differenceY = y - meanY;
+  meanX += differenceX / count;
+  meanY += differenceY / count;
+  sumSquaresX += differenceX * (x - meanX);
+  sumSquaresY += differenceY * (y - meanY);
+  sumProducts += differenceX * (y - meanY);
+}
+
+/**
+ * Get the variance of the first values
+ *
+ * @return variance, 0 if there are no values
+ */
+auto RunningCovariance::getVarianceX() const -> floating {
+  return count ? sumSquaresX / count : 0;
+}
+
+/**
+ * Get the variance of the second values
+ *
+ * @return variance, 0 if there are no values
+ */
+auto RunningCovariance::getVarianceY() const -> floating {
+  return count ? sumSquaresY / count : 0;
+}
+
+/**
+ * Get the covariance
+ *
+ * @return covariance, 0 if there are no values
+ */
+auto RunningCovariance::getCovariance() const -> floating {
+  return count ? sumProducts / count : 0;
+}
+
+/**
+ * Get the correlation coefficient
+ *
+ * @return correlation, -1 to 1, or 0 if either value is constant
+ */
+auto RunningCovariance::getCorrelation() const -> floating {
+  const auto product = sumSquaresX * sumSquaresY;
+  return product > 0 ? sumProducts / sqrt(product) : 0;
+}
+
+/**
+ * Get the slope of the least squares straight line fit of y to x
+ *
+ * @return slope, or 0 if x is constant
+ */
+auto RunningCovariance::getSlope() const -> floating {
+  return sumSquaresX > 0 ? sumProducts / sumSquaresX : 0;
+}
+
+/**
+ * Get the variance of what is left of y after taking away the least
+ * squares straight line fit to x
+ *
+ * @return residual variance
+ */
+auto RunningCovariance::getResidualVariance() const -> floating {
+  if (count == 0) {
+    return 0;
+  }
+  const auto fitted = sumSquaresX > 0 ?
+    sumProducts * sumProducts / sumSquaresX : 0;
+  return max(floating{0}, (sumSquaresY - fitted) / count);
+}
+
+//===================================================================
+
+/**
+ * Constructor
+ *
+ * @param filename output filename
+ */
+StatisticsFile::StatisticsFile(const string& filename) :
+  filename{filename},
+  recent(STATISTICS_MAX_LAG),
+  lagged(STATISTICS_MAX_LAG) {}
+
+/**
+ * Find the columns that the statistics are about
+ *
+ * @param headings column headings
+ */
+auto StatisticsFile::begin(const string& headings) -> void {
+  names = splitHeadings(headings);
+  columns.assign(names.size() > 2 ? names.size() - 2 : 0, RunningMoments{});
+
+  inphaseIndex = findField(headings, "IC2A");
+  quadratureIndex = findField(headings, "IC2B");
+  if (!inphaseIndex || !quadratureIndex) {
+    inphaseIndex = findField(headings, "inphase");
+    quadratureIndex = findField(headings, "quadrature");
+  }
+  modulationIndex = findField(headings, "modulation");
+  demodulatedIndex = findField(headings, "demodulated");
+}
+
+/**
+ * Add one line of results to the statistics
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values for the remaining columns
+ */
+auto StatisticsFile::write(size_t,
+			   floating timeStamp,
+			   const vector<floating>& fields) -> void {
+  if (!firstTime) {
+    firstTime = timeStamp;
+  }
+  else if (lineSpacing == 0) {
+    lineSpacing = timeStamp - *firstTime;
+  }
+
+  if (columns.size() < fields.size()) {
+    columns.resize(fields.size());
+  }
+  for (auto index = size_t{0}; index < fields.size(); index++) {
+    columns[index].add(fields[index]);
+  }
+
+  if (inphaseIndex && quadratureIndex) {
+    iq.add(fields.at(*inphaseIndex), fields.at(*quadratureIndex));
+  }
+
+  if (modulationIndex && demodulatedIndex) {
+    recent[recentEnd] = fields.at(*modulationIndex);
+    recentEnd = (recentEnd + 1) % recent.size();
+    recentCount = min(recentCount + 1, recent.size());
+
+    // Pair this demodulated value with each of the recent modulation
+    // values, the latest being no delay
+    const auto demodulated = fields.at(*demodulatedIndex);
+    auto position = recentEnd;
+    for (auto lag = size_t{0}; lag < recentCount; lag++) {
+      position = (position ? position : recent.size()) - 1;
+      lagged[lag].add(recent[position], demodulated);
+    }
+  }
+}
+
+/**
+ * Start of a new captured segment.  The delays don't reach back into
+ * the previous one.
+ *
+ * @param index segment number
+ * @param triggerTimeStep time step at which the trigger fired
+ */
+auto StatisticsFile::segment(size_t, size_t) -> void {
+  recentCount = 0;
+}
+
+/**
+ * Write the statistics
+ */
+auto StatisticsFile::end() -> void {
+  auto file = ofstream{filename};
+  if (!file) {
+    cout << "Unable to write " << filename << endl;
+    exit(EXIT_FAILURE);
+  }
+  file.precision(9);
+  file << scientific;
+
+  const auto lines = columns.empty() ? size_t{0} : columns.front().getCount();
+  file << "# statistics, " << lines << "\n"
+       << "# column, mean, rms, standardDeviation, minimum, maximum\n";
+  for (auto index = size_t{0}; index < columns.size(); index++) {
+    const auto& column = columns[index];
+    file << (index + 2 < names.size() ? names[index + 2] : string{})
+	 << "," << column.getMean()
+	 << "," << column.getRms()
+	 << "," << sqrt(column.getVariance())
+	 << "," << column.getMinimum()
+	 << "," << column.getMaximum() << "\n";
+  }
+
+  file << "# metric, value\n";
+  if (inphaseIndex && quadratureIndex && iq.getCount()) {
+    file << "iqAmplitudeImbalanceDb,"
+	 << powerDecibels(iq.getVarianceX() / iq.getVarianceY()) << "\n"
+	 << "iqPhaseImbalanceDegrees,"
+	 << asin(iq.getCorrelation()) * 180 / M_PI << "\n";
+  }
+
+  // Only if there is any modulation to follow
+  if (modulationIndex && demodulatedIndex && recentCount &&
+      lagged.front().getVarianceX() > 0) {
+    // The delay with the strongest correlation
+    auto best = size_t{0};
+    for (auto lag = size_t{1}; lag < lagged.size(); lag++) {
+      if (lagged[lag].getCount() &&
+	  fabs(lagged[lag].getCorrelation()) >
+	  fabs(lagged[best].getCorrelation())) {
+	best = lag;
+      }
+    }
+    const auto& fit = lagged[best];
+    const auto fitted = fit.getVarianceY() - fit.getResidualVariance();
+    file << "demodulatedRms," << columns.at(*demodulatedIndex).getRms() << "\n"
+	 << "demodulatedGain," << fit.getSlope() << "\n"
+	 << "demodulatedDelaySeconds," << best * lineSpacing << "\n"
+	 << "demodulatedCorrelation," << fit.getCorrelation() << "\n"
+	 << "demodulatedDistortionDb,"
+	 << powerDecibels(fit.getResidualVariance() / fitted) << "\n";
+  }
+}
@@ -0,0 +1,150 @@
+/**
+ * Summary statistics of the results, instead of the waveforms
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+#include "misc.h"
+#include "Output.h"
+
+// Longest delay between the modulation and demodulated columns that
+// is looked for, in lines of results
+constexpr auto STATISTICS_MAX_LAG = std::size_t{1000};
+
+/**
+ * Mean, variance and extremes of a stream of values, updated one
+ * value at a time with Welford's method, so that a small variance on
+ * a large mean doesn't lose its precision.
+ */
+class RunningMoments {
+private:
+  std::size_t count = 0;
+  floating mean = 0;
+  floating sumSquares = 0;
+  floating minimum = 0;
+  floating maximum = 0;
+
+public:
+  auto add(floating value) -> void;
+  auto getCount() const -> std::size_t {
+    return count;
+  }
+  auto getMean() const -> floating {
+    return mean;
+  }
+  auto getVariance() const -> floating;
+  auto getRms() const -> floating;
+  auto getMinimum() const -> floating {
+    return minimum;
+  }
+  auto getMaximum() const -> floating {
+    return maximum;
+  }
+};
+
+/**
+ * Means, variances and covariance of a stream of pairs of values,
+ * updated one pair at a time in the same way as RunningMoments.
+ */
+class RunningCovariance {
+private:
+  std::size_t count = 0;
+  floating meanX = 0;
+  floating meanY = 0;
+  floating sumSquaresX = 0;
+  floating sumSquaresY = 0;
+  floating sumProducts = 0;
+
+public:
+  auto add(floating x, floating y) -> void;
+  auto getCount() const -> std::size_t {
+    return count;
+  }
+  auto getVarianceX() const -> floating;
+  auto getVarianceY() const -> floating;
+  auto getCovariance() const -> floating;
+  auto getCorrelation() const -> floating;
+  auto getSlope() const -> floating;
+  auto getResidualVariance() const -> floating;
+};
+
+//===================================================================
+
+/**
+ * Works out summary statistics as the results go past, and writes
+ * them to a small file at the end instead of the results themselves.
+ * For every column there are the mean, which is its DC offset, the
+ * RMS, the standard deviation and the extremes.  Then there are:
+ *
+ * - the amplitude and phase imbalance between the unfiltered
+ *   inphase and quadrature columns, IC2A and IC2B for the ZetaSDR,
+ *   from the ratio of their standard deviations and their
+ *   correlation.  The phase imbalance only means something when the
+ *   baseband signal is off tune, so that I and Q ought to be
+ *   uncorrelated.
+ * - how well the demodulated column follows the modulation column.
+ *   The covariance is kept for each delay up to STATISTICS_MAX_LAG
+ *   lines, and the delay with the strongest correlation gives the
+ *   gain and the delay through the receiver, and the distortion,
+ *   which is what is left over after the best straight line fit
+ *   relative to what is fitted.
+ */
+class StatisticsFile : public OutputSink {
+private:
+  const std::string filename;
+  std::vector<std::string> names;
+  std::vector<RunningMoments> columns;
+  std::optional<std::size_t> inphaseIndex;
+  std::optional<std::size_t> quadratureIndex;
+  std::optional<std::size_t> modulationIndex;
+  std::optional<std::size_t> demodulatedIndex;
+  RunningCovariance iq;
+
+  // Latest modulation values, most recent at recentEnd - 1
+  std::vector<floating> recent;
+  std::size_t recentEnd = 0;
+  std::size_t recentCount = 0;
+
+  // Index is the delay of the demodulated column, in lines
+  std::vector<RunningCovariance> lagged;
+
+  std::optional<floating> firstTime;
+  floating lineSpacing = 0;
+
+public:
+  StatisticsFile(const std::string& filename);
+  auto begin(const std::string& headings) -> void override;
+  auto write(std::size_t timeStep,
+	     floating timeStamp,
+	     const std::vector<floating>& fields) -> void override;
+  auto segment(std::size_t index,
+	       std::size_t triggerTimeStep) -> void override;
+  auto end() -> void override;
+  virtual ~StatisticsFile() = default;
+};
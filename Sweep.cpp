@@ -0,0 +1,530 @@
+/**
+ * Work queue for sweeps run by several processes
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unistd.h>
+#include "Sweep.h"
+
+using namespace std;
+
+// Separates the fields of the queue file names
+constexpr auto TOKEN_SEPARATOR = '@';
+
+//===================================================================
+
+/**
+ * Get the name of this machine, which tells apart the workers of
+ * different machines sharing a sweep directory
+ *
+ * @return host name
+ */
+static auto hostName() -> string {
+  char name[256] = {};
+  if (gethostname(name, sizeof(name) - 1) != 0 || !name[0]) {
+    return "localhost";
+  }
+  auto text = string{name};
+  replace(text.begin(), text.end(), TOKEN_SEPARATOR, '_');
+  return text;
+}
+
+/**
+ * Split a queue file name into its fields
+ *
+ * @param token file name
+ * @return fields
+ */
+static auto splitToken(const string& token) -> vector<string> {
+  auto fields = vector<string>{};
+  auto stream = istringstream{token};
+  auto field = string{};
+  while (getline(stream, field, TOKEN_SEPARATOR)) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+/**
+ * Get the files in a directory, in name order so that the jobs are
+ * run in the order they were added
+ *
+ * @param directory directory
+ * @return file names, without the directory
+ */
+static auto listFiles(const string& directory) -> vector<string> {
+  auto names = vector<string>{};
+  auto error = error_code{};
+  for (auto&& entry : filesystem::directory_iterator{directory, error}) {
+    names.push_back(entry.path().filename().string());
+  }
+  sort(names.begin(), names.end());
+  return names;
+}
+
+/**
+ * Write a file under a temporary name and rename it into place
+ *
+ * @param filename file to write
+ * @param contents what goes in it
+ */
+static auto writeAtomically(const string& filename,
+			    const string& contents) -> void {
+  const auto temporary = filename + ".tmp" + to_string(getpid());
+  {
+    auto file = ofstream{temporary, ios::binary};
+    file << contents;
+    if (!file) {
+      cout << "Unable to write " << temporary << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  auto error = error_code{};
+  filesystem::rename(temporary, filename, error);
+  if (error) {
+    cout << "Unable to rename " << temporary << " to " << filename << endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Read the "# metric, value" section of a statistics file
+ *
+ * @param filename statistics file
+ * @return metric names and values, in the order they are in the file
+ */
+static auto readMetrics(const string& filename)
+  -> vector<pair<string, string>> {
+  auto metrics = vector<pair<string, string>>{};
+  auto file = ifstream{filename};
+  auto line = string{};
+  auto inMetrics = false;
+  while (getline(file, line)) {
+    if (!line.empty() && line.front() == '#') {
+      inMetrics = line.rfind("# metric", 0) == 0;
+      continue;
+    }
+    const auto comma = line.find(',');
+    if (inMetrics && comma != string::npos) {
+      metrics.emplace_back(line.substr(0, comma), line.substr(comma + 1));
+    }
+  }
+  return metrics;
+}
+
+//===================================================================
+
+/**
+ * Get the results file extension for the job's format, the same as
+ * program uses
+ *
+ * @return extension, including the dot
+ */
+auto SweepJob::extension() const -> string {
+  if (format == "statistics") {
+    return ".stats";
+  }
+  if (format == "compressed") {
+    return ".zsc";
+  }
+  return ".txt";
+}
+
+//===================================================================
+
+/**
+ * Constructor.  Creates the directories if they aren't there.
+ *
+ * @param directory sweep directory
+ */
+SweepQueue::SweepQueue(const string& directory) :
+  directory{directory}, host{hostName()} {
+  for (auto area : {"jobs", "queue/pending", "queue/running", "queue/done",
+		    "queue/failed", "tmp", "results", "logs"}) {
+    auto error = error_code{};
+    filesystem::create_directories(path(area), error);
+    if (error) {
+      cout << "Unable to create " << path(area) << endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+/**
+ * Get the path of something in the sweep directory
+ *
+ * @param area subdirectory
+ * @param name file name, or empty for the subdirectory itself
+ * @return the path
+ */
+auto SweepQueue::path(const string& area,
+		      const string& name) const -> string {
+  auto full = filesystem::path{directory} / area;
+  if (!name.empty()) {
+    full /= name;
+  }
+  return full.string();
+}
+
+auto SweepQueue::resultFile(const SweepJob& job) const -> string {
+  return path("results", job.name + job.extension());
+}
+
+auto SweepQueue::isDone(const SweepJob& job) const -> bool {
+  auto error = error_code{};
+  return filesystem::exists(resultFile(job), error);
+}
+
+/**
+ * Find the queue file for a job
+ *
+ * @param area queue subdirectory
+ * @param name job name
+ * @return file name, or nothing if the job isn't there
+ */
+auto SweepQueue::findToken(const string& area,
+			   const string& name) const -> optional<string> {
+  for (auto&& token : listFiles(path(area))) {
+    if (splitToken(token).at(0) == name) {
+      return token;
+    }
+  }
+  return {};
+}
+
+/**
+ * Add a job, unless it has already been done.  If it was given up on
+ * in an earlier sweep it is tried again.
+ *
+ * @param job the job
+ * @return false if the job has already been done
+ */
+auto SweepQueue::add(const SweepJob& job) -> bool {
+  if (job.name.find(TOKEN_SEPARATOR) != string::npos) {
+    cout << "Job names can't contain " << TOKEN_SEPARATOR << endl;
+    exit(EXIT_FAILURE);
+  }
+  if (isDone(job)) {
+    return false;
+  }
+
+  auto stream = ostringstream{};
+  stream.precision(21);
+  stream << "scenario " << job.scenario << "\n"
+	 << "phase " << job.phaseAngleDeg << "\n"
+	 << "modulation " << job.modulation << "\n"
+	 << "format " << job.format << "\n";
+  writeAtomically(path("jobs", job.name), stream.str());
+
+  // Its results have been deleted, so it is to be done again
+  auto error = error_code{};
+  if (auto done = findToken("queue/done", job.name)) {
+    filesystem::remove(path("queue/done", *done), error);
+  }
+
+  if (auto failed = findToken("queue/failed", job.name)) {
+    filesystem::rename(path("queue/failed", *failed),
+		       path("queue/pending", job.name + TOKEN_SEPARATOR + "0"),
+		       error);
+  }
+  else if (!findToken("queue/pending", job.name) &&
+	   !findToken("queue/running", job.name)) {
+    // Creating an empty file is atomic anyway
+    auto token = ofstream{path("queue/pending",
+			       job.name + TOKEN_SEPARATOR + "0")};
+  }
+  return true;
+}
+
+/**
+ * Read a job's description
+ *
+ * @param name job name
+ * @return the job
+ */
+auto SweepQueue::getJob(const string& name) const -> SweepJob {
+  auto file = ifstream{path("jobs", name)};
+  if (!file) {
+    cout << "No job called " << name << endl;
+    exit(EXIT_FAILURE);
+  }
+  auto job = SweepJob{name, {}, 0, {}, "csv"};
+  auto line = string{};
+  while (getline(file, line)) {
+    const auto space = line.find(' ');
+    const auto key = line.substr(0, space);
+    const auto value = space == string::npos ? string{} : line.substr(space + 1);
+    if (key == "scenario") {
+      job.scenario = value;
+    }
+    else if (key == "phase") {
+      job.phaseAngleDeg = stold(value);
+    }
+    else if (key == "modulation") {
+      job.modulation = value;
+    }
+    else if (key == "format") {
+      job.format = value;
+    }
+  }
+  return job;
+}
+
+/**
+ * Take the next pending job off the queue, by renaming its file into
+ * the running directory.  If another worker renames it first, this
+ * one just moves on to the next.
+ *
+ * @param pid process id of the worker
+ * @return the job, or nothing if there are no more
+ */
+auto SweepQueue::claim(int pid) -> optional<SweepClaim> {
+  for (auto&& pending : listFiles(path("queue/pending"))) {
+    const auto fields = splitToken(pending);
+    if (fields.size() != 2) {
+      continue;
+    }
+    const auto token = pending + TOKEN_SEPARATOR + host +
+      TOKEN_SEPARATOR + to_string(pid);
+    auto error = error_code{};
+    filesystem::rename(path("queue/pending", pending),
+		       path("queue/running", token), error);
+    if (!error) {
+      return SweepClaim{fields[0],
+			static_cast<unsigned>(stoul(fields[1])),
+			token};
+    }
+  }
+  return {};
+}
+
+/**
+ * Get the file to write a claimed job's results to
+ *
+ * @param claim the claimed job
+ * @return file in the tmp directory
+ */
+auto SweepQueue::temporaryFile(const SweepClaim& claim) const -> string {
+  return path("tmp", claim.token + getJob(claim.name).extension());
+}
+
+/**
+ * Commit a claimed job's results, by renaming them into the results
+ * directory, and move it to the done part of the queue
+ *
+ * @param claim the claimed job
+ */
+auto SweepQueue::commit(const SweepClaim& claim) -> void {
+  const auto job = getJob(claim.name);
+  auto error = error_code{};
+  filesystem::rename(temporaryFile(claim), resultFile(job), error);
+  if (error) {
+    cout << "Unable to commit the results of " << claim.name << endl;
+    exit(EXIT_FAILURE);
+  }
+  filesystem::rename(path("queue/running", claim.token),
+		     path("queue/done", claim.name + TOKEN_SEPARATOR +
+			  to_string(claim.attempt)),
+		     error);
+}
+
+/**
+ * Put a job that a worker didn't finish back on the queue, or give up
+ * on it if it has been tried often enough
+ *
+ * @param token its file name in the running directory
+ * @param attempts times to try each job
+ */
+auto SweepQueue::requeue(const string& token, unsigned attempts) -> void {
+  const auto fields = splitToken(token);
+  const auto name = fields.at(0);
+  const auto attempt = static_cast<unsigned>(stoul(fields.at(1))) + 1;
+  auto error = error_code{};
+
+  // Its partly written results
+  for (auto&& file : listFiles(path("tmp"))) {
+    if (file.rfind(token, 0) == 0) {
+      filesystem::remove(path("tmp", file), error);
+    }
+  }
+
+  if (isDone(getJob(name))) {
+    // It stopped after committing its results
+    filesystem::rename(path("queue/running", token),
+		       path("queue/done", name + TOKEN_SEPARATOR + fields.at(1)),
+		       error);
+    return;
+  }
+  const auto area = attempt < attempts ? "queue/pending" : "queue/failed";
+  filesystem::rename(path("queue/running", token),
+		     path(area, name + TOKEN_SEPARATOR + to_string(attempt)),
+		     error);
+  cout << (attempt < attempts ? "Retrying " : "Giving up on ") << name
+       << " after " << attempt
+       << (attempt == 1 ? " failed attempt" : " failed attempts") << endl;
+}
+
+/**
+ * Put the jobs that a worker on this machine was running back on the
+ * queue, after it has failed
+ *
+ * @param pid process id of the worker
+ * @param attempts times to try each job
+ * @return number of jobs it was running
+ */
+auto SweepQueue::abandon(int pid, unsigned attempts) -> size_t {
+  auto abandoned = size_t{0};
+  for (auto&& token : listFiles(path("queue/running"))) {
+    const auto fields = splitToken(token);
+    if (fields.size() == 4 && fields[2] == host &&
+	fields[3] == to_string(pid)) {
+      requeue(token, attempts);
+      abandoned++;
+    }
+  }
+  return abandoned;
+}
+
+/**
+ * Put the jobs of workers on this machine that are no longer running
+ * back on the queue.  This tidies up after a sweep that was killed.
+ * Workers on other machines are left alone, as there is no way to
+ * tell from here whether they are still running.
+ *
+ * @param attempts times to try each job
+ * @return number of jobs put back
+ */
+auto SweepQueue::recover(unsigned attempts) -> size_t {
+  auto recovered = size_t{0};
+  for (auto&& token : listFiles(path("queue/running"))) {
+    const auto fields = splitToken(token);
+    if (fields.size() == 4 && fields[2] == host &&
+	kill(stoi(fields[3]), 0) != 0 && errno == ESRCH) {
+      requeue(token, attempts);
+      recovered++;
+    }
+  }
+  return recovered;
+}
+
+/**
+ * Count the jobs in one part of the queue
+ *
+ * @param area "pending", "running" or "failed"
+ * @return number of jobs
+ */
+auto SweepQueue::count(const string& area) const -> size_t {
+  return listFiles(path("queue/" + area)).size();
+}
+
+/**
+ * Get the file that a worker's output goes to
+ *
+ * @param pid process id of the worker
+ * @return log file
+ */
+auto SweepQueue::logFile(int pid) const -> string {
+  return path("logs", host + TOKEN_SEPARATOR + to_string(pid) + ".log");
+}
+
+/**
+ * Write the index of all the jobs and where they have got to, and
+ * the summary of the statistics of the finished ones.  Both are
+ * written under temporary names and renamed into place, so that they
+ * can be rewritten while workers are still running.
+ */
+auto SweepQueue::merge() const -> void {
+  auto index = ostringstream{};
+  index << "# name, scenario, phaseDeg, status, failedAttempts, file\n";
+
+  auto metricNames = vector<string>{};
+  auto rows = vector<pair<SweepJob, map<string, string>>>{};
+
+  for (auto&& name : listFiles(path("jobs"))) {
+    if (name.find(".tmp") != string::npos) {
+      continue;
+    }
+    const auto job = getJob(name);
+    auto status = string{"done"};
+    auto token = findToken("queue/done", name);
+    if (!isDone(job)) {
+      token.reset();
+      for (auto area : {"running", "pending", "failed"}) {
+	token = findToken("queue/"s + area, name);
+	if (token) {
+	  status = area;
+	  break;
+	}
+      }
+      if (!token) {
+	status = "missing";
+      }
+    }
+    const auto attempts = token ? stoul(splitToken(*token).at(1)) : 0;
+    index << name << "," << job.scenario << "," << job.phaseAngleDeg << ","
+	  << status << "," << attempts << ","
+	  << (status == "done" ? "results/" + name + job.extension() : "")
+	  << "\n";
+
+    if (status == "done" && job.format == "statistics") {
+      auto values = map<string, string>{};
+      for (auto&& [metric, value] : readMetrics(resultFile(job))) {
+	if (find(metricNames.begin(), metricNames.end(), metric) ==
+	    metricNames.end()) {
+	  metricNames.push_back(metric);
+	}
+	values[metric] = value;
+      }
+      rows.emplace_back(job, values);
+    }
+  }
+  writeAtomically(path("index.csv"), index.str());
+
+  if (rows.empty()) {
+    return;
+  }
+  auto summary = ostringstream{};
+  summary << "# name, scenario, phaseDeg";
+  for (auto&& metric : metricNames) {
+    summary << ", " << metric;
+  }
+  summary << "\n";
+  for (auto&& [job, values] : rows) {
+    summary << job.name << "," << job.scenario << "," << job.phaseAngleDeg;
+    for (auto&& metric : metricNames) {
+      const auto found = values.find(metric);
+      summary << "," << (found == values.end() ? "" : found->second);
+    }
+    summary << "\n";
+  }
+  writeAtomically(path("summary.csv"), summary.str());
+}
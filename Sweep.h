@@ -0,0 +1,115 @@
+/**
+ * Work queue for sweeps run by several processes
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+#include "misc.h"
+
+// Times a job is tried before it is given up on
+constexpr auto SWEEP_ATTEMPTS = 3u;
+
+/**
+ * One run of a sweep: one of the standard scenarios with its phase
+ * angle changed.  Each job is kept in a small text file, so that
+ * workers on other machines sharing the directory can run it
+ * without being told anything else.
+ */
+struct SweepJob {
+  std::string name;
+  std::string scenario;
+  floating phaseAngleDeg;
+
+  // Modulation of the 7 MHz carrier, or empty for the default
+  std::string modulation;
+
+  // "csv", "compressed" or "statistics"
+  std::string format;
+
+  auto extension() const -> std::string;
+};
+
+/**
+ * A job that a worker has taken off the queue
+ */
+struct SweepClaim {
+  std::string name;
+  unsigned attempt;
+  std::string token;
+};
+
+//===================================================================
+
+/**
+ * A queue of sweep jobs kept as files in a directory, which can be on
+ * a shared filesystem.  Nothing but the filesystem is needed to share
+ * the work out, and everything that matters is done by renaming a
+ * file, which is atomic, so no two workers can take the same job and
+ * nothing sees a partly written file.
+ *
+ * - jobs/NAME describes each job
+ * - queue/pending/NAME@ATTEMPT is a job waiting to be run
+ * - queue/running/NAME@ATTEMPT@HOST@PID is a job being run by a
+ *   worker, which took it by renaming the pending file
+ * - queue/done/NAME@ATTEMPT is a job that has been done
+ * - queue/failed/NAME@ATTEMPT is a job that has been tried too often
+ * - tmp/ has the results that are still being written
+ * - results/NAME.EXT are the finished results, renamed from tmp/
+ *   when they are complete.  A job is done once its results are
+ *   there, whatever else has happened to it.
+ * - logs/HOST@PID.log is each worker's output
+ * - index.csv lists every job, and summary.csv has the statistics of
+ *   the finished ones if they were written with --statistics
+ */
+class SweepQueue {
+private:
+  const std::string directory;
+  const std::string host;
+
+  auto path(const std::string& area,
+	    const std::string& name = {}) const -> std::string;
+  auto resultFile(const SweepJob& job) const -> std::string;
+  auto isDone(const SweepJob& job) const -> bool;
+  auto findToken(const std::string& area,
+		 const std::string& name) const -> std::optional<std::string>;
+  auto requeue(const std::string& token, unsigned attempts) -> void;
+
+public:
+  SweepQueue(const std::string& directory);
+  auto add(const SweepJob& job) -> bool;
+  auto getJob(const std::string& name) const -> SweepJob;
+  auto claim(int pid) -> std::optional<SweepClaim>;
+  auto temporaryFile(const SweepClaim& claim) const -> std::string;
+  auto commit(const SweepClaim& claim) -> void;
+  auto abandon(int pid, unsigned attempts) -> std::size_t;
+  auto recover(unsigned attempts) -> std::size_t;
+  auto count(const std::string& area) const -> std::size_t;
+  auto logFile(int pid) const -> std::string;
+  auto merge() const -> void;
+};
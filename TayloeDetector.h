@@ -0,0 +1,823 @@
+/**
+ * Parts of the Tayloe quadrature product detector
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+#include <iostream>
+#include <vector>
+#include "misc.h"
+#include "DigitalLogic.h"
+
+// Voltage corresponding to logic 1
+constexpr auto LOGIC_ONE_VOLTAGE = floating{2.4};
+
+// Peak to peak local oscillator voltage
+constexpr auto LOCAL_OSCILLATOR_VOLTS = floating{5.0};
+
+//===================================================================
+
+/**
+ * This represents the Johnson counter constructed from N/2 D type
+ * flip flops, which has N states.  The ZetaSDR has two flip flops.
+ * In practice there will be some propagation delay between the clock
+ * changing and the output from a counter changing, but this is not
+ * modelled by this class.
+ */
+template <std::size_t N>
+class JohnsonCounter {
+  static_assert(N >= 4 && N % 2 == 0,
+		"A Johnson counter has an even number of states");
+
+  // This is the state, 0->N-1
+  unsigned state;
+
+  /**
+   * Work out the output pattern of a twisted ring counter.  Ones
+   * shift in from the least significant bit until all the flip flops
+   * are set, then zeros follow them, so with two flip flops the
+   * output pattern is {AB} 00, 01, 11, 10.
+   *
+   * @return output value for each state
+   */
+  static constexpr auto makeOutputValues() {
+    auto values = std::array<unsigned, N>{};
+    const auto allSet = (1u << (N / 2)) - 1;
+    for (auto state = std::size_t{0}; state < N; state++) {
+      values[state] = state < N / 2 ?
+	(1u << state) - 1 : allSet ^ ((1u << (state - N / 2)) - 1);
+    }
+    return values;
+  }
+
+  static constexpr auto OUTPUT_VALUE = makeOutputValues();
+
+public:
+  JohnsonCounter() : state{0} {}
+
+  /**
+   * Advance the Johnson counter by one clock
+   */
+  auto clock() {
+    if (++state >= N) {
+      state = 0;
+    }
+  }
+
+  /**
+   * Get the number of states
+   *
+   * @return number of states
+   */
+  static constexpr auto stateCount() {
+    return OUTPUT_VALUE.size();
+  }
+
+  /**
+   * Get the output value for a state
+   *
+   * @param state counter state
+   * @return the output value
+   */
+  static constexpr auto outputValue(std::size_t state) {
+    return OUTPUT_VALUE[state];
+  }
+
+  /**
+   * Get the current output value of the Johnson counter
+   */
+  auto get() const {
+    return OUTPUT_VALUE[state];
+  }
+};
+
+
+/**
+ * This represents the local oscillator.  This provides the clock to
+ * the Johnson Counter
+ */
+template <typename Counter>
+class LocalOscillator {
+
+private:
+  // Current time step
+  floating timeStep;
+  // Number of time steps per carrier cycle
+  floating timeStepsPerCycle;
+  Counter& johnsonCounter;
+  floating voltage;
+  bool errorFlagged;
+
+  /**
+   * Get voltage level of local oscillator at the current timestep
+   *
+   * @param jitterSteps timing error of the oscillator in time steps
+   * @return the voltage
+   */
+  auto getVoltage(floating jitterSteps = 0) {
+    auto value = floating{std::sin(2.0 * M_PI * (timeStep + jitterSteps) /
+				   timeStepsPerCycle)};
+    value = ((value + 1.0) / 2.0) * LOCAL_OSCILLATOR_VOLTS;
+    if (!errorFlagged && std::isnan(value)) {
+      std::cerr << value << " (LocalOscillator) is not a number" << std::endl;
+      errorFlagged = true;
+    }
+    else {
+      errorFlagged = false;
+    }
+    return value;
+  }
+
+public:
+  /**
+   * Constructor.  Set the start state of the counter, and the time
+   * steps corresponding to a cycle of the carrier.  The phase offset
+   * is handled by retarding the initial value of the current time
+   * steps so that it takes the number of time steps corresponding to
+   * the phase angle of the carrier before it reaches 0.
+   *
+   * @param frequencyHz local oscillator frequency
+   * @param phaseOffsetRadians phase offset of oscillator driving
+   * Johnson counter with respect to the radio carrier phase
+   * @param johnsonCounter Johnson counter object that the oscillator 
+   *                       drives
+   * @param elapsedTimeSteps time steps that have already gone by, to
+   *                         start part way through a run
+   */
+  LocalOscillator(floating frequencyHz,
+		  floating phaseOffsetRadians,
+		  Counter& johnsonCounter,
+		  std::size_t elapsedTimeSteps = 0) :
+    timeStep{static_cast<decltype(timeStep)>(-std::floor(phaseOffsetRadians))},
+    timeStepsPerCycle{std::floor(1.0 / (TIME_STEP_SIZE * frequencyHz))},
+    johnsonCounter{johnsonCounter},
+    voltage{0},
+    errorFlagged{false} {
+    // The counter has been clocked by every rising edge through the
+    // logic 1 voltage since the start, which come at the same point
+    // in every cycle
+    if (elapsedTimeSteps) {
+      const auto risingEdge = timeStepsPerCycle *
+	std::asin(2 * LOGIC_ONE_VOLTAGE / LOCAL_OSCILLATOR_VOLTS - 1) /
+	(2 * M_PI);
+      const auto startTimeStep = timeStep;
+      timeStep += elapsedTimeSteps;
+      const auto edges =
+	std::floor((timeStep - risingEdge) / timeStepsPerCycle) -
+	std::floor((startTimeStep - risingEdge) / timeStepsPerCycle);
+      const auto clocks = static_cast<std::size_t>(edges) %
+	Counter::stateCount();
+      for (auto clock = std::size_t{0}; clock < clocks; clock++) {
+	johnsonCounter.clock();
+      }
+    }
+    voltage = getVoltage();
+  }
+
+  /**
+   * Advance counter by one timestep.  The local oscillator which
+   * drives the counter runs at N times the carrier frequency. The
+   * phase difference between the local oscillator and the carrier is
+   * handled by retarding the start value of the time step counter by
+   * an amount corresponding to the initial phase difference.
+   *
+   * @param jitterSteps timing error of the oscillator in time steps
+   */
+  auto step(floating jitterSteps = 0) {
+    // One more time step
+    timeStep++;
+    auto previousVoltage = voltage;
+    voltage = getVoltage(jitterSteps);
+    // Clock the Johnson counter when the local oscillator output
+    // changes from logic 0 to logic 1
+    if (previousVoltage < LOGIC_ONE_VOLTAGE &&
+	voltage >= LOGIC_ONE_VOLTAGE) {
+      johnsonCounter.clock();
+    }
+  }
+};
+  
+
+/**
+ * e to the power of x, worked out at compile time.  x is halved until
+ * it is small, a Taylor series does the rest, and the result is
+ * squared back up.
+ *
+ * @param x the power
+ * @return the exponential
+ */
+constexpr auto compileTimeExp(floating x) -> floating {
+  auto halvings = 0;
+  while (x > 0.5 || x < -0.5) {
+    x /= 2;
+    halvings++;
+  }
+  auto term = floating{1};
+  auto sum = floating{1};
+  for (auto power = 1; power < 30; power++) {
+    term *= x / power;
+    sum += term;
+  }
+  for (; halvings > 0; halvings--) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+/**
+ * Circuit values given at run time, for sweeps over them.  How much
+ * of the difference between the RF signal and a capacitor's voltage
+ * is left after a time step is worked out once, when the capacitor is
+ * made.
+ */
+class RuntimeCircuit {
+private:
+  const floating decay;
+
+public:
+  /**
+   * Constructor
+   *
+   * @param circuit circuit characteristics
+   */
+  RuntimeCircuit(const Circuit& circuit) :
+    decay{std::exp(-TIME_STEP_SIZE /
+		   (circuit.resistance * circuit.capacitance))} {}
+
+  auto getDecay() const {
+    return decay;
+  }
+};
+
+/**
+ * Circuit values fixed at compile time.  Design has constexpr
+ * resistance and capacitance members, and the decay per time step is
+ * folded into the code that steps the capacitors.
+ */
+template <typename Design>
+class FixedCircuit {
+public:
+  static constexpr auto DECAY =
+    compileTimeExp(-TIME_STEP_SIZE / (Design::resistance *
+				      Design::capacitance));
+
+  /**
+   * Constructor.  The circuit has to be the design.
+   *
+   * @param circuit circuit characteristics
+   */
+  FixedCircuit(const Circuit& circuit) {
+    if (!matches(circuit)) {
+      std::cout << "The circuit is not the one built in" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /**
+   * Find out if a circuit is the design
+   *
+   * @param circuit circuit characteristics
+   * @return true if it is
+   */
+  static auto matches(const Circuit& circuit) -> bool {
+    return circuit.resistance == Design::resistance &&
+      circuit.capacitance == Design::capacitance &&
+      circuit.lpFreqHz == Design::lpFreqHz;
+  }
+
+  static constexpr auto getDecay() {
+    return DECAY;
+  }
+};
+
+//===================================================================
+
+/**
+ * This represents a sample and hold capacitors on the outputs from
+ * the 74HC4052.  It incorporates the resistance through the pair of
+ * 74HC4052 channels.  Values is RuntimeCircuit or FixedCircuit, and
+ * supplies the decay in each time step.
+ */
+template <typename Values>
+class SeriesRC : private Values {
+private:
+  floating voltage;  // voltage currently across capacitor
+  bool errorFlagged;
+public:
+
+  /**
+   * Constructor
+   *
+   * @param circuit circuit characteristics, specifically detector
+   * capacitors value and resistance through 74HC4052 and
+   */
+  SeriesRC(const Circuit& circuit) :
+    Values{circuit},
+    voltage{0},
+    errorFlagged{false} {}
+
+  /**
+   * Get the voltage across the capacitor
+   *
+   * @return the voltage across the capacitor
+   */
+  auto getVoltage() const {
+    return voltage;
+  }
+
+  /**
+   * Apply the specified voltage for one time step.
+   *
+   * @param appliedVoltage applied voltage
+   */
+  auto applyVoltageForOneTimeStep(floating appliedVoltage) {
+    auto voltageDifference = appliedVoltage - voltage;
+
+    voltage += voltageDifference * this->getDecay();
+				       
+    if (!errorFlagged && std::isnan(voltage)) {
+      std::cerr << voltage << " (SeriesRC) is not a number" << std::endl;
+      errorFlagged = true;
+    }
+    else {
+      errorFlagged = false;
+    }
+  }
+
+  /**
+   * Set the voltage across the capacitor
+   *
+   * @param newVoltage the voltage
+   */
+  auto setVoltage(floating newVoltage) {
+    voltage = newVoltage;
+  }
+
+  /**
+   * Place holder
+   */
+  auto isolateForOneTimeStep() {
+  }
+};
+
+//===================================================================
+
+// Half a turn, in long double precision
+constexpr auto HALF_TURN_RADIANS =
+  floating{3.141592653589793238462643383279502884L};
+
+/**
+ * Cosine of a fraction of a turn, worked out at compile time.  Whole
+ * quarter turns are exact, so that the four phase detector's
+ * weights are exactly 1, 0 and -1.
+ *
+ * @param numerator turns are numerator / denominator
+ * @param denominator turns are numerator / denominator
+ * @return the cosine
+ */
+constexpr auto turnCosine(std::size_t numerator,
+			  std::size_t denominator) -> floating {
+  numerator %= denominator;
+  if ((4 * numerator) % denominator == 0) {
+    constexpr floating QUARTER_TURNS[] = {1, 0, -1, 0};
+    return QUARTER_TURNS[4 * numerator / denominator];
+  }
+  // Between -half a turn and half a turn, then a Taylor series
+  auto angle = 2 * HALF_TURN_RADIANS * numerator / denominator;
+  if (angle > HALF_TURN_RADIANS) {
+    angle -= 2 * HALF_TURN_RADIANS;
+  }
+  auto term = floating{1};
+  auto sum = floating{1};
+  for (auto power = 2; power < 60; power += 2) {
+    term *= -angle * angle / ((power - 1) * power);
+    sum += term;
+  }
+  return sum;
+}
+
+//===================================================================
+
+/**
+ * The N detector capacitors of a Tayloe detector, and its inphase
+ * and quadrature outputs.  The capacitors are in the order in which
+ * the Johnson counter selects them, so capacitor p samples the
+ * carrier at p/N of a cycle.  The ZetaSDR is N=4, where they are C2,
+ * C4, C3 and C5, at 0, 90, 180 and 270 degrees.
+ *
+ * The inphase and quadrature outputs are the capacitor voltages
+ * weighted by the cosine and sine of their phases, scaled by 4/N so
+ * that every N has the same gain at the carrier frequency.  This
+ * rejects the harmonics of the local oscillator below N-1.  For N=4
+ * the weights are 1, 0, -1 and 0, which is IC2A and IC2B's C2 - C3
+ * and C4 - C5.  The counter sequence, the multiplexer and the
+ * weights are all worked out at compile time, and so are the circuit
+ * values if Values is a FixedCircuit.
+ */
+template <std::size_t N, typename Values = RuntimeCircuit>
+class DetectorCapacitors {
+public:
+  static constexpr auto PHASES = N;
+
+protected:
+  using Counter = JohnsonCounter<N>;
+
+  /**
+   * Work out which capacitor the multiplexer connects for each
+   * Johnson counter output value
+   *
+   * @return capacitor for each output value
+   */
+  static constexpr auto makeChannels() {
+    auto channels = std::array<std::size_t, (1u << (N / 2))>{};
+    for (auto state = std::size_t{0}; state < N; state++) {
+      channels[Counter::outputValue(state)] = state;
+    }
+    return channels;
+  }
+
+  /**
+   * Work out the weight of each capacitor in one of the outputs
+   *
+   * @param offset quarter turns to add to the phase, 0 for inphase
+   *               and 3 for quadrature
+   * @return weight of each capacitor
+   */
+  static constexpr auto makeWeights(std::size_t offset) {
+    auto weights = std::array<floating, N>{};
+    for (auto phase = std::size_t{0}; phase < N; phase++) {
+      weights[phase] = turnCosine(4 * phase + offset * N, 4 * N) * 4 / N;
+    }
+    return weights;
+  }
+
+  static constexpr auto CHANNEL = makeChannels();
+  static constexpr auto INPHASE_WEIGHT = makeWeights(0);
+  static constexpr auto QUADRATURE_WEIGHT = makeWeights(3);
+
+  std::array<SeriesRC<Values>, N> capacitor;
+
+private:
+  template <std::size_t... Phase>
+  static auto makeCapacitors(const Circuit& circuit,
+			     std::index_sequence<Phase...>) {
+    return std::array<SeriesRC<Values>, N>{
+      ((void)Phase, SeriesRC<Values>{circuit})...};
+  }
+
+  template <std::size_t... Phase>
+  auto combine(const std::array<floating, N>& weights,
+	       std::index_sequence<Phase...>) const {
+    return (floating{0} + ... +
+	    (weights[Phase] * capacitor[Phase].getVoltage()));
+  }
+
+public:
+  /**
+   * Constructor
+   *
+   * @param circuit circuit characteristics
+   */
+  DetectorCapacitors(const Circuit& circuit) :
+    capacitor{makeCapacitors(circuit, std::make_index_sequence<N>{})} {}
+
+  /**
+   * Charge all the capacitors to the same voltage, to start part way
+   * through a run with them close to where they would be
+   *
+   * @param voltage the voltage
+   */
+  auto preset(floating voltage) {
+    for (auto&& each : capacitor) {
+      each.setVoltage(voltage);
+    }
+  }
+
+  /**
+   * Get the voltage across one capacitor
+   *
+   * @param phase which capacitor, in the order they are selected
+   * @return the voltage
+   */
+  auto getVoltage(std::size_t phase) const {
+    return capacitor[phase].getVoltage();
+  }
+
+  /**
+   * Get the inphase output, which is IC2A's for N=4
+   *
+   * @return the weighted sum of the capacitor voltages
+   */
+  auto getInphase() const {
+    return combine(INPHASE_WEIGHT, std::make_index_sequence<N>{});
+  }
+
+  /**
+   * Get the quadrature output, which is IC2B's for N=4
+   *
+   * @return the weighted sum of the capacitor voltages
+   */
+  auto getQuadrature() const {
+    return combine(QUADRATURE_WEIGHT, std::make_index_sequence<N>{});
+  }
+
+  // The capacitors at 0, 180, 90 and 270 degrees, which for N=4 are
+  // the ZetaSDR's C2, C3, C4 and C5
+  auto getC2() const {
+    static_assert(N % 4 == 0, "No capacitor at 90 degrees");
+    return capacitor[0].getVoltage();
+  }
+  auto getC3() const {
+    static_assert(N % 4 == 0, "No capacitor at 90 degrees");
+    return capacitor[N / 2].getVoltage();
+  }
+  auto getC4() const {
+    static_assert(N % 4 == 0, "No capacitor at 90 degrees");
+    return capacitor[N / 4].getVoltage();
+  }
+  auto getC5() const {
+    static_assert(N % 4 == 0, "No capacitor at 90 degrees");
+    return capacitor[3 * N / 4].getVoltage();
+  }
+};
+
+//===================================================================
+
+/**
+ * The whole of the Tayloe detector: the local oscillator, the
+ * Johnson counter it clocks, and the N detector capacitors that the
+ * multiplexer connects the RF signal to in turn.  The local
+ * oscillator runs at N times the carrier frequency, so each
+ * capacitor samples 1/N of a carrier cycle.  The logic is worked out
+ * afresh at every time step, and switches instantly.
+ */
+template <std::size_t N, typename Values = RuntimeCircuit>
+class TayloeDetector : public DetectorCapacitors<N, Values> {
+private:
+  using typename DetectorCapacitors<N, Values>::Counter;
+  using DetectorCapacitors<N, Values>::CHANNEL;
+  using DetectorCapacitors<N, Values>::capacitor;
+
+  Counter johnsonCounter;
+  LocalOscillator<Counter> localOscillator;
+
+public:
+  static constexpr auto EVENT_DRIVEN = false;
+
+  /**
+   * Constructor
+   *
+   * @param circuit circuit characteristics
+   * @param frequencyHz local oscillator frequency
+   * @param phaseOffset phase offset of the local oscillator, in time
+   *                    steps
+   * @param elapsedTimeSteps time steps that have already gone by, to
+   *                         start part way through a run
+   */
+  TayloeDetector(const Circuit& circuit,
+		 floating frequencyHz,
+		 floating phaseOffset,
+		 std::size_t elapsedTimeSteps = 0) :
+    DetectorCapacitors<N, Values>{circuit},
+    johnsonCounter{},
+    localOscillator{frequencyHz, phaseOffset, johnsonCounter,
+		    elapsedTimeSteps} {}
+
+  // The oscillator refers to the counter, so this can't be copied
+  TayloeDetector(const TayloeDetector&) = delete;
+  TayloeDetector& operator=(const TayloeDetector&) = delete;
+
+  /**
+   * Advance by one time step
+   *
+   * @param signalVoltage RF signal voltage, including the bias
+   * @param jitterSteps local oscillator timing error in time steps
+   */
+  auto step(floating signalVoltage, floating jitterSteps = 0) {
+    localOscillator.step(jitterSteps);
+
+    // Johnson counter (IC1A and IC1B) selects which capacitor gets
+    // connected to the RF signal.  The other capacitors are
+    // electrically isolated during the time step and so do not
+    // change their state at all (they are assumed to have no
+    // leakage resistance)
+    capacitor[CHANNEL[johnsonCounter.get()]]
+      .applyVoltageForOneTimeStep(signalVoltage);
+  }
+};
+
+//===================================================================
+
+/**
+ * The Tayloe detector with its logic simulated by events, with the
+ * propagation delays of the parts.  The local oscillator is squared
+ * up by the clock input of the first flip flop, which clocks the
+ * Johnson counter.  The counter's outputs drive the multiplexer's
+ * select lines, and each of its switches turns on or off some time
+ * after they change.  Nothing is worked out at each time step except
+ * whether the next oscillator edge or logic change has come; the
+ * capacitors are only told about the changes to which of them are
+ * connected.  With no delays this gives the same results as
+ * TayloeDetector.
+ */
+template <std::size_t N, typename Values = RuntimeCircuit>
+class EventTayloeDetector : public DetectorCapacitors<N, Values> {
+private:
+  using typename DetectorCapacitors<N, Values>::Counter;
+  using DetectorCapacitors<N, Values>::CHANNEL;
+  using DetectorCapacitors<N, Values>::capacitor;
+
+  LogicSimulator logic;
+  const floating flipFlopSteps;
+  const floating switchOnSteps;
+  const floating switchOffSteps;
+
+  // Local oscillator period, and the fraction of it at which the
+  // clock input sees logic 1, both in time steps
+  const floating oscillatorPeriod;
+  const floating risingEdge;
+  const floating highTime;
+
+  // Time step of the oscillator, which starts retarded by the phase
+  // offset, and the cycle and time step of its next rising edge
+  floating oscillatorTimeStep;
+  floating nextCycle;
+  floating nextEdge;
+
+  floating timeStep;
+  std::size_t clock;
+  std::array<std::size_t, N / 2> flipFlop;
+  std::array<std::size_t, N> channelSwitch;
+  std::size_t selected;
+
+  // Capacitors connected to the RF signal, normally just the one
+  std::vector<std::size_t> connected;
+
+  /**
+   * Work out when the oscillator next rises through the logic 1
+   * voltage
+   */
+  auto findNextEdge() {
+    nextEdge = oscillatorPeriod * nextCycle + risingEdge;
+  }
+
+  /**
+   * Clock the flip flops, each taking the output of the one before it,
+   * and the first taking the inverted output of the last
+   *
+   * @param time time of the clock edge
+   */
+  auto clockCounter(floating time) {
+    if (!logic.get(clock)) {
+      return;
+    }
+    for (auto stage = std::size_t{0}; stage < N / 2; stage++) {
+      const auto input = stage ? logic.get(flipFlop[stage - 1]) :
+	!logic.get(flipFlop[N / 2 - 1]);
+      logic.schedule(flipFlop[stage], input, time + flipFlopSteps);
+    }
+  }
+
+  /**
+   * The select lines have changed, so switch from the old capacitor
+   * to the new one
+   *
+   * @param time time of the change
+   */
+  auto select(floating time) {
+    auto output = 0u;
+    for (auto stage = std::size_t{0}; stage < N / 2; stage++) {
+      output |= logic.get(flipFlop[stage]) << stage;
+    }
+    const auto channel = CHANNEL[output];
+    if (channel != selected) {
+      logic.schedule(channelSwitch[selected], false, time + switchOffSteps);
+      logic.schedule(channelSwitch[channel], true, time + switchOnSteps);
+      selected = channel;
+    }
+  }
+
+  /**
+   * A switch has turned on or off
+   *
+   * @param channel its capacitor
+   */
+  auto switched(std::size_t channel) {
+    const auto found = std::find(connected.begin(), connected.end(),
+				 channel);
+    if (logic.get(channelSwitch[channel]) && found == connected.end()) {
+      connected.push_back(channel);
+    }
+    else if (!logic.get(channelSwitch[channel]) && found != connected.end()) {
+      connected.erase(found);
+    }
+  }
+
+public:
+  static constexpr auto EVENT_DRIVEN = true;
+
+  /**
+   * Constructor
+   *
+   * @param circuit circuit characteristics
+   * @param frequencyHz local oscillator frequency
+   * @param phaseOffset phase offset of the local oscillator, in time
+   *                    steps
+   * @param timing propagation delays
+   */
+  EventTayloeDetector(const Circuit& circuit,
+		      floating frequencyHz,
+		      floating phaseOffset,
+		      const LogicTiming& timing) :
+    DetectorCapacitors<N, Values>{circuit},
+    flipFlopSteps{timing.flipFlopDelay / TIME_STEP_SIZE},
+    switchOnSteps{timing.switchOnDelay / TIME_STEP_SIZE},
+    switchOffSteps{timing.switchOffDelay / TIME_STEP_SIZE},
+    oscillatorPeriod{std::floor(1.0 / (TIME_STEP_SIZE * frequencyHz))},
+    risingEdge{oscillatorPeriod *
+	       std::asin(2 * LOGIC_ONE_VOLTAGE / LOCAL_OSCILLATOR_VOLTS - 1) /
+	       (2 * HALF_TURN_RADIANS)},
+    highTime{oscillatorPeriod / 2 - 2 * risingEdge},
+    oscillatorTimeStep{-std::floor(phaseOffset)},
+    timeStep{0},
+    selected{CHANNEL[0]},
+    connected{CHANNEL[0]} {
+    // The first rising edge after the oscillator starts
+    nextCycle = std::floor((oscillatorTimeStep - risingEdge) /
+			   oscillatorPeriod) + 1;
+    findNextEdge();
+    if (nextEdge <= oscillatorTimeStep) {
+      nextCycle++;
+      findNextEdge();
+    }
+
+    clock = logic.addNet();
+    logic.watch(clock, [this](floating time) { clockCounter(time); });
+    for (auto&& stage : flipFlop) {
+      stage = logic.addNet();
+      logic.watch(stage, [this](floating time) { select(time); });
+    }
+    for (auto channel = std::size_t{0}; channel < N; channel++) {
+      channelSwitch[channel] = logic.addNet(channel == selected);
+      logic.watch(channelSwitch[channel],
+		  [this, channel](floating) { switched(channel); });
+    }
+  }
+
+  // The logic refers to this object, so it can't be copied
+  EventTayloeDetector(const EventTayloeDetector&) = delete;
+  EventTayloeDetector& operator=(const EventTayloeDetector&) = delete;
+
+  /**
+   * Advance by one time step
+   *
+   * @param signalVoltage RF signal voltage, including the bias
+   * @param jitterSteps local oscillator timing error in time steps
+   */
+  auto step(floating signalVoltage, floating jitterSteps = 0) {
+    timeStep++;
+    oscillatorTimeStep++;
+    if (oscillatorTimeStep + jitterSteps >= nextEdge) {
+      logic.schedule(clock, true, timeStep);
+      logic.schedule(clock, false, timeStep + highTime);
+      nextCycle++;
+      findNextEdge();
+    }
+    if (logic.nextEventTime() <= timeStep) {
+      logic.run(timeStep);
+    }
+
+    // Only the connected capacitors change
+    for (auto channel : connected) {
+      capacitor[channel].applyVoltageForOneTimeStep(signalVoltage);
+    }
+  }
+};
@@ -0,0 +1,331 @@
+/**
+ * Live progress and samples in shared memory
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "Output.h"
+#include "Telemetry.h"
+
+using namespace std;
+
+// "ZSDT" at the start of the shared memory
+constexpr auto TELEMETRY_MAGIC = uint32_t{0x5a534454};
+
+/**
+ * Get the name of the shared memory object for a telemetry feed
+ *
+ * @param name feed name
+ * @return shared memory object name
+ */
+auto telemetryObjectName(const string& name) -> string {
+  return "/zetasdr-" + name;
+}
+
+/**
+ * Get the time, from a clock that all processes share
+ *
+ * @return time in nanoseconds
+ */
+auto telemetryNanoseconds() -> uint64_t {
+  return chrono::duration_cast<chrono::nanoseconds>
+    (chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Check whether a publisher is still running
+ *
+ * @param name feed name
+ * @return true if its shared memory object is still there
+ */
+auto telemetryExists(const string& name) -> bool {
+  auto descriptor = shm_open(telemetryObjectName(name).c_str(), O_RDONLY, 0);
+  if (descriptor < 0) {
+    return false;
+  }
+  close(descriptor);
+  return true;
+}
+
+/**
+ * Copy a name into a fixed size field, truncating it if necessary
+ *
+ * @param field destination
+ * @param name name to copy
+ */
+static auto copyName(char* field, const string& name) -> void {
+  const auto length = min(name.size(), TELEMETRY_NAME_LENGTH - 1);
+  memcpy(field, name.data(), length);
+  field[length] = '\0';
+}
+
+//===================================================================
+
+/**
+ * Constructor.  Creates the shared memory object, replacing any left
+ * behind by an earlier run with the same name.
+ *
+ * @param name feed name, which the viewer needs to attach to it
+ * @param columns comma separated names of the columns to publish, of
+ *                which the ones each run has are used
+ */
+TelemetryPublisher::TelemetryPublisher(const string& name,
+				       const string& columns) :
+  objectName{telemetryObjectName(name)} {
+  auto stream = istringstream{columns};
+  auto column = string{};
+  while (getline(stream, column, ',')) {
+    if (!column.empty()) {
+      wanted.push_back(column);
+    }
+  }
+
+  auto descriptor = shm_open(objectName.c_str(), O_CREAT | O_RDWR, 0644);
+  if (descriptor < 0 || ftruncate(descriptor, sizeof(TelemetryArea)) != 0) {
+    cout << "Unable to create shared memory " << objectName << endl;
+    exit(EXIT_FAILURE);
+  }
+  auto memory = mmap(nullptr, sizeof(TelemetryArea), PROT_READ | PROT_WRITE,
+		     MAP_SHARED, descriptor, 0);
+  close(descriptor);
+  if (memory == MAP_FAILED) {
+    cout << "Unable to map shared memory " << objectName << endl;
+    exit(EXIT_FAILURE);
+  }
+  area = new (memory) TelemetryArea{};
+  area->version = TELEMETRY_VERSION;
+  atomic_thread_fence(memory_order_release);
+  area->magic = TELEMETRY_MAGIC;
+}
+
+/**
+ * Set the name that the next run is published under
+ *
+ * @param name run name, usually the output filename
+ */
+auto TelemetryPublisher::setRunName(const string& name) -> void {
+  runName = name;
+}
+
+/**
+ * Start publishing a new run
+ *
+ * @param headings the run's column headings
+ * @param totalTimeSteps number of time steps in the run
+ */
+auto TelemetryPublisher::beginRun(const string& headings,
+				  size_t totalTimeSteps) -> void {
+  fieldIndices.clear();
+  auto published = vector<string>{};
+  for (auto&& name : wanted) {
+    const auto field = findField(headings, name);
+    if (field && fieldIndices.size() < TELEMETRY_COLUMNS) {
+      fieldIndices.push_back(*field);
+      published.push_back(name);
+    }
+  }
+
+  // Odd while the description is changing
+  area->runSequence.fetch_add(1, memory_order_acq_rel);
+  copyName(area->runName, runName.empty() ? "run" : runName);
+  area->columnCount = published.size();
+  for (auto index = size_t{0}; index < published.size(); index++) {
+    copyName(area->columns[index], published.at(index));
+  }
+  area->totalTimeSteps.store(totalTimeSteps, memory_order_relaxed);
+  area->timeStepsDone.store(0, memory_order_relaxed);
+  area->startNanoseconds.store(telemetryNanoseconds(), memory_order_relaxed);
+  area->runSequence.fetch_add(1, memory_order_release);
+}
+
+/**
+ * Publish how far the run has got.  It never goes backwards, so
+ * several threads can report it, and a run can publish its samples
+ * in order after it has finished.
+ *
+ * @param timeStepsDone number of time steps simulated so far
+ */
+auto TelemetryPublisher::progress(size_t timeStepsDone) -> void {
+  auto published = area->timeStepsDone.load(memory_order_relaxed);
+  while (published < timeStepsDone &&
+	 !area->timeStepsDone.compare_exchange_weak(published, timeStepsDone,
+						    memory_order_relaxed)) {
+  }
+}
+
+/**
+ * Publish a sample of the chosen columns, overwriting the oldest
+ *
+ * @param timeStep time step
+ * @param timeStamp time corresponding to the time step
+ * @param fields values of all the run's columns
+ */
+auto TelemetryPublisher::sample(size_t timeStep,
+				floating timeStamp,
+				const vector<floating>& fields) -> void {
+  const auto index = area->writeIndex.load(memory_order_relaxed);
+  auto& slot = area->slots[index % TELEMETRY_SLOTS];
+
+  slot.sequence.store(0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot.timeStep.store(timeStep, memory_order_relaxed);
+  slot.time.store(static_cast<double>(timeStamp), memory_order_relaxed);
+  for (auto column = size_t{0}; column < fieldIndices.size(); column++) {
+    slot.values[column].store(static_cast<double>
+			      (fields.at(fieldIndices.at(column))),
+			      memory_order_relaxed);
+  }
+  slot.sequence.store(index + 1, memory_order_release);
+  area->writeIndex.store(index + 1, memory_order_release);
+}
+
+/**
+ * Destructor removes the shared memory object
+ */
+TelemetryPublisher::~TelemetryPublisher() {
+  munmap(area, sizeof(TelemetryArea));
+  shm_unlink(objectName.c_str());
+}
+
+//===================================================================
+
+/**
+ * Constructor attaches to a publisher's shared memory
+ *
+ * @param name feed name
+ */
+TelemetryReader::TelemetryReader(const string& name) {
+  const auto objectName = telemetryObjectName(name);
+  auto descriptor = shm_open(objectName.c_str(), O_RDONLY, 0);
+  struct stat status;
+  if (descriptor < 0 || fstat(descriptor, &status) != 0 ||
+      static_cast<size_t>(status.st_size) < sizeof(TelemetryArea)) {
+    cout << "No telemetry called " << name << endl;
+    exit(EXIT_FAILURE);
+  }
+  auto memory = mmap(nullptr, sizeof(TelemetryArea), PROT_READ,
+		     MAP_SHARED, descriptor, 0);
+  close(descriptor);
+  if (memory == MAP_FAILED) {
+    cout << "Unable to map shared memory " << objectName << endl;
+    exit(EXIT_FAILURE);
+  }
+  area = static_cast<const TelemetryArea*>(memory);
+  if (area->magic != TELEMETRY_MAGIC ||
+      area->version != TELEMETRY_VERSION) {
+    cout << "Telemetry " << name << " is from a different version" << endl;
+    exit(EXIT_FAILURE);
+  }
+  atomic_thread_fence(memory_order_acquire);
+}
+
+/**
+ * Get a consistent copy of the description of the current run
+ *
+ * @return the run
+ */
+auto TelemetryReader::getRun() const -> TelemetryRun {
+  while (true) {
+    const auto before = area->runSequence.load(memory_order_acquire);
+    if (before % 2 == 0) {
+      auto run = TelemetryRun{};
+      run.sequence = before;
+      run.name = string{area->runName,
+			strnlen(area->runName, TELEMETRY_NAME_LENGTH)};
+      const auto count = min<size_t>(area->columnCount, TELEMETRY_COLUMNS);
+      for (auto index = size_t{0}; index < count; index++) {
+	run.columns.emplace_back(area->columns[index],
+				 strnlen(area->columns[index],
+					 TELEMETRY_NAME_LENGTH));
+      }
+      run.totalTimeSteps = area->totalTimeSteps.load(memory_order_relaxed);
+      run.timeStepsDone = area->timeStepsDone.load(memory_order_relaxed);
+      run.startNanoseconds =
+	area->startNanoseconds.load(memory_order_relaxed);
+      atomic_thread_fence(memory_order_acquire);
+      if (area->runSequence.load(memory_order_relaxed) == before) {
+	return run;
+      }
+    }
+    this_thread::yield();
+  }
+}
+
+/**
+ * @return index that the next sample will have
+ */
+auto TelemetryReader::getWriteIndex() const -> uint64_t {
+  return area->writeIndex.load(memory_order_acquire);
+}
+
+/**
+ * Copy the samples published since an earlier call.  Samples that
+ * have been overwritten, or are being overwritten, are left out.
+ *
+ * @param fromIndex index of the first sample wanted
+ * @return the samples, oldest first
+ */
+auto TelemetryReader::read(uint64_t fromIndex) const
+  -> vector<TelemetrySample> {
+  auto samples = vector<TelemetrySample>{};
+  const auto writeIndex = getWriteIndex();
+  const auto oldest = writeIndex > TELEMETRY_SLOTS ?
+    writeIndex - TELEMETRY_SLOTS : 0;
+  const auto count = min<size_t>(area->columnCount, TELEMETRY_COLUMNS);
+
+  for (auto index = max(fromIndex, oldest); index < writeIndex; index++) {
+    const auto& slot = area->slots[index % TELEMETRY_SLOTS];
+    if (slot.sequence.load(memory_order_acquire) != index + 1) {
+      continue;
+    }
+    auto sample = TelemetrySample{index,
+				  slot.timeStep.load(memory_order_relaxed),
+				  slot.time.load(memory_order_relaxed),
+				  vector<double>(count)};
+    for (auto column = size_t{0}; column < count; column++) {
+      sample.values[column] = slot.values[column].load(memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.sequence.load(memory_order_relaxed) == index + 1) {
+      samples.push_back(move(sample));
+    }
+  }
+  return samples;
+}
+
+/**
+ * Destructor detaches from the shared memory
+ */
+TelemetryReader::~TelemetryReader() {
+  munmap(const_cast<TelemetryArea*>(area), sizeof(TelemetryArea));
+}
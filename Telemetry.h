@@ -0,0 +1,166 @@
+/**
+ * Live progress and samples in shared memory
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "misc.h"
+
+// Most columns that can be published
+constexpr auto TELEMETRY_COLUMNS = std::size_t{8};
+
+// Samples kept in the ring, the oldest being overwritten
+constexpr auto TELEMETRY_SLOTS = std::size_t{4096};
+
+// Longest column and run names, including the terminating null
+constexpr auto TELEMETRY_NAME_LENGTH = std::size_t{64};
+
+// Time steps between published samples, the same as the output files
+constexpr auto TELEMETRY_STEP = std::size_t{100};
+
+// Change this whenever the shared memory layout changes
+constexpr auto TELEMETRY_VERSION = std::uint32_t{1};
+
+// Columns published if none are chosen
+constexpr auto DEFAULT_TELEMETRY_COLUMNS =
+  "signal,modulation,IC2A,IC2B,inphase,quadrature";
+
+/**
+ * One published sample.  The sequence number is zero while the slot
+ * is being written and the sample's index plus one after it, so a
+ * reader can tell if the slot was overwritten while it was copying it.
+ */
+struct TelemetrySlot {
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<std::uint64_t> timeStep;
+  std::atomic<double> time;
+  std::atomic<double> values[TELEMETRY_COLUMNS];
+};
+
+/**
+ * Layout of the shared memory.  There is one writer, the simulation,
+ * which never waits for the readers.  The run description is guarded
+ * by runSequence in the same way, being odd while it is changing.
+ */
+struct TelemetryArea {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::atomic<std::uint64_t> runSequence;
+  char runName[TELEMETRY_NAME_LENGTH];
+  std::uint32_t columnCount;
+  char columns[TELEMETRY_COLUMNS][TELEMETRY_NAME_LENGTH];
+  std::atomic<std::uint64_t> totalTimeSteps;
+  std::atomic<std::uint64_t> timeStepsDone;
+  std::atomic<std::uint64_t> startNanoseconds;
+  std::atomic<std::uint64_t> writeIndex;
+  TelemetrySlot slots[TELEMETRY_SLOTS];
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+	      std::atomic<double>::is_always_lock_free,
+	      "Telemetry needs lock free atomics to share them between "
+	      "processes");
+
+auto telemetryObjectName(const std::string& name) -> std::string;
+auto telemetryNanoseconds() -> std::uint64_t;
+auto telemetryExists(const std::string& name) -> bool;
+
+//===================================================================
+
+/**
+ * Publishes the progress of each run, and a sample of some of its
+ * columns every TELEMETRY_STEP time steps, in a POSIX shared memory
+ * object that a viewer can attach to.  Nothing waits for the viewer,
+ * so it costs the simulation next to nothing.  The shared memory
+ * object is removed when this is destroyed.
+ */
+class TelemetryPublisher {
+private:
+  const std::string objectName;
+  TelemetryArea* area;
+  std::vector<std::string> wanted;
+  std::vector<std::size_t> fieldIndices;
+  std::string runName;
+
+public:
+  TelemetryPublisher(const std::string& name,
+		     const std::string& columns = DEFAULT_TELEMETRY_COLUMNS);
+  TelemetryPublisher(const TelemetryPublisher&) = delete;
+  TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+  auto setRunName(const std::string& name) -> void;
+  auto beginRun(const std::string& headings,
+		std::size_t totalTimeSteps) -> void;
+  auto progress(std::size_t timeStepsDone) -> void;
+  auto sample(std::size_t timeStep,
+	      floating timeStamp,
+	      const std::vector<floating>& fields) -> void;
+  ~TelemetryPublisher();
+};
+
+//===================================================================
+
+/**
+ * A sample copied out of the ring
+ */
+struct TelemetrySample {
+  std::uint64_t index;
+  std::uint64_t timeStep;
+  double time;
+  std::vector<double> values;
+};
+
+/**
+ * Description of the run being published
+ */
+struct TelemetryRun {
+  std::uint64_t sequence;
+  std::string name;
+  std::vector<std::string> columns;
+  std::uint64_t totalTimeSteps;
+  std::uint64_t timeStepsDone;
+  std::uint64_t startNanoseconds;
+};
+
+/**
+ * Attaches to a publisher's shared memory, read only, for a viewer
+ */
+class TelemetryReader {
+private:
+  const TelemetryArea* area;
+
+public:
+  TelemetryReader(const std::string& name);
+  TelemetryReader(const TelemetryReader&) = delete;
+  TelemetryReader& operator=(const TelemetryReader&) = delete;
+  auto getRun() const -> TelemetryRun;
+  auto getWriteIndex() const -> std::uint64_t;
+  auto read(std::uint64_t fromIndex) const -> std::vector<TelemetrySample>;
+  ~TelemetryReader();
+};
@@ -0,0 +1,179 @@
+/**
+ * Timeline tracing, written as Chrome trace event JSON
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unistd.h>
+#include "Trace.h"
+
+using namespace std;
+
+atomic<bool> Trace::active{false};
+
+// Every thread that has recorded anything, in the order they started
+// recording.  The lock is only taken when a thread records its first
+// event, and when the trace is written.
+static mutex threadsLock;
+static vector<shared_ptr<TraceThread>> threads;
+
+// The trace's time zero
+static chrono::steady_clock::time_point epoch;
+
+//===================================================================
+
+/**
+ * Write a string as a JSON string, with quotes and escapes
+ *
+ * @param stream where to write it
+ * @param text the string
+ */
+static auto writeJsonString(ostream& stream, const string& text) -> void {
+  stream << '"';
+  for (auto character : text) {
+    if (character == '"' || character == '\\') {
+      stream << '\\' << character;
+    }
+    else if (static_cast<unsigned char>(character) < 0x20) {
+      stream << ' ';
+    }
+    else {
+      stream << character;
+    }
+  }
+  stream << '"';
+}
+
+//===================================================================
+
+/**
+ * Start recording events.  The calling thread's timeline is the
+ * first, and is called "main".
+ */
+auto Trace::start() -> void {
+  epoch = chrono::steady_clock::now();
+  active.store(true, memory_order_relaxed);
+  current().name = "main";
+}
+
+/**
+ * Get the calling thread's buffer, creating it the first time
+ *
+ * @return the buffer
+ */
+auto Trace::current() -> TraceThread& {
+  thread_local auto buffer = shared_ptr<TraceThread>{};
+  if (!buffer) {
+    buffer = make_shared<TraceThread>();
+    buffer->events.reserve(TRACE_BUFFER_EVENTS);
+    auto lock = lock_guard<mutex>{threadsLock};
+    buffer->id = threads.size() + 1;
+    buffer->name = "thread " + to_string(buffer->id);
+    threads.push_back(buffer);
+  }
+  return *buffer;
+}
+
+/**
+ * Name the calling thread's timeline
+ *
+ * @param name the name
+ */
+auto Trace::nameThread(const string& name) -> void {
+  if (enabled()) {
+    current().name = name;
+  }
+}
+
+/**
+ * Get the time since the trace started
+ *
+ * @return time in nanoseconds
+ */
+auto Trace::now() -> int64_t {
+  return chrono::duration_cast<chrono::nanoseconds>(
+    chrono::steady_clock::now() - epoch).count();
+}
+
+/**
+ * Record an event that has just finished on the calling thread
+ *
+ * @param name event name
+ * @param detail more about the event, empty if there is nothing
+ * @param startNs when the event started
+ */
+auto Trace::record(const char* name,
+		   const string& detail,
+		   int64_t startNs) -> void {
+  current().events.push_back(TraceEvent{name, detail, startNs, now() - startNs});
+}
+
+/**
+ * Write all the events recorded so far as Chrome trace event JSON,
+ * with a track for each thread.  The threads that recorded them must
+ * have finished, or be between events.
+ *
+ * @param filename file to write
+ */
+auto Trace::write(const string& filename) -> void {
+  auto file = ofstream{filename};
+  if (!file) {
+    cout << "Unable to write trace file " << filename << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  const auto pid = getpid();
+  auto lock = lock_guard<mutex>{threadsLock};
+  file << fixed << setprecision(3)
+       << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  auto first = true;
+  for (auto&& thread : threads) {
+    file << (first ? "" : ",\n")
+	 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+	 << ",\"tid\":" << thread->id << ",\"args\":{\"name\":";
+    writeJsonString(file, thread->name);
+    file << "}}";
+    first = false;
+
+    for (auto&& event : thread->events) {
+      file << ",\n{\"name\":";
+      writeJsonString(file, event.name);
+      file << ",\"cat\":\"zetasdr\",\"ph\":\"X\",\"pid\":" << pid
+	   << ",\"tid\":" << thread->id
+	   << ",\"ts\":" << event.startNs / 1000.0
+	   << ",\"dur\":" << event.durationNs / 1000.0;
+      if (!event.detail.empty()) {
+	file << ",\"args\":{\"detail\":";
+	writeJsonString(file, event.detail);
+	file << "}";
+      }
+      file << "}";
+    }
+  }
+  file << "\n]}\n";
+}
@@ -0,0 +1,135 @@
+/**
+ * Timeline tracing, written as Chrome trace event JSON
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Events each thread's buffer makes room for when it is created
+constexpr auto TRACE_BUFFER_EVENTS = std::size_t{4096};
+
+/**
+ * One completed span of time on one thread
+ */
+struct TraceEvent {
+  const char* name;
+  std::string detail;
+  std::int64_t startNs;
+  std::int64_t durationNs;
+};
+
+/**
+ * The events recorded by one thread.  Only that thread adds to it, so
+ * recording needs no locks.
+ */
+struct TraceThread {
+  std::size_t id;
+  std::string name;
+  std::vector<TraceEvent> events;
+};
+
+/**
+ * Records what each thread is doing and when, for viewing as a
+ * timeline in chrome://tracing or https://ui.perfetto.dev.  Each
+ * thread has its own buffer, which it finds the first time it records
+ * an event, so threads never wait for each other.  While tracing is
+ * off, recording is one relaxed atomic load.
+ */
+class Trace {
+private:
+  static std::atomic<bool> active;
+  static auto current() -> TraceThread&;
+
+public:
+  static auto start() -> void;
+  static auto write(const std::string& filename) -> void;
+  static auto nameThread(const std::string& name) -> void;
+  static auto now() -> std::int64_t;
+  static auto record(const char* name,
+		     const std::string& detail,
+		     std::int64_t startNs) -> void;
+
+  /**
+   * Find out if events are being recorded
+   *
+   * @return true if they are
+   */
+  static auto enabled() -> bool {
+    return active.load(std::memory_order_relaxed);
+  }
+};
+
+//===================================================================
+
+/**
+ * Records the time from its construction to its destruction as an
+ * event on the calling thread's timeline.  The name must be a string
+ * literal, or otherwise outlive the trace.
+ */
+class TraceScope {
+private:
+  const char* name;
+  std::string detail;
+  std::int64_t startNs;
+
+public:
+  /**
+   * Constructor
+   *
+   * @param name event name
+   */
+  TraceScope(const char* name) :
+    name{name},
+    startNs{Trace::enabled() ? Trace::now() : -1} {}
+
+  /**
+   * Constructor
+   *
+   * @param name event name
+   * @param detail more about the event, such as a filename
+   */
+  TraceScope(const char* name, const std::string& detail) :
+    name{name},
+    startNs{Trace::enabled() ? Trace::now() : -1} {
+    if (startNs >= 0) {
+      this->detail = detail;
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  ~TraceScope() {
+    if (startNs >= 0) {
+      Trace::record(name, detail, startNs);
+    }
+  }
+};
@@ -0,0 +1,134 @@
+/**
+ * Cache of synthesised RF signals, shared between runs
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <sstream>
+#include "Signal.h"
+#include "WaveformCache.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ *
+ * @param maxBytes limit on the memory taken by the waveforms that
+ *                 aren't being used
+ */
+WaveformCache::WaveformCache(size_t maxBytes) : maxBytes{maxBytes} {}
+
+/**
+ * Get the synthesised signal for a range of time steps, synthesising
+ * it if it isn't already in the cache.
+ *
+ * @param signal signal characteristics
+ * @param firstTimeStep first time step
+ * @param count number of time steps
+ * @return the signal voltages, the first being at firstTimeStep
+ */
+auto WaveformCache::get(const Signal& signal,
+			size_t firstTimeStep,
+			size_t count) -> shared_ptr<const Waveform> {
+  auto stream = ostringstream{};
+  stream << firstTimeStep << " " << count << "\n" << signal.describe();
+  const auto key = stream.str();
+
+  auto entry = shared_ptr<Entry>{};
+  {
+    auto lock = lock_guard<std::mutex>{mutex};
+    auto& slot = entries[key];
+    if (slot) {
+      hits++;
+    }
+    else {
+      slot = make_shared<Entry>();
+      misses++;
+    }
+    entry = slot;
+    entry->lastUse = ++useCount;
+  }
+
+  // Synthesise it outside the lock, so that other waveforms can be
+  // fetched meanwhile
+  call_once(entry->synthesised, [&]() {
+      auto samples = make_shared<Waveform>(count);
+      signal.synthesise(firstTimeStep, count, samples->data());
+      entry->samples = move(samples);
+    });
+
+  auto samples = entry->samples;
+  {
+    auto lock = lock_guard<std::mutex>{mutex};
+    entry->bytes = samples->size() * sizeof(floating);
+    evict();
+  }
+  return samples;
+}
+
+/**
+ * Drop the least recently used waveforms until the cache is within
+ * its limit.  Waveforms that are still being used, or are still being
+ * synthesised, are kept.  The mutex must be held.
+ */
+auto WaveformCache::evict() -> void {
+  auto total = size_t{0};
+  for (auto&& [key, entry] : entries) {
+    total += entry->bytes;
+  }
+
+  while (total > maxBytes) {
+    auto oldest = entries.end();
+    for (auto position = entries.begin(); position != entries.end();
+	 position++) {
+      const auto& entry = position->second;
+      // Nothing else can be using the entry if only the map holds it
+      if (entry.use_count() == 1 && entry->samples.use_count() == 1 &&
+	  (oldest == entries.end() ||
+	   entry->lastUse < oldest->second->lastUse)) {
+	oldest = position;
+      }
+    }
+    if (oldest == entries.end()) {
+      return;
+    }
+    total -= oldest->second->bytes;
+    entries.erase(oldest);
+  }
+}
+
+/**
+ * @return number of times a waveform was found in the cache
+ */
+auto WaveformCache::getHits() -> size_t {
+  auto lock = lock_guard<std::mutex>{mutex};
+  return hits;
+}
+
+/**
+ * @return number of times a waveform had to be synthesised
+ */
+auto WaveformCache::getMisses() -> size_t {
+  auto lock = lock_guard<std::mutex>{mutex};
+  return misses;
+}
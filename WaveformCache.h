@@ -0,0 +1,81 @@
+/**
+ * Cache of synthesised RF signals, shared between runs
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "misc.h"
+
+class Signal;
+
+// Default limit on the memory taken by the cached waveforms
+constexpr auto DEFAULT_WAVEFORM_CACHE_BYTES = std::size_t{1} << 30;
+
+/**
+ * Keeps the synthesised RF signal for a run, so that other runs with
+ * the same signal over the same time steps, such as the other phase
+ * angles or the other receiver, don't have to synthesise it again.
+ * The waveforms are shared read-only, and any number of threads can
+ * ask for them at once.  Only one of them synthesises a waveform that
+ * isn't there yet, and the rest wait for it.
+ *
+ * When the cache is over its limit, the least recently used waveforms
+ * that no run is still using are dropped.
+ */
+class WaveformCache {
+public:
+  using Waveform = std::vector<floating>;
+
+private:
+  struct Entry {
+    std::once_flag synthesised;
+    std::shared_ptr<const Waveform> samples;
+    std::size_t bytes = 0;
+    std::size_t lastUse = 0;
+  };
+
+  const std::size_t maxBytes;
+  std::mutex mutex;
+  std::map<std::string, std::shared_ptr<Entry>> entries;
+  std::size_t useCount = 0;
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+
+  auto evict() -> void;
+
+public:
+  WaveformCache(std::size_t maxBytes = DEFAULT_WAVEFORM_CACHE_BYTES);
+  auto get(const Signal& signal,
+	   std::size_t firstTimeStep,
+	   std::size_t count) -> std::shared_ptr<const Waveform>;
+  auto getHits() -> std::size_t;
+  auto getMisses() -> std::size_t;
+};
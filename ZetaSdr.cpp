@@ -27,201 +27,317 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <atomic>
 #include <iostream>
+#include <sstream>
+#include <thread>
+#include <type_traits>
 #include "Mixer.h"
+#include "Scenarios.h"
 #include "Signal.h"
+#include "Butterworth.h"
+#include "SpscQueue.h"
+#include "StateSpace.h"
+#include "TayloeDetector.h"
+#include "Trace.h"
 
 using namespace std;
 
-// Voltage corresponding to logic 1
-constexpr auto LOGIC_ONE_VOLTAGE = floating{2.4};
+// Entries in the DataLine struct
+constexpr auto INDEX_SIGNAL = size_t{0};
+constexpr auto INDEX_MODULATION = size_t{1};
+constexpr auto INDEX_CAPC2_VOLTAGE = size_t{2};
+constexpr auto INDEX_CAPC3_VOLTAGE = size_t{3};
+constexpr auto INDEX_CAPC4_VOLTAGE = size_t{4};
+constexpr auto INDEX_CAPC5_VOLTAGE = size_t{5};
+constexpr auto INDEX_DIFFERENCE_IC2A = size_t{6};
+constexpr auto INDEX_DIFFERENCE_IC2B = size_t{7};
+constexpr auto INDEX_FILTERED_INPHASE = size_t{8};
+constexpr auto INDEX_FILTERED_QUADRATURE = size_t{9};
+constexpr auto INDEX_DEMODULATED = size_t{10};
+constexpr auto INDEX_OPAMP_INPHASE = size_t{11};
+constexpr auto INDEX_OPAMP_QUADRATURE = size_t{12};
 
-//===================================================================
+// Time steps synthesised, and passed between the pipeline stages, in
+// one go
+constexpr auto PIPELINE_BLOCK_SIZE = size_t{4096};
 
-/**
- * This represents the Johnson counter constructed from two D type
- * flip flops.  In practice there will be some propagation delay
- * between the clock changing and the output from a counter changing,
- * but this is not modelled by this class.
- */
-class JohnsonCounter {
-  // This is the state, 0->3
-  unsigned state;
+// Blocks that can be waiting between two pipeline stages
+constexpr auto PIPELINE_QUEUE_LENGTH = size_t{16};
 
-  // The counter is a twisted ring counter, so
-  // the output pattern is {AB} 00, 01, 11, 10
-  static constexpr auto OUTPUT_VALUE = array<unsigned, 4>{0, 1, 3, 2};
-
-public:
-  JohnsonCounter() : state{0} {}
-
-  /**
-   * Advance the Johnson counter by one clock
-   */
-  auto clock() {
-    if (++state > 3) {
-      state = 0;
-    }
-  }
+// Detector phases in the ZetaSDR itself
+constexpr auto ZETASDR_PHASES = size_t{4};
 
-  /**
-   * Get the number of states
-   *
-   * @return number of states
-   */
-  static auto stateCount() {
-    return OUTPUT_VALUE.size();
-  }
+//===================================================================
 
-  /**
-   * Get the current output value of the Johnson counter
-   */
-  auto get() {
-    return OUTPUT_VALUE.at(state);
-  }
+/**
+ * A block of consecutive time steps, passed along the pipeline.  Each
+ * stage fills in its own vectors.
+ */
+struct PipelineBlock {
+  size_t firstTimeStep;
+  size_t count;
+  vector<floating> signal;
+  vector<floating> modulation;
+  vector<floating> jitter;
+  vector<floating> c2;
+  vector<floating> c3;
+  vector<floating> c4;
+  vector<floating> c5;
+  vector<floating> inphase;
+  vector<floating> quadrature;
+  vector<floating> opAmpInphase;
+  vector<floating> opAmpQuadrature;
+  vector<floating> filteredInphase;
+  vector<floating> filteredQuadrature;
 };
 
+// An empty pointer marks the end of the run
+using PipelineQueue = SpscQueue<unique_ptr<PipelineBlock>>;
+
+//===================================================================
 
 /**
- * This represents the local oscillator.  This provides the clock to
- * the Johnson Counter
+ * Fills in the signal, modulation and local oscillator jitter for
+ * blocks of time steps, adding any noise.  The blocks must be filled
+ * in time step order.
  */
-class LocalOscillator {
-
+class Synthesiser {
 private:
-  // Current time step
-  floating timeStep;
-  // Number of time steps per carrier cycle
-  floating timeStepsPerCycle;
-  JohnsonCounter& johnsonCounter;
-  floating voltage;
-  bool errorFlagged;
-  static constexpr const floating AMPLITUDE = 5.0;
+  const Signal& signal;
+  const shared_ptr<const WaveformCache::Waveform> waveform;
+  optional<NoiseSource> signalNoise;
+  optional<GaussianNoise> jitterNoise;
+  const floating jitterScale;
+  vector<double> buffer;
 
+public:
   /**
-   * Get voltage level of local oscillator at the current timestep
+   * Constructor
    *
-   * @return the voltage
+   * @param signal signal characteristics
+   * @param waveform the signal already synthesised from time step 1,
+   *                 or an empty pointer to synthesise it here
+   * @param noise noise characteristics, if there is any noise
    */
-  auto getVoltage() {
-    auto value = floating{sin(2.0 * M_PI * timeStep / timeStepsPerCycle)};
-    value = ((value + 1.0) / 2.0) * AMPLITUDE;
-    if (!errorFlagged && isnan(value)) {
-      cerr << value << " (LocalOscillator) is not a number" << endl;
-      errorFlagged = true;
+  Synthesiser(const Signal& signal,
+	      const shared_ptr<const WaveformCache::Waveform>& waveform,
+	      const optional<NoiseSettings>& noise) :
+    signal{signal},
+    waveform{waveform},
+    jitterScale{noise ? noise->jitterSeconds / TIME_STEP_SIZE : 0} {
+    if (noise && noise->rmsVolts) {
+      signalNoise.emplace(*noise, NOISE_STREAM_SIGNAL);
     }
-    else {
-      errorFlagged = false;
+    if (noise && noise->jitterSeconds) {
+      jitterNoise.emplace(noise->seed, NOISE_STREAM_LOCAL_OSCILLATOR);
     }
-    return value;
   }
 
-public:
   /**
-   * Constructor.  Set the start state of the counter, and the time
-   * steps corresponding to a cycle of the carrier.  The phase offset
-   * is handled by retarding the initial value of the current time
-   * steps so that it takes the number of time steps corresponding to
-   * the phase angle of the carrier before it reaches 0.
+   * Fill in the next block
    *
-   * @param frequencyHz local oscillator frequency
-   * @param phaseOffsetRadians phase offset of oscillator driving
-   * Johnson counter with respect to the radio carrier phase
-   * @param johnsonCounter Johnson counter object that the oscillator 
-   *                       drives
+   * @param block block with its first time step and count set
    */
-  LocalOscillator(floating frequencyHz,
-		  floating phaseOffsetRadians,
-		  JohnsonCounter& johnsonCounter) :
-    timeStep{static_cast<decltype(timeStep)>(-floor(phaseOffsetRadians))},
-    timeStepsPerCycle{floor(1.0 / (TIME_STEP_SIZE * frequencyHz))},
-    johnsonCounter{johnsonCounter},
-    voltage{getVoltage()},
-    errorFlagged{false} {
+  auto fill(PipelineBlock& block) -> void {
+    auto trace = TraceScope{"synthesise"};
+    const auto first = block.firstTimeStep;
+    block.signal.resize(block.count);
+    block.modulation.resize(block.count);
+    block.jitter.assign(block.count, 0);
+
+    if (waveform) {
+      copy_n(waveform->begin() + (first - 1), block.count,
+	     block.signal.begin());
+    }
+    else {
+      signal.synthesise(first, block.count, block.signal.data());
+    }
+    if (signalNoise) {
+      signalNoise->add(first, block.count, block.signal.data());
+    }
+    for (auto index = size_t{0}; index < block.count; index++) {
+      block.modulation[index] = signal.getAmplitude(0, first + index);
+      // Add 2.5 volts (Vcc/2) bias
+      block.signal[index] += 2.5;
     }
 
-  /**
-   * Advance counter by one timestep.  The local oscillator which
-   * drives the counter runs at four times the carrier frequency. The
-   * phase difference between the local oscillator and the carrier is
-   * handled by retarding the start value of the time step counter by
-   * an amount corresponding to the initial phase difference.
-   */
-  auto step() {
-    // One more time step
-    timeStep++;
-    auto previousVoltage = voltage;
-    voltage = getVoltage();
-    // Clock the Johnson counter when the local oscillator output
-    // changes from logic 0 to logic 1
-    if (previousVoltage < LOGIC_ONE_VOLTAGE &&
-	voltage >= LOGIC_ONE_VOLTAGE) {
-      johnsonCounter.clock();
+    if (jitterNoise) {
+      buffer.resize(block.count);
+      jitterNoise->generate(first, block.count, buffer.data());
+      for (auto index = size_t{0}; index < block.count; index++) {
+	block.jitter[index] = buffer[index] * jitterScale;
+      }
     }
   }
 };
-  
+
+//===================================================================
 
 /**
- * This represents a sample and hold capacitors on the outputs from
- * the 74HC4052.  It incorporates the resistance through the pair of
- * 74HC4052 channels.
+ * Run the active filters over the detector outputs in a block
+ *
+ * @param opAmps the active filters
+ * @param block block with its detector outputs filled in
+ * @param first index in the block of the first time step to filter
  */
-class SeriesRC {
-private:
-  const floating timeConstant;
-  floating voltage;  // voltage currently across capacitor
-  bool errorFlagged;
-public:
-
-  /**
-   * Constructor
-   *
-   * @param circuit circuit characteristics, specifically detector
-   * capacitors value and resistance through 74HC4052 and
-   */
-  SeriesRC(const Circuit& circuit) :
-    timeConstant{circuit.resistance * circuit.capacitance},
-    voltage{0},
-    errorFlagged{false} {}
+static auto opAmpBlock(StateSpace& opAmps,
+		       PipelineBlock& block,
+		       size_t first) -> void {
+  block.opAmpInphase.resize(block.count);
+  block.opAmpQuadrature.resize(block.count);
+  auto opAmpInput = vector<floating>(2);
+  for (auto index = first; index < block.count; index++) {
+    opAmpInput.at(0) = block.inphase[index];
+    opAmpInput.at(1) = block.quadrature[index];
+    opAmps.step(opAmpInput);
+    auto opAmpOutput = opAmps.output(opAmpInput);
+    block.opAmpInphase[index] = opAmpOutput.at(0);
+    block.opAmpQuadrature[index] = opAmpOutput.at(1);
+  }
+}
 
-  /**
-   * Get the voltage across the capacitor
-   *
-   * @return the voltage across the capacitor
-   */
-  auto getVoltage() {
-    return voltage;
+/**
+ * Run the detector, and the active filters after it if there are
+ * any, over a block of time steps
+ *
+ * @param detector the detector
+ * @param opAmps the active filters, if they are simulated
+ * @param block block with its signal filled in
+ */
+template <typename Detector>
+static auto detectBlock(Detector& detector,
+			optional<StateSpace>& opAmps,
+			PipelineBlock& block) -> void {
+  auto trace = TraceScope{"detect"};
+  block.c2.resize(block.count);
+  block.c3.resize(block.count);
+  block.c4.resize(block.count);
+  block.c5.resize(block.count);
+  block.inphase.resize(block.count);
+  block.quadrature.resize(block.count);
+  for (auto index = size_t{0}; index < block.count; index++) {
+    detector.step(block.signal[index], block.jitter[index]);
+    block.c2[index] = detector.getC2();
+    block.c3[index] = detector.getC3();
+    block.c4[index] = detector.getC4();
+    block.c5[index] = detector.getC5();
+    block.inphase[index] = detector.getInphase();
+    block.quadrature[index] = detector.getQuadrature();
+  }
+  if (opAmps) {
+    opAmpBlock(*opAmps, block, 0);
   }
+}
 
-  /**
-   * Apply the specified voltage for one time step.
-   *
-   * @param appliedVoltage applied voltage
-   */
-  auto applyVoltageForOneTimeStep(floating appliedVoltage) {
-    auto voltageDifference = appliedVoltage - voltage;
-
-    voltage += voltageDifference * exp(-TIME_STEP_SIZE / timeConstant);
-				       
-    if (!errorFlagged && isnan(voltage)) {
-      cerr << voltage << " (SeriesRC) is not a number" << endl;
-      errorFlagged = true;
+/**
+ * Low pass filter the detector outputs over a block of time steps
+ *
+ * @param block block with its detector outputs filled in
+ * @param inphaseFilter filter for the inphase output
+ * @param quadratureFilter filter for the quadrature output
+ * @param lpFreqHz filter cutoff frequency, 0 if it is disabled
+ */
+static auto filterBlock(PipelineBlock& block,
+			Butterworth& inphaseFilter,
+			Butterworth& quadratureFilter,
+			floating lpFreqHz) -> void {
+  auto trace = TraceScope{"filter"};
+  auto input = vector<double>(block.count);
+  auto filteredValues = vector<double>(block.count);
+  block.filteredInphase.resize(block.count);
+  block.filteredQuadrature.resize(block.count);
+
+  for (auto channel = 0; channel < 2; channel++) {
+    const auto& detected = channel ? block.quadrature : block.inphase;
+    auto& output = channel ? block.filteredQuadrature :
+      block.filteredInphase;
+    auto& filter = channel ? quadratureFilter : inphaseFilter;
+
+    if (!lpFreqHz) {
+      // Disabled, so just copy input to output
+      copy(detected.begin(), detected.end(), output.begin());
+      continue;
     }
-    else {
-      errorFlagged = false;
+    for (auto index = size_t{0}; index < block.count; index++) {
+      input[index] = static_cast<double>(detected[index]);
+    }
+    filter.apply(input.data(), filteredValues.data(), block.count);
+    for (auto index = size_t{0}; index < block.count; index++) {
+      output[index] = static_cast<floating>(filteredValues[index]);
     }
   }
+}
 
-  /**
-   * Place holder
-   */
-  auto isolateForOneTimeStep() {
+//===================================================================
+
+/**
+ * Call a function with the detector phase count as a compile time
+ * constant, so that each phase count gets its own detector.  Add
+ * any other phase counts that are wanted here.
+ *
+ * @param phases number of detector phases
+ * @param function called with a std::integral_constant holding the
+ *                 phase count
+ * @return whatever the function returns
+ */
+template <typename Function>
+static auto withPhases(size_t phases, Function&& function) {
+  switch (phases) {
+  case 4:
+    return function(integral_constant<size_t, 4>{});
+  case 8:
+    return function(integral_constant<size_t, 8>{});
+  case 16:
+    return function(integral_constant<size_t, 16>{});
+  default:
+    cout << "The detector can have 4, 8 or 16 phases, not "
+	 << phases << endl;
+    exit(EXIT_FAILURE);
   }
+}
+
+/**
+ * A detector type, passed to the functions that withDetector calls
+ */
+template <typename Detector>
+struct DetectorType {
+  using type = Detector;
 };
 
+/**
+ * Call a function with the type of detector to simulate: the polled
+ * or the event driven model of the logic, with the right number of
+ * phases, and with the circuit values given at run time or built in.
+ *
+ * @param phases number of detector phases
+ * @param eventDriven true to simulate the logic by events
+ * @param fixedCircuit true for the ZetaSDR circuit built in
+ * @param function called with a DetectorType for the detector
+ * @return whatever the function returns
+ */
+template <typename Function>
+static auto withDetector(size_t phases, bool eventDriven, bool fixedCircuit,
+			 Function&& function) {
+  using Fixed = FixedCircuit<ZetaSdrDesign>;
+  return withPhases(phases, [&](auto n) {
+      constexpr auto phaseCount = decltype(n)::value;
+      if (eventDriven && fixedCircuit) {
+	return function(DetectorType<EventTayloeDetector<phaseCount,
+							 Fixed>>{});
+      }
+      if (eventDriven) {
+	return function(DetectorType<EventTayloeDetector<phaseCount>>{});
+      }
+      if (fixedCircuit) {
+	return function(DetectorType<TayloeDetector<phaseCount, Fixed>>{});
+      }
+      return function(DetectorType<TayloeDetector<phaseCount>>{});
+    });
+}
+
 //===================================================================
 
 /**
@@ -229,7 +345,127 @@ public:
  *
  * @param circuit circit characteristics
  */
-ZetaSdr::ZetaSdr(const Circuit& circuit) : circuit{circuit} {}
+ZetaSdr::ZetaSdr(const Circuit& circuit) : circuit{circuit},
+					   pipelined{false},
+					   phases{ZETASDR_PHASES},
+					   chunks{1},
+					   chunkOverlapSeconds{0},
+					   checkChunks{false},
+					   fixedCircuit{false} {}
+
+/**
+ * Simulate the active filters after IC2A and IC2B from now on, adding
+ * their outputs to the results.
+ *
+ * @param filter filter component values
+ */
+auto ZetaSdr::setOpAmpFilter(const OpAmpFilter& filter) -> void {
+  opAmpFilter = filter;
+}
+
+/**
+ * Stop simulating the active filters
+ */
+auto ZetaSdr::clearOpAmpFilter() -> void {
+  opAmpFilter.reset();
+}
+
+/**
+ * Choose between running all of the simulation in the calling
+ * thread, and running the signal synthesis, the detector and the
+ * filters in threads of their own.  Both give identical results.
+ *
+ * @param enable true to run the stages in their own threads
+ */
+auto ZetaSdr::setPipelined(bool enable) -> void {
+  pipelined = enable;
+}
+
+/**
+ * Split each run into chunks of time that are simulated at the same
+ * time in threads of their own.  Each chunk starts early by the
+ * overlap, so that the detector and filters have settled by the time
+ * its results start.  The results differ slightly from the sequential
+ * run around the joins.
+ *
+ * @param count number of chunks, 1 to run sequentially
+ * @param overlapSeconds time each chunk is given to settle
+ * @param check also run sequentially, and report the differences
+ */
+auto ZetaSdr::setChunks(size_t count,
+			floating overlapSeconds,
+			bool check) -> void {
+  chunks = max(size_t{1}, count);
+  chunkOverlapSeconds = overlapSeconds;
+  checkChunks = check;
+}
+
+/**
+ * Simulate a Tayloe detector with a different number of phases from
+ * the ZetaSDR's four.  The C2 to C5 columns are then the capacitors
+ * at 0, 180, 90 and 270 degrees, and IC2A and IC2B are the weighted
+ * inphase and quadrature sums of all the capacitors.
+ *
+ * @param count number of phases, 4, 8 or 16
+ */
+auto ZetaSdr::setPhases(size_t count) -> void {
+  withPhases(count, [](auto) {});
+  phases = count;
+}
+
+/**
+ * Use the detector with the ZetaSDR's circuit values built in as
+ * compile time constants, rather than the one that takes them at run
+ * time.  The circuit has to be the ZetaSDR's, and the results are the
+ * same either way.
+ *
+ * @param fixed true to use the built in circuit
+ */
+auto ZetaSdr::setFixedCircuit(bool fixed) -> void {
+  if (fixed && !FixedCircuit<ZetaSdrDesign>::matches(circuit)) {
+    cout << "The circuit is not the ZetaSDR's, so it can't be built in"
+	 << endl;
+    exit(EXIT_FAILURE);
+  }
+  fixedCircuit = fixed;
+}
+
+/**
+ * Simulate the flip flops and the multiplexer by events, with
+ * propagation delays, instead of working out the logic levels afresh
+ * at every time step.
+ *
+ * @param timing propagation delays
+ */
+auto ZetaSdr::setLogicTiming(const LogicTiming& timing) -> void {
+  logicTiming = timing;
+}
+
+/**
+ * Go back to working out the logic levels at every time step
+ */
+auto ZetaSdr::clearLogicTiming() -> void {
+  logicTiming.reset();
+}
+
+/**
+ * Make the detector for a run
+ *
+ * @param carrierFreqHz carrier frequency
+ * @param phaseOffset local oscillator phase offset in time steps
+ * @return the detector
+ */
+template <typename Detector>
+auto ZetaSdr::makeDetector(floating carrierFreqHz,
+			   floating phaseOffset) const -> Detector {
+  const auto frequencyHz = Detector::PHASES * carrierFreqHz;
+  if constexpr (Detector::EVENT_DRIVEN) {
+    return Detector{circuit, frequencyHz, phaseOffset, *logicTiming};
+  }
+  else {
+    return Detector{circuit, frequencyHz, phaseOffset};
+  }
+}
 
 /**
  * This simulates the Tayloe quadrature product detector.  It outputs
@@ -247,94 +483,221 @@ auto ZetaSdr::run(const string& outputFilename,
 		  size_t cycleCount,
 		  const Signal& signal,
 		  floating phaseAngleDeg) -> void {
+  writeResults(outputFilename,
+	       describe(cycleCount, signal, phaseAngleDeg),
+	       [&](OutputSink& file) {
+		 run(file, cycleCount, signal, phaseAngleDeg);
+	       });
+}
+
+/**
+ * Describe a run exactly, for the result cache.  Whether or not it is
+ * pipelined makes no difference to the results, so it isn't included.
+ *
+ * @param cycleCount number of carrier cycles to simulate
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ * @return description
+ */
+auto ZetaSdr::describe(size_t cycleCount,
+		       const Signal& signal,
+		       floating phaseAngleDeg) const -> string {
+  auto stream = ostringstream{};
+  stream << hexfloat
+	 << "zetasdr " << cycleCount << " " << phaseAngleDeg << "\n"
+	 << "circuit " << circuit.resistance
+	 << " " << circuit.capacitance
+	 << " " << circuit.lpFreqHz << "\n";
+  if (phases != ZETASDR_PHASES) {
+    stream << "phases " << phases << "\n";
+  }
+  if (chunks > 1) {
+    stream << "chunks " << chunks << " " << chunkOverlapSeconds << "\n";
+  }
+  else if (pipelined && canStreamCapture()) {
+    stream << "streamed\n";
+  }
+  if (logicTiming) {
+    stream << "logic " << logicTiming->flipFlopDelay
+	   << " " << logicTiming->switchOnDelay
+	   << " " << logicTiming->switchOffDelay << "\n";
+  }
+  if (opAmpFilter) {
+    stream << "opamp " << opAmpFilter->inputResistance
+	   << " " << opAmpFilter->feedbackResistance
+	   << " " << opAmpFilter->feedbackCapacitance
+	   << " " << opAmpFilter->couplingCapacitance
+	   << " " << opAmpFilter->loadResistance << "\n";
+  }
+  stream << describeOptions() << signal.describe();
+  return stream.str();
+}
+
+/**
+ * This simulates the Tayloe quadrature product detector, passing the
+ * results to an output sink rather than a file.
+ *
+ * @param output where the results go
+ * @param cycleCount number of carrier cycles to simulate
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ */
+auto ZetaSdr::run(OutputSink& output,
+		  size_t cycleCount,
+		  const Signal& signal,
+		  floating phaseAngleDeg) -> void {
+  auto trace = TraceScope{"ZetaSdr::run"};
 
   reset();
-  cout << "Writing " << outputFilename << endl;
 
   const auto headings = "timestep, time, signal, modulation, C2, "
     "C3, C4, C5, IC2A, IC2B, "
-    "filteredInphase, filteredQuadrature, demodulated";
-
-  constexpr auto INDEX_SIGNAL = size_t{0};
-  constexpr auto INDEX_MODULATION = size_t{1};
-  constexpr auto INDEX_CAPC2_VOLTAGE = size_t{2};
-  constexpr auto INDEX_CAPC3_VOLTAGE = size_t{3};
-  constexpr auto INDEX_CAPC4_VOLTAGE = size_t{4};
-  constexpr auto INDEX_CAPC5_VOLTAGE = size_t{5};
-  constexpr auto INDEX_DIFFERENCE_IC2A = size_t{6};
-  constexpr auto INDEX_DIFFERENCE_IC2B = size_t{7};
-  constexpr auto INDEX_FILTERED_INPHASE = size_t{8};
-  constexpr auto INDEX_FILTERED_QUADRATURE = size_t{9};
-  constexpr auto INDEX_DEMODULATED = size_t{10};
+    "filteredInphase, filteredQuadrature, demodulated"s +
+    (opAmpFilter ? ", opampInphase, opampQuadrature" : "") + adcHeadings();
+
+  const auto opAmpColumnCount = size_t{opAmpFilter ? 2u : 0u};
+  const auto fieldCount = INDEX_DEMODULATED + 1 + opAmpColumnCount +
+    adcColumnCount();
   
   auto timeStepsPerCarrierCycle = signal.getTimeStepsPerCarrierCycle(0);
 
   cycleCount += EXTRA_CYCLES;
 
-  auto capC2 = SeriesRC{circuit};
-  auto capC3 = SeriesRC{circuit};
-  auto capC4 = SeriesRC{circuit};
-  auto capC5 = SeriesRC{circuit};
-  const auto capacitor = array<SeriesRC*, 4 >{&capC2, &capC4, &capC5, &capC3};
+  // Whole number of time steps in each carrier cycle
+  auto timeStepsPerCycle = size_t{0};
+  for (auto timeStep = decltype(timeStepsPerCarrierCycle){1};
+       timeStep <= timeStepsPerCarrierCycle; timeStep++) {
+    timeStepsPerCycle++;
+  }
 
   // phaseOffset is the fraction of a carrier cycle that the local
   // oscillator starts at. The carrier is ahead of the local
   // oscillator
   auto phaseOffset = timeStepsPerCarrierCycle * phaseAngleDeg / 360.;
-  auto johnsonCounter = JohnsonCounter{};
-  auto localOscillator = LocalOscillator{4 * signal.getCarrierFreqHz(0),
-					 phaseOffset,
-					 johnsonCounter};
-    
-  auto totalTimeSteps = size_t{0};
-
-  for (auto cycles = decltype(cycleCount){0}; cycles < cycleCount; cycles++) {
-    for (auto timeStep = decltype(timeStepsPerCarrierCycle){1};
-	 timeStep <= timeStepsPerCarrierCycle; timeStep++) {
-	
-      totalTimeSteps++;
-
-      localOscillator.step();
-      // Modulation
-      auto amplitude = signal.getAmplitude(0, totalTimeSteps);
-      // Modulated signal
-      auto signalVoltage = signal.getTotalSignal(totalTimeSteps);
 
-      // Add 2.5 volts (Vcc/2) bias
-      signalVoltage += 2.5;
-	
-      // Johnson counter (IC1A and IC1B) selects which capacitor gets
-      // connected to the RF signal.  The other capacitors are
-      // electrically isolated during the time step and so do not
-      // change their state at all (they are assumed to have no
-      // leakage resistance)
-      auto enabledChannel = johnsonCounter.get();
-      for (auto index = decltype(johnsonCounter.stateCount()){0};
-	   index < johnsonCounter.stateCount();
-	   index++) {
-	auto* cap = capacitor.at(index);
-	if (index == enabledChannel) {
-	  cap->applyVoltageForOneTimeStep(signalVoltage);
-	}
-	else {
-	  cap->isolateForOneTimeStep();
+  startTelemetry(headings, cycleCount * timeStepsPerCycle);
+
+  // The pipeline can stream its lines through a triggered capture
+  auto demodulator = optional<RunningDemodulator>{};
+  if (pipelined && chunks <= 1 &&
+      streamCapture(headings, timeStepsPerCarrierCycle)) {
+    demodulator.emplace(cycleCount * timeStepsPerCycle);
+  }
+
+  withDetector(phases, logicTiming.has_value(), fixedCircuit,
+	       [&](auto type) {
+      using Detector = typename decltype(type)::type;
+      auto trace = TraceScope{"simulate"};
+      if (chunks > 1) {
+	simulateChunked<Detector>(cycleCount * timeStepsPerCycle, signal,
+				  phaseOffset, fieldCount);
+	if (checkChunks) {
+	  auto chunked = move(results);
+	  results.clear();
+	  simulate<Detector>(cycleCount * timeStepsPerCycle, signal,
+			     phaseOffset, fieldCount);
+	  reportChunkErrors(chunked, headings);
+	  results = move(chunked);
 	}
       }
+      else if (pipelined) {
+	simulatePipelined<Detector>(cycleCount * timeStepsPerCycle, signal,
+				    phaseOffset, fieldCount,
+				    demodulator ? &*demodulator : nullptr);
+      }
+      else {
+	simulate<Detector>(cycleCount * timeStepsPerCycle, signal,
+			   phaseOffset, fieldCount);
+      }
+    });
+
+  if (demodulator) {
+    demodulator->apply(results, INDEX_FILTERED_INPHASE,
+		       INDEX_FILTERED_QUADRATURE, INDEX_DEMODULATED);
+  }
+  else {
+    amDemod(INDEX_FILTERED_INPHASE,
+	    INDEX_FILTERED_QUADRATURE,
+	    INDEX_DEMODULATED);
+  }
 
-      auto dataLine = unique_ptr<DataLine>{new DataLine(INDEX_DEMODULATED + 1,
-							totalTimeSteps)};
-      dataLine->fields.at(INDEX_SIGNAL) = signalVoltage;
-      dataLine->fields.at(INDEX_MODULATION) = amplitude;
-      dataLine->fields.at(INDEX_CAPC2_VOLTAGE) = capC2.getVoltage();
-      dataLine->fields.at(INDEX_CAPC3_VOLTAGE) = capC3.getVoltage();
-      dataLine->fields.at(INDEX_CAPC4_VOLTAGE) = capC4.getVoltage();
-      dataLine->fields.at(INDEX_CAPC5_VOLTAGE) = capC5.getVoltage();
-      dataLine->fields.at(INDEX_DIFFERENCE_IC2A) =
-	capC2.getVoltage() - capC3.getVoltage();
-      dataLine->fields.at(INDEX_DIFFERENCE_IC2B) =
-	capC4.getVoltage() - capC5.getVoltage();
-      add(dataLine);
+  // The sound card digitises the active filter outputs if there are
+  // any, otherwise the IC2A and IC2B inputs
+  if (adc && opAmpFilter) {
+    adcBaseband(INDEX_OPAMP_INPHASE, INDEX_OPAMP_QUADRATURE,
+		INDEX_DEMODULATED + 1 + opAmpColumnCount);
+  }
+  else if (adc) {
+    adcBaseband(INDEX_DIFFERENCE_IC2A, INDEX_DIFFERENCE_IC2B,
+		INDEX_DEMODULATED + 1);
+  }
+
+  outputData(output, headings, timeStepsPerCarrierCycle);
+}
+
+/**
+ * Run the detector, and the filters after it, in the calling thread.
+ *
+ * @param timeSteps number of time steps to simulate
+ * @param signal signal characteristics
+ * @param phaseOffset local oscillator phase offset in time steps
+ * @param fieldCount number of entries in each DataLine
+ */
+template <typename Detector>
+auto ZetaSdr::simulate(size_t timeSteps,
+		       const Signal& signal,
+		       floating phaseOffset,
+		       size_t fieldCount) -> void {
+
+  auto detector = makeDetector<Detector>(signal.getCarrierFreqHz(0),
+					 phaseOffset);
+
+  // The active filters after IC2A and IC2B, if they are simulated
+  auto opAmps = optional<StateSpace>{};
+  if (opAmpFilter) {
+    opAmps.emplace(opAmpFilter->makeStateSpace(TIME_STEP_SIZE));
+  }
+  auto opAmpInput = vector<floating>(2);
+
+  auto synthesiser = Synthesiser{signal, getWaveform(signal, timeSteps),
+				 noise};
+  auto block = PipelineBlock{};
+
+  for (auto timeStep = size_t{1}; timeStep <= timeSteps; timeStep++) {
+    // Modulated signal, a block at a time
+    const auto index = (timeStep - 1) % PIPELINE_BLOCK_SIZE;
+    if (index == 0) {
+      block.firstTimeStep = timeStep;
+      block.count = min(PIPELINE_BLOCK_SIZE, timeSteps - timeStep + 1);
+      synthesiser.fill(block);
+    }
+    const auto signalVoltage = block.signal[index];
+    const auto amplitude = block.modulation[index];
+
+    detector.step(signalVoltage, block.jitter[index]);
+
+    auto dataLine = unique_ptr<DataLine>{new DataLine(fieldCount, timeStep)};
+    dataLine->fields.at(INDEX_SIGNAL) = signalVoltage;
+    dataLine->fields.at(INDEX_MODULATION) = amplitude;
+    dataLine->fields.at(INDEX_CAPC2_VOLTAGE) = detector.getC2();
+    dataLine->fields.at(INDEX_CAPC3_VOLTAGE) = detector.getC3();
+    dataLine->fields.at(INDEX_CAPC4_VOLTAGE) = detector.getC4();
+    dataLine->fields.at(INDEX_CAPC5_VOLTAGE) = detector.getC5();
+    dataLine->fields.at(INDEX_DIFFERENCE_IC2A) = detector.getInphase();
+    dataLine->fields.at(INDEX_DIFFERENCE_IC2B) = detector.getQuadrature();
+
+    if (opAmps) {
+      opAmpInput.at(0) = dataLine->fields.at(INDEX_DIFFERENCE_IC2A);
+      opAmpInput.at(1) = dataLine->fields.at(INDEX_DIFFERENCE_IC2B);
+      opAmps->step(opAmpInput);
+      auto opAmpOutput = opAmps->output(opAmpInput);
+      dataLine->fields.at(INDEX_OPAMP_INPHASE) = opAmpOutput.at(0);
+      dataLine->fields.at(INDEX_OPAMP_QUADRATURE) = opAmpOutput.at(1);
     }
+    publish(*dataLine);
+    add(dataLine);
   }
 
   butterworth(INDEX_DIFFERENCE_IC2A, INDEX_FILTERED_INPHASE,
@@ -342,11 +705,420 @@ auto ZetaSdr::run(const string& outputFilename,
 
   butterworth(INDEX_DIFFERENCE_IC2B, INDEX_FILTERED_QUADRATURE,
 	      2, circuit.lpFreqHz, false);
-  
-  amDemod(INDEX_FILTERED_INPHASE,
-	  INDEX_FILTERED_QUADRATURE,
-	  INDEX_DEMODULATED);
+}
+
+/**
+ * Run the detector, and the filters after it, as a pipeline.  The
+ * signal synthesis, the detector and the low pass filters each have
+ * a thread, and the calling thread collects the results.  Blocks of
+ * time steps go between the threads through bounded queues, so a
+ * slow stage holds back the ones in front of it.  Each stage does the
+ * same arithmetic in the same order as simulate(), so the results
+ * are identical.  When the run is streamed through a triggered
+ * capture, the calling thread only keeps the captured lines, and the
+ * demodulator takes in every time step instead.
+ *
+ * @param timeSteps number of time steps to simulate
+ * @param signal signal characteristics
+ * @param phaseOffset local oscillator phase offset in time steps
+ * @param fieldCount number of entries in each DataLine
+ * @param demodulator works out the demodulated column if the run is
+ *                    streamed, otherwise null
+ */
+template <typename Detector>
+auto ZetaSdr::simulatePipelined(size_t timeSteps,
+				const Signal& signal,
+				floating phaseOffset,
+				size_t fieldCount,
+				RunningDemodulator* demodulator) -> void {
+  auto synthesised = PipelineQueue{PIPELINE_QUEUE_LENGTH};
+  auto detected = PipelineQueue{PIPELINE_QUEUE_LENGTH};
+  auto filtered = PipelineQueue{PIPELINE_QUEUE_LENGTH};
+
+  // Signal synthesis
+  auto synthesis = thread{[&]() {
+      Trace::nameThread("synthesis");
+      auto synthesiser = Synthesiser{signal, getWaveform(signal, timeSteps),
+				 noise};
+      for (auto first = size_t{1}; first <= timeSteps;
+	   first += PIPELINE_BLOCK_SIZE) {
+	auto block = make_unique<PipelineBlock>();
+	block->firstTimeStep = first;
+	block->count = min(PIPELINE_BLOCK_SIZE, timeSteps - first + 1);
+	synthesiser.fill(*block);
+	synthesised.push(move(block));
+      }
+      synthesised.push(nullptr);
+    }};
+
+  // Local oscillator, Johnson counter, detector capacitors and the
+  // active filters after them
+  auto detection = thread{[&]() {
+      Trace::nameThread("detection");
+      auto detector = makeDetector<Detector>(signal.getCarrierFreqHz(0),
+					     phaseOffset);
+      auto opAmps = optional<StateSpace>{};
+      if (opAmpFilter) {
+	opAmps.emplace(opAmpFilter->makeStateSpace(TIME_STEP_SIZE));
+      }
+
+      while (auto block = synthesised.pop()) {
+	detectBlock(detector, opAmps, *block);
+	detected.push(move(block));
+      }
+      detected.push(nullptr);
+    }};
+
+  // Low pass filters
+  auto filtering = thread{[&]() {
+      Trace::nameThread("filtering");
+      auto inphaseFilter = Butterworth{2, circuit.lpFreqHz, false};
+      auto quadratureFilter = Butterworth{2, circuit.lpFreqHz, false};
+
+      while (auto block = detected.pop()) {
+	filterBlock(*block, inphaseFilter, quadratureFilter, circuit.lpFreqHz);
+	filtered.push(move(block));
+      }
+      filtered.push(nullptr);
+    }};
+
+  // Collect the results in this thread
+  while (auto block = filtered.pop()) {
+    for (auto index = size_t{0}; index < block->count; index++) {
+      auto dataLine = makeDataLine(*block, index, fieldCount);
+      publish(*dataLine);
+      if (demodulator) {
+	demodulator->add(dataLine->timeStep, block->filteredInphase[index],
+			 block->filteredQuadrature[index]);
+      }
+      keep(dataLine);
+    }
+  }
+
+  synthesis.join();
+  detection.join();
+  filtering.join();
+}
+
+/**
+ * Make the results line for one time step of a block that has been
+ * through the whole pipeline
+ *
+ * @param block the block
+ * @param index time step within the block
+ * @param fieldCount number of entries in each DataLine
+ * @return the line
+ */
+auto ZetaSdr::makeDataLine(const PipelineBlock& block,
+			   size_t index,
+			   size_t fieldCount) const -> unique_ptr<DataLine> {
+  auto dataLine = unique_ptr<DataLine>{
+    new DataLine(fieldCount, block.firstTimeStep + index)};
+  auto& fields = dataLine->fields;
+  fields.at(INDEX_SIGNAL) = block.signal[index];
+  fields.at(INDEX_MODULATION) = block.modulation[index];
+  fields.at(INDEX_CAPC2_VOLTAGE) = block.c2[index];
+  fields.at(INDEX_CAPC3_VOLTAGE) = block.c3[index];
+  fields.at(INDEX_CAPC4_VOLTAGE) = block.c4[index];
+  fields.at(INDEX_CAPC5_VOLTAGE) = block.c5[index];
+  fields.at(INDEX_DIFFERENCE_IC2A) = block.inphase[index];
+  fields.at(INDEX_DIFFERENCE_IC2B) = block.quadrature[index];
+  fields.at(INDEX_FILTERED_INPHASE) = block.filteredInphase[index];
+  fields.at(INDEX_FILTERED_QUADRATURE) = block.filteredQuadrature[index];
+  if (opAmpFilter) {
+    fields.at(INDEX_OPAMP_INPHASE) = block.opAmpInphase[index];
+    fields.at(INDEX_OPAMP_QUADRATURE) = block.opAmpQuadrature[index];
+  }
+  return dataLine;
+}
+
+//===================================================================
+
+/**
+ * Run the detector and the filters after it as several chunks of
+ * time, one thread each.  The detector capacitors and the low pass
+ * filters forget where they started in a few time constants, so each
+ * chunk starts the overlap earlier than its first time step, with the
+ * local oscillator and Johnson counter where they would be by then
+ * and the capacitors charged to the signal's bias, and throws away
+ * what it works out before its first time step.  The active filters'
+ * coupling capacitors take far longer than that to settle, so they
+ * start discharged at the first time step instead, and
+ * carryOpAmpState adds on the charge from the earlier chunks.  The
+ * chunks report their progress as they go, and are joined up in
+ * order, publishing their samples, once they have all finished.
+ *
+ * @param timeSteps number of time steps to simulate
+ * @param signal signal characteristics
+ * @param phaseOffset local oscillator phase offset in time steps
+ * @param fieldCount number of entries in each DataLine
+ */
+template <typename Detector>
+auto ZetaSdr::simulateChunked(size_t timeSteps,
+			      const Signal& signal,
+			      floating phaseOffset,
+			      size_t fieldCount) -> void {
+  if constexpr (Detector::EVENT_DRIVEN) {
+    cout << "Chunked runs can't simulate the logic by events" << endl;
+    exit(EXIT_FAILURE);
+  }
+  else {
+    const auto overlap = static_cast<size_t>(chunkOverlapSeconds /
+					     TIME_STEP_SIZE);
+    const auto chunkLength = (timeSteps + chunks - 1) / chunks;
+    const auto waveform = getWaveform(signal, timeSteps);
+    auto chunkLines = vector<list<unique_ptr<DataLine>>>(chunks);
+    auto opAmpStates = vector<vector<floating>>(chunks);
+    auto timeStepsDone = atomic<size_t>{0};
+
+    auto threads = vector<thread>{};
+    for (auto chunk = size_t{0}; chunk < chunks; chunk++) {
+      const auto first = 1 + chunk * chunkLength;
+      const auto last = min(timeSteps, first + chunkLength - 1);
+      if (first > last) {
+	break;
+      }
+      threads.emplace_back([&, chunk, first, last]() {
+	  Trace::nameThread("chunk " + to_string(chunk + 1));
+	  auto trace = TraceScope{"chunk"};
+	  const auto start = first > overlap ? first - overlap : 1;
+	  auto detector = Detector{circuit,
+				   Detector::PHASES * signal.getCarrierFreqHz(0),
+				   phaseOffset,
+				   start - 1};
+	  auto opAmps = optional<StateSpace>{};
+	  if (opAmpFilter) {
+	    opAmps.emplace(opAmpFilter->makeStateSpace(TIME_STEP_SIZE));
+	  }
+	  auto noOpAmps = optional<StateSpace>{};
+	  auto inphaseFilter = Butterworth{2, circuit.lpFreqHz, false};
+	  auto quadratureFilter = Butterworth{2, circuit.lpFreqHz, false};
+	  auto synthesiser = Synthesiser{signal, waveform, noise};
+	  auto block = PipelineBlock{};
+
+	  for (auto blockFirst = start; blockFirst <= last;
+	       blockFirst += PIPELINE_BLOCK_SIZE) {
+	    block.firstTimeStep = blockFirst;
+	    block.count = min(PIPELINE_BLOCK_SIZE, last - blockFirst + 1);
+	    synthesiser.fill(block);
+	    if (blockFirst == start && start > 1) {
+	      detector.preset(block.signal.front());
+	    }
+	    detectBlock(detector, noOpAmps, block);
+	    if (opAmps) {
+	      opAmpBlock(*opAmps, block,
+			 min(block.count,
+			     first > blockFirst ? first - blockFirst : 0));
+	    }
+	    filterBlock(block, inphaseFilter, quadratureFilter,
+			circuit.lpFreqHz);
+	    auto kept = size_t{0};
+	    for (auto index = size_t{0}; index < block.count; index++) {
+	      if (blockFirst + index >= first) {
+		chunkLines[chunk].push_back(makeDataLine(block, index,
+							 fieldCount));
+		kept++;
+	      }
+	    }
+	    if (telemetry) {
+	      telemetry->progress(timeStepsDone.fetch_add(kept) + kept);
+	    }
+	  }
+	  if (opAmps) {
+	    opAmpStates[chunk] = opAmps->getState();
+	  }
+	});
+    }
+    for (auto&& thread : threads) {
+      thread.join();
+    }
+
+    if (opAmpFilter) {
+      carryOpAmpState(chunkLines, opAmpStates);
+    }
 
-  outputData(outputFilename, headings, timeStepsPerCarrierCycle);
+    for (auto&& lines : chunkLines) {
+      for (auto&& dataLine : lines) {
+	publish(*dataLine);
+	add(dataLine);
+      }
+    }
+  }
+}
+
+/**
+ * Add the active filters' response to the charge carried over from
+ * the earlier chunks to each chunk's op-amp outputs.  Each chunk ran
+ * them from discharged, and they are linear, so the state at the
+ * start of a chunk is the previous chunk's starting state carried
+ * through its length with no input, plus its final state.  Carrying
+ * a state through a whole chunk takes one matrix power per bit of
+ * its length, so the starting states are worked out in order and the
+ * chunks are then corrected in parallel.
+ *
+ * @param chunkLines each chunk's results
+ * @param endStates the active filters' state at the end of each
+ *                  chunk, when started discharged
+ */
+auto ZetaSdr::carryOpAmpState(
+  vector<list<unique_ptr<DataLine>>>& chunkLines,
+  const vector<vector<floating>>& endStates) const -> void {
+  auto trace = TraceScope{"carryOpAmpState"};
+  const auto noInput = vector<floating>(2, 0);
+  auto opAmps = opAmpFilter->makeStateSpace(TIME_STEP_SIZE);
+  auto startStates = vector<vector<floating>>{opAmps.getState()};
+  for (auto chunk = size_t{1}; chunk < chunkLines.size(); chunk++) {
+    opAmps.setState(startStates.back());
+    opAmps.advance(noInput, chunkLines[chunk - 1].size());
+    auto state = opAmps.getState();
+    const auto& endState = endStates[chunk - 1];
+    for (auto index = size_t{0}; index < endState.size(); index++) {
+      state[index] += endState[index];
+    }
+    startStates.push_back(state);
+  }
+
+  auto threads = vector<thread>{};
+  for (auto chunk = size_t{1}; chunk < chunkLines.size(); chunk++) {
+    threads.emplace_back([&, chunk]() {
+	auto response = opAmpFilter->makeStateSpace(TIME_STEP_SIZE);
+	response.setState(startStates[chunk]);
+	for (auto&& dataLine : chunkLines[chunk]) {
+	  response.step(noInput);
+	  const auto output = response.output(noInput);
+	  dataLine->fields.at(INDEX_OPAMP_INPHASE) += output.at(0);
+	  dataLine->fields.at(INDEX_OPAMP_QUADRATURE) += output.at(1);
+	}
+      });
+  }
+  for (auto&& thread : threads) {
+    thread.join();
+  }
 }
 
+/**
+ * Compare the results of a chunked run with the sequential run, and
+ * report the largest difference in each column, and where it is
+ *
+ * @param chunked results of the chunked run
+ * @param headings column headings
+ */
+auto ZetaSdr::reportChunkErrors(const list<unique_ptr<DataLine>>& chunked,
+				const string& headings) const -> void {
+  const auto names = splitHeadings(headings);
+  const auto chunkLength = (results.size() + chunks - 1) / chunks;
+  const auto fieldCount = results.front()->fields.size();
+  auto largest = vector<floating>(fieldCount);
+  auto where = vector<size_t>(fieldCount);
+  auto lowest = vector<floating>(fieldCount, INFINITY);
+  auto highest = vector<floating>(fieldCount, -INFINITY);
+
+  auto line = chunked.begin();
+  for (auto&& reference : results) {
+    for (auto field = size_t{0}; field < fieldCount; field++) {
+      const auto value = reference->fields[field];
+      const auto error = fabs((*line)->fields[field] - value);
+      if (error > largest[field]) {
+	largest[field] = error;
+	where[field] = reference->timeStep;
+      }
+      lowest[field] = min(lowest[field], value);
+      highest[field] = max(highest[field], value);
+    }
+    ++line;
+  }
+
+  cout << "Largest differences from the sequential run, with seams every "
+       << chunkLength << " time steps:" << endl;
+  for (auto field = size_t{0}; field < fieldCount; field++) {
+    const auto range = highest[field] - lowest[field];
+    if (field + 2 >= names.size() || range == 0) {
+      continue;
+    }
+    cout << "  " << names[field + 2] << " " << largest[field]
+	 << " (" << largest[field] / range << " of its range)";
+    if (largest[field] > 0) {
+      cout << " at time step " << where[field];
+    }
+    cout << endl;
+  }
+}
+
+//===================================================================
+
+/**
+ * Run the detector and the low pass filters for a measurement,
+ * passing the filtered outputs to a probe a block at a time until it
+ * has seen enough.  Nothing is kept, so a measurement can run for as
+ * long as it needs to.
+ *
+ * @param probe gets the filtered outputs, and says when to stop
+ * @param maxTimeSteps stop after this many time steps anyway
+ * @param signal signal characteristics
+ * @param phaseAngleDeg Initial phase angle of carrier compared to 
+ *                      local oscillator
+ * @return number of time steps simulated
+ */
+auto ZetaSdr::measure(BasebandProbe& probe,
+		      size_t maxTimeSteps,
+		      const Signal& signal,
+		      floating phaseAngleDeg) -> size_t {
+  auto timeStepsPerCarrierCycle = signal.getTimeStepsPerCarrierCycle(0);
+  auto phaseOffset = timeStepsPerCarrierCycle * phaseAngleDeg / 360.;
+
+  return withDetector(phases, logicTiming.has_value(), fixedCircuit,
+		      [&](auto type) {
+      using Detector = typename decltype(type)::type;
+      return measureWith<Detector>(probe, maxTimeSteps, signal, phaseOffset);
+    });
+}
+
+/**
+ * Run the measurement with one type of detector
+ *
+ * @param probe gets the filtered outputs, and says when to stop
+ * @param maxTimeSteps stop after this many time steps anyway
+ * @param signal signal characteristics
+ * @param phaseOffset local oscillator phase offset in time steps
+ * @return number of time steps simulated
+ */
+template <typename Detector>
+auto ZetaSdr::measureWith(BasebandProbe& probe,
+			  size_t maxTimeSteps,
+			  const Signal& signal,
+			  floating phaseOffset) -> size_t {
+  auto detector = makeDetector<Detector>(signal.getCarrierFreqHz(0),
+					 phaseOffset);
+  auto inphaseFilter = Butterworth{2, circuit.lpFreqHz, false};
+  auto quadratureFilter = Butterworth{2, circuit.lpFreqHz, false};
+
+  auto synthesiser = Synthesiser{signal, {}, noise};
+  auto block = PipelineBlock{};
+  auto inphase = vector<double>(PIPELINE_BLOCK_SIZE);
+  auto quadrature = vector<double>(PIPELINE_BLOCK_SIZE);
+  auto filteredInphase = vector<double>(PIPELINE_BLOCK_SIZE);
+  auto filteredQuadrature = vector<double>(PIPELINE_BLOCK_SIZE);
+
+  for (auto first = size_t{1}; first <= maxTimeSteps;
+       first += PIPELINE_BLOCK_SIZE) {
+    block.firstTimeStep = first;
+    block.count = min(PIPELINE_BLOCK_SIZE, maxTimeSteps - first + 1);
+    synthesiser.fill(block);
+
+    for (auto index = size_t{0}; index < block.count; index++) {
+      detector.step(block.signal[index], block.jitter[index]);
+      inphase[index] = static_cast<double>(detector.getInphase());
+      quadrature[index] = static_cast<double>(detector.getQuadrature());
+    }
+
+    inphaseFilter.apply(inphase.data(), filteredInphase.data(), block.count);
+    quadratureFilter.apply(quadrature.data(), filteredQuadrature.data(),
+			   block.count);
+
+    if (!probe.observe(first, block.count, filteredInphase.data(),
+		       filteredQuadrature.data())) {
+      return first + block.count - 1;
+    }
+  }
+  return maxTimeSteps;
+}
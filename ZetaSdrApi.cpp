@@ -0,0 +1,310 @@
+/**
+ * C interface to the simulation, built into libzetasdr.so
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include "Butterworth.h"
+#include "Mixer.h"
+#include "Output.h"
+#include "Signal.h"
+#include "zetasdr_api.h"
+
+using namespace std;
+
+// The handles are just the C++ objects under a C name
+struct zsdr_circuit {
+  Circuit circuit;
+};
+
+struct zsdr_signal {
+  Signal signal;
+};
+
+struct zsdr_result {
+  ColumnSink columns;
+};
+
+// Description of the last failure in this thread
+static thread_local string lastError;
+
+//===================================================================
+
+/**
+ * Get the version of the interface, so that callers can check that
+ * the library is new enough.
+ *
+ * @return ZSDR_API_VERSION
+ */
+int zsdr_api_version(void) {
+  return ZSDR_API_VERSION;
+}
+
+/**
+ * Get a description of the last failure in the calling thread
+ *
+ * @return error message, empty if there hasn't been one
+ */
+const char* zsdr_last_error(void) {
+  return lastError.c_str();
+}
+
+//===================================================================
+
+/**
+ * Create a circuit description
+ *
+ * @param resistance resistance in series with the detector capacitors
+ * @param capacitance detector capacitor value
+ * @param lpFreqHz low pass filter cutoff frequency, 0 to disable
+ * @return circuit handle, NULL on failure
+ */
+zsdr_circuit* zsdr_circuit_create(double resistance,
+				  double capacitance,
+				  double lpFreqHz) {
+  try {
+    if (!(resistance > 0 && capacitance > 0) ||
+	!isfinite(resistance) || !isfinite(capacitance)) {
+      throw invalid_argument{"The circuit values must be positive"};
+    }
+    checkCutoff(lpFreqHz);
+    return new zsdr_circuit{Circuit{resistance, capacitance, lpFreqHz}};
+  }
+  catch (const exception& e) {
+    lastError = e.what();
+    return nullptr;
+  }
+}
+
+/**
+ * Free a circuit description
+ *
+ * @param circuit circuit handle, may be NULL
+ */
+void zsdr_circuit_destroy(zsdr_circuit* circuit) {
+  delete circuit;
+}
+
+//===================================================================
+
+/**
+ * Create a signal containing one carrier
+ *
+ * @param carrierAmplitude carrier amplitude
+ * @param carrierFreqHz carrier frequency
+ * @param modFreqHz modulation frequency
+ * @param initialPhaseAngleDegrees phase angle of signal
+ * @return signal handle, NULL on failure
+ */
+zsdr_signal* zsdr_signal_create(double carrierAmplitude,
+				double carrierFreqHz,
+				double modFreqHz,
+				double initialPhaseAngleDegrees) {
+  try {
+    checkCarrier(carrierAmplitude,
+		 carrierFreqHz,
+		 modFreqHz,
+		 initialPhaseAngleDegrees);
+    return new zsdr_signal{Signal{carrierAmplitude,
+				  carrierFreqHz,
+				  modFreqHz,
+				  initialPhaseAngleDegrees}};
+  }
+  catch (const exception& e) {
+    lastError = e.what();
+    return nullptr;
+  }
+}
+
+/**
+ * Add another carrier to a signal
+ *
+ * @param signal signal handle
+ * @param carrierAmplitude carrier amplitude
+ * @param carrierFreqHz carrier frequency
+ * @param modFreqHz modulation frequency
+ * @param initialPhaseAngleDegrees phase angle of signal
+ * @return 0 on success, -1 on failure
+ */
+int zsdr_signal_add(zsdr_signal* signal,
+		    double carrierAmplitude,
+		    double carrierFreqHz,
+		    double modFreqHz,
+		    double initialPhaseAngleDegrees) {
+  if (signal == nullptr) {
+    lastError = "No signal";
+    return -1;
+  }
+  try {
+    checkCarrier(carrierAmplitude,
+		 carrierFreqHz,
+		 modFreqHz,
+		 initialPhaseAngleDegrees);
+    signal->signal.add(carrierAmplitude,
+		       carrierFreqHz,
+		       modFreqHz,
+		       initialPhaseAngleDegrees);
+    return 0;
+  }
+  catch (const exception& e) {
+    lastError = e.what();
+    return -1;
+  }
+}
+
+/**
+ * Free a signal
+ *
+ * @param signal signal handle, may be NULL
+ */
+void zsdr_signal_destroy(zsdr_signal* signal) {
+  delete signal;
+}
+
+//===================================================================
+
+/**
+ * Run the ZetaSDR simulation
+ *
+ * @param circuit circuit characteristics
+ * @param signal signal characteristics
+ * @param cycleCount number of carrier cycles to simulate
+ * @param phaseAngleDeg Initial phase angle of carrier compared to
+ *                      local oscillator
+ * @return result handle, NULL on failure
+ */
+zsdr_result* zsdr_run_zetasdr(const zsdr_circuit* circuit,
+			      const zsdr_signal* signal,
+			      size_t cycleCount,
+			      double phaseAngleDeg) {
+  if (circuit == nullptr || signal == nullptr) {
+    lastError = "No circuit or signal";
+    return nullptr;
+  }
+  try {
+    auto result = make_unique<zsdr_result>();
+    auto zetasdr = ZetaSdr{circuit->circuit};
+    zetasdr.run(result->columns, cycleCount, signal->signal, phaseAngleDeg);
+    return result.release();
+  }
+  catch (const exception& e) {
+    lastError = e.what();
+    return nullptr;
+  }
+}
+
+/**
+ * Run the ideal IQ mixer simulation
+ *
+ * @param lpFreqHz low pass filter cutoff frequency, 0 to disable
+ * @param signal signal characteristics
+ * @param cycleCount number of carrier cycles to simulate
+ * @param phaseAngleDeg Initial phase angle of carrier compared to
+ *                      local oscillator
+ * @return result handle, NULL on failure
+ */
+zsdr_result* zsdr_run_iqmixer(double lpFreqHz,
+			      const zsdr_signal* signal,
+			      size_t cycleCount,
+			      double phaseAngleDeg) {
+  if (signal == nullptr) {
+    lastError = "No signal";
+    return nullptr;
+  }
+  try {
+    checkCutoff(lpFreqHz);
+    auto result = make_unique<zsdr_result>();
+    auto iqmixer = IqMixer{lpFreqHz};
+    iqmixer.run(result->columns, cycleCount, signal->signal, phaseAngleDeg);
+    return result.release();
+  }
+  catch (const exception& e) {
+    lastError = e.what();
+    return nullptr;
+  }
+}
+
+//===================================================================
+
+/**
+ * Get the number of rows in each result column
+ *
+ * @param result result handle
+ * @return row count
+ */
+size_t zsdr_result_rows(const zsdr_result* result) {
+  return result ? result->columns.getRowCount() : 0;
+}
+
+/**
+ * Get the number of result columns, including time step and time
+ *
+ * @param result result handle
+ * @return column count
+ */
+size_t zsdr_result_columns(const zsdr_result* result) {
+  return result ? result->columns.getColumns().size() : 0;
+}
+
+/**
+ * Get the heading of a result column
+ *
+ * @param result result handle
+ * @param column column index
+ * @return column name, NULL if there is no such column
+ */
+const char* zsdr_result_column_name(const zsdr_result* result,
+				    size_t column) {
+  if (result == nullptr || column >= result->columns.getNames().size()) {
+    return nullptr;
+  }
+  return result->columns.getNames().at(column).c_str();
+}
+
+/**
+ * Get the values in a result column.  These are contiguous, with
+ * zsdr_result_rows() entries.
+ *
+ * @param result result handle
+ * @param column column index
+ * @return the column values, NULL if there is no such column
+ */
+const double* zsdr_result_column(const zsdr_result* result,
+				 size_t column) {
+  if (result == nullptr || column >= result->columns.getColumns().size()) {
+    return nullptr;
+  }
+  return result->columns.getColumns().at(column).data();
+}
+
+/**
+ * Free a result, and with it all its columns
+ *
+ * @param result result handle, may be NULL
+ */
+void zsdr_result_destroy(zsdr_result* result) {
+  delete result;
+}
@@ -40,6 +40,9 @@ using floating = long double;
 // 10 picoseconds time step size
 constexpr auto TIME_STEP_SIZE = floating{1e-11}; 
 
+// Half the simulation rate.  Nothing at or above this can be simulated
+constexpr auto NYQUIST_HZ = floating{0.5} / TIME_STEP_SIZE;
+
 // Extra cycles at the start to get output stable
 constexpr auto EXTRA_CYCLES = 100;
 
@@ -31,6 +31,7 @@ matplotlib.use('Agg')
 
 import matplotlib.pyplot as plt
 import csv
+import os
 
 # Set this True to add titles to the plots
 ENABLE_TITLE = False
@@ -64,6 +65,76 @@ IQ_AM_DEMOD = 9
 
 counter = 0
 
+# Which reduced series to draw from a .plot file written by
+# program --plot: "envelope" keeps every peak, "lttb" is smoother
+PLOT_SERIES = "envelope"
+
+##
+# Read some of the columns of a results file, each with its own times
+# in microseconds.  If program --plot has written a .plot file for the
+# results it is read instead, as it is much smaller.
+#
+# @param input input filename
+# @param columns CSV columns to read
+# @return a (times, values) pair of lists for each column
+#
+def readSeries(input, columns):
+    plotFile = os.path.splitext(input)[0] + ".plot"
+    if os.path.exists(plotFile):
+        return readPlotSeries(plotFile, columns)
+
+    series = [([], []) for column in columns]
+    with open(input, 'rt') as csvfile:
+        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
+        for row in csvreader:
+            if row[0].startswith("#"):
+                # Skip comment lines
+                continue
+            # times 1e6 to convert seconds to microseconds
+            time = float(row[T_TIME])*1e6
+            for (times, values), column in zip(series, columns):
+                times.append(time)
+                values.append(float(row[column]))
+    return series
+
+##
+# Read some of the columns from a .plot file.  It has a series of
+# each kind for each column after the time step and time, in column
+# order, each after a comment line naming it.  A triggered capture
+# has a series of each kind for every segment, which are joined with
+# a gap between them.
+#
+# @param input .plot filename
+# @param columns CSV columns to read
+# @return a (times, values) pair of lists for each column
+#
+def readPlotSeries(input, columns):
+    found = {}
+    column = 1
+    current = None
+    with open(input, 'rt') as csvfile:
+        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
+        for row in csvreader:
+            if row[0].startswith("#"):
+                kind = row[0][1:].strip()
+                later = len(row) > 2 and row[2].strip() != "segment 0"
+                if kind == "envelope" and not later:
+                    column = column + 1
+                current = None
+                if kind == PLOT_SERIES and column in columns:
+                    if later:
+                        current = found[column]
+                        current[0].append(float("nan"))
+                        current[1].append(float("nan"))
+                    else:
+                        current = ([], [])
+                        found[column] = current
+                continue
+            if current is not None:
+                current[0].append(float(row[0])*1e6)
+                current[1].append(float(row[1]))
+    return [found[column] for column in columns]
+
 ##
 # zetasdrVoltage
 #
@@ -83,24 +154,9 @@ def zetasdrVoltage(input, filename, title, cap1, cap2,
                   threePlots):
     print("Writing " + filename)
     global counter
-    time = []
-    rfSignal = []
-    cap1Voltage = []
-    cap2Voltage = []
-    capsVoltage = []
-    with open(input, 'rt') as csvfile:
-        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
-        for row in csvreader:
-            if row[0].startswith("#"):
-                # Skip comment lines
-                continue
-            # times 1e6 to convert picoseconds to microseconds
-            time.append(float(row[T_TIME])*1e6)
-            rfSignal.append(float(row[T_SIGNAL]))
-            cap1Voltage.append(float(row[cap1]))
-            cap2Voltage.append(float(row[cap2]))
-            capsVoltage.append(float(row[ic]))
-    
+    rfSignal, cap1Voltage, cap2Voltage, capsVoltage = \
+        readSeries(input, [T_SIGNAL, cap1, cap2, ic])
+
     plt.figure(num=counter, figsize=(10, 8))
     counter = counter + 1
 
@@ -110,7 +166,7 @@ def zetasdrVoltage(input, filename, title, cap1, cap2,
     numberOfPlots = 2
     if threePlots:
         plt.subplot(3, 1, 1)
-        plt.plot(time, rfSignal, 'r-', label="RF signal")
+        plt.plot(*rfSignal, 'r-', label="RF signal")
         plt.tick_params(axis='x', which='both', bottom=False,
                         top=False, labelbottom=False)
         plt.ylabel("volts")
@@ -119,16 +175,16 @@ def zetasdrVoltage(input, filename, title, cap1, cap2,
     
     plt.subplot(numberOfPlots, 1, numberOfPlots - 1)
     if not threePlots:
-        plt.plot(time, rfSignal, 'r-', label="RF signal")
-    plt.plot(time, cap1Voltage, 'y-', label = cap1label)
-    plt.plot(time, cap2Voltage, 'b-', label = cap2label)
+        plt.plot(*rfSignal, 'r-', label="RF signal")
+    plt.plot(*cap1Voltage, 'y-', label = cap1label)
+    plt.plot(*cap2Voltage, 'b-', label = cap2label)
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(numberOfPlots, 1, numberOfPlots)
-    plt.plot(time, capsVoltage, "g-", label = iclabel)
+    plt.plot(*capsVoltage, "g-", label = iclabel)
     plt.ylabel("volts")
     plt.xlabel("microseconds")
     plt.legend(loc='center right')
@@ -145,20 +201,7 @@ def zetasdrVoltage(input, filename, title, cap1, cap2,
 def iqVoltage(input, filename, title, threePlots):
     print("Writing " + filename)
     global counter
-    time = []
-    rfSignal = []
-    i = []
-    q = []
-    with open(input, 'rt') as csvfile:
-        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
-        for row in csvreader:
-            if row[0].startswith("#"):
-                # Skip comment lines
-                continue
-            time.append(float(row[IQ_TIME])*1e6)
-            rfSignal.append(float(row[IQ_SIGNAL]))
-            i.append(float(row[IQ_I]))
-            q.append(float(row[IQ_Q]))
+    rfSignal, i, q = readSeries(input, [IQ_SIGNAL, IQ_I, IQ_Q])
 
     plt.figure(num=counter, figsize=(10, 8))
     counter = counter + 1
@@ -175,22 +218,22 @@ def iqVoltage(input, filename, title, threePlots):
     else:
         plt.subplot(2, 1, 1)
         
-    plt.plot(time, rfSignal, 'r-', label="RF signal")
+    plt.plot(*rfSignal, 'r-', label="RF signal")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(numberOfPlots, 1, numberOfPlots - 1)
-    plt.plot(time, i, 'y-', label = "$I$")
+    plt.plot(*i, 'y-', label = "$I$")
     plt.xlabel("microseconds")
     plt.ylabel("volts")
     plt.legend(loc='center right')
     if not threePlots:
-        plt.plot(time, q, 'b-', label = "$Q$")
+        plt.plot(*q, 'b-', label = "$Q$")
     else:
         plt.subplot(3, 1, 3)
-        plt.plot(time, q, 'b-', label = "$Q$")
+        plt.plot(*q, 'b-', label = "$Q$")
         plt.ylabel("volts")
         plt.xlabel("microseconds")
         plt.legend(loc='center right')
@@ -207,28 +250,9 @@ def iqVoltage(input, filename, title, threePlots):
 def iqDemod(input, filename, title):
     print("Writing " + filename)
     global counter
-    time = []
-    rfSignal = []
-    modulation = []
-    i = []
-    q = []
-    iLowPass = []
-    qLowPass = []
-    demod = []
-    with open(input, 'rt') as csvfile:
-        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
-        for row in csvreader:
-            if row[0].startswith("#"):
-                # Skip comment lines
-                continue
-            time.append(float(row[IQ_TIME])*1e6)
-            rfSignal.append(float(row[IQ_SIGNAL]))
-            modulation.append(float(row[IQ_MODULATION]))
-            i.append(float(row[IQ_I]))
-            q.append(float(row[IQ_Q]))
-            iLowPass.append(float(row[IQ_I_LOW_PASS]))
-            qLowPass.append(float(row[IQ_Q_LOW_PASS]))
-            demod.append(float(row[IQ_AM_DEMOD]))
+    rfSignal, modulation, i, q, iLowPass, qLowPass, demod = \
+        readSeries(input, [IQ_SIGNAL, IQ_MODULATION, IQ_I, IQ_Q,
+                           IQ_I_LOW_PASS, IQ_Q_LOW_PASS, IQ_AM_DEMOD])
 
     plt.figure(num=counter, figsize=(10, 8))
     counter = counter + 1
@@ -238,30 +262,30 @@ def iqDemod(input, filename, title):
             plt.suptitle(title)
 
     plt.subplot(5, 1, 1)
-    plt.plot(time, modulation, 'c-', label="Modulation")
+    plt.plot(*modulation, 'c-', label="Modulation")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 2)
-    plt.plot(time, rfSignal, 'r-', label="RF signal")
+    plt.plot(*rfSignal, 'r-', label="RF signal")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 3)
-    plt.plot(time, i, 'y-', label = "$I$")
-    plt.plot(time, q, 'b-', label = "$Q$")
+    plt.plot(*i, 'y-', label = "$I$")
+    plt.plot(*q, 'b-', label = "$Q$")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 4)
-    plt.plot(time, iLowPass, 'y-', label = "low pass$(I)$")
-    plt.plot(time, qLowPass, 'b-', label = "low pass$(Q)$")
+    plt.plot(*iLowPass, 'y-', label = "low pass$(I)$")
+    plt.plot(*qLowPass, 'b-', label = "low pass$(Q)$")
     # Plot zero axis as it makes I^2 + q^2 clearer
     plt.axhline(0, color='black', lw=1)
     plt.tick_params(axis='x', which='both', bottom=False,
@@ -270,7 +294,7 @@ def iqDemod(input, filename, title):
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 5)
-    plt.plot(time, demod, 'c-', label = "sqrt($I^2 + Q^2$)")
+    plt.plot(*demod, 'c-', label = "sqrt($I^2 + Q^2$)")
     plt.ylabel("volts")
     plt.xlabel("microseconds")
     plt.legend(loc='center right')
@@ -287,28 +311,9 @@ def iqDemod(input, filename, title):
 def zetasdrDemod(input, filename, title):
     print("Writing " + filename)
     global counter
-    time = []
-    rfSignal = []
-    modulation = []
-    i = []
-    q = []
-    iLowPass = []
-    qLowPass = []
-    demod = []
-    with open(input, 'rt') as csvfile:
-        csvreader = csv.reader(csvfile, delimiter=',', quotechar='"')
-        for row in csvreader:            
-            if row[0].startswith("#"):
-                # Skip comment lines
-                continue
-            time.append(float(row[T_TIME])*1e6)
-            rfSignal.append(float(row[T_SIGNAL]))
-            modulation.append(float(row[T_MODULATION]))
-            i.append(float(row[T_IC2A_IN]))
-            q.append(float(row[T_IC2B_IN]))
-            iLowPass.append(float(row[T_I_LOW_PASS]))
-            qLowPass.append(float(row[T_Q_LOW_PASS]))
-            demod.append(float(row[T_AM_DEMOD]))
+    rfSignal, modulation, i, q, iLowPass, qLowPass, demod = \
+        readSeries(input, [T_SIGNAL, T_MODULATION, T_IC2A_IN, T_IC2B_IN,
+                           T_I_LOW_PASS, T_Q_LOW_PASS, T_AM_DEMOD])
 
     plt.figure(num=counter, figsize=(10, 8))
     counter = counter + 1
@@ -318,30 +323,30 @@ def zetasdrDemod(input, filename, title):
             plt.suptitle(title)
 
     plt.subplot(5, 1, 1)
-    plt.plot(time, modulation, 'c-', label="Modulation")
+    plt.plot(*modulation, 'c-', label="Modulation")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
     
     plt.subplot(5, 1, 2)
-    plt.plot(time, rfSignal, "r-", label="RF signal")
+    plt.plot(*rfSignal, "r-", label="RF signal")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 3)
-    plt.plot(time, i, 'y-', label = "$I$")
-    plt.plot(time, q, 'b-', label = "$Q$")
+    plt.plot(*i, 'y-', label = "$I$")
+    plt.plot(*q, 'b-', label = "$Q$")
     plt.tick_params(axis='x', which='both', bottom=False,
                     top=False, labelbottom=False)
     plt.ylabel("volts")
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 4)
-    plt.plot(time, iLowPass, 'y-', label = "low pass$(I)$")
-    plt.plot(time, qLowPass, 'b-', label = "low pass$(Q)$")
+    plt.plot(*iLowPass, 'y-', label = "low pass$(I)$")
+    plt.plot(*qLowPass, 'b-', label = "low pass$(Q)$")
     # Plot zero axis as it makes I^2 + q^2 clearer
     plt.axhline(0, color='black', lw=1)
     plt.tick_params(axis='x', which='both', bottom=False,
@@ -350,7 +355,7 @@ def zetasdrDemod(input, filename, title):
     plt.legend(loc='center right')
 
     plt.subplot(5, 1, 5)
-    plt.plot(time, demod, 'c-', label = "sqrt($I^2 + Q^2$)")
+    plt.plot(*demod, 'c-', label = "sqrt($I^2 + Q^2$)")
     plt.ylabel("volts")
     plt.xlabel("microseconds")
     plt.legend(loc='center right')
@@ -10,10 +10,11 @@
  * The modulation frequency is an unrealistic 200 kHz to provide an
  * intelligible plot.  In practice, 7 MHz is in an amateur band and AM
  * modulation would probably be below 10 kHz. The active filter op-amp
- * circuits aren't simulated because they have a cut-off of around 10
- * kHz, which will attenuate the 200 kHz signal too strongly.  Equally
- * the carrier amplitude is set to 1 mV, which will saturate the
- * active filters because of their gain.
+ * circuits aren't simulated by default because they have a cut-off of
+ * around 10 kHz, which will attenuate the 200 kHz signal too
+ * strongly.  Equally the carrier amplitude is set to 1 mV, which will
+ * saturate the active filters because of their gain.  The --opamp
+ * option adds a linear model of them, which does not saturate.
  *
  * Copyright 2019  Jason Leake
  *
@@ -42,48 +43,234 @@
 // are wondering
 
 #include <fstream>
+#include <getopt.h>
 #include <iostream>
 #include "Mixer.h"
+#include "Scenarios.h"
 #include "Signal.h"
+#include "Trace.h"
 
 using namespace std;
 
-// 7 MHz RF carrier frequency
-constexpr auto CARRIER_FREQUENCY =  floating{7e6};
+// Default number of output lines either side of a trigger
+constexpr auto PRE_TRIGGER_LINES = 100;
+constexpr auto POST_TRIGGER_LINES = 400;
 
-// 100 kHz amplitude modulation
-constexpr auto MODULATION_FREQUENCY = floating{1e5};
+// Where the results of each scenario are cached
+constexpr auto DEFAULT_CACHE_DIRECTORY = ".zetasdr_cache";
 
-// 7.5 MHz adjacent frequency
-constexpr auto ADJ_CARRIER_FREQUENCY = floating{7.6e6};
-
-// 83 kHz adjacent signal amplitude modulation
-constexpr auto ADJ_MODULATION_FREQUENCY = floating{8.3e4};
-
-// Use this where we don't want modulation
-constexpr auto NO_MODULATION = floating{0};
-
-// 1 mV
-constexpr auto CARRIER_AMPLITUDE = floating{1e-3};
-
-constexpr auto PHASE_ANGLE_DEGREES = floating{35};
-
-// Two 74HC4052 channels in parallel at 70 ohms each
-// = 50 ohm antenna impedance + 35 ohm through 74HC4052
-constexpr auto RESISTANCE = floating{85};
-
-// Detector capacitors C2-C5
-constexpr auto CAPACITANCE = floating{0.022e-6}; // 0.022 uF
-
-// 400 kHz cutoff
-constexpr auto FILTER_CUTOFF = floating{4e5};
+//===================================================================
 
-// Number of carrier cycles
-constexpr auto CYCLES = 200;
+/**
+ * Print the command line options
+ *
+ * @param name program name
+ */
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options]\n"
+       << "  --trigger SPEC   only write the lines around a trigger.  SPEC is\n"
+       << "                   column:level:value, column:rising:value,\n"
+       << "                   column:falling:value or window:start:end.\n"
+       << "                   Only --pipelined and --fused keep just the\n"
+       << "                   captured lines, for any column but\n"
+       << "                   demodulated and without --adc\n"
+       << "  --pre LINES      lines to keep before the trigger (default "
+       << PRE_TRIGGER_LINES << ")\n"
+       << "  --post LINES     lines to keep after the trigger (default "
+       << POST_TRIGGER_LINES << ")\n"
+       << "  --segments N     stop after N captures (default 0, no limit)\n"
+       << "  --adc SPEC       digitise the I/Q signal and add fixed point\n"
+       << "                   baseband columns.  SPEC is\n"
+       << "                   bits:sampleRateHz:fullScaleVolts[:cutoffHz]\n"
+       << "                   where the baseband filter cut-off defaults\n"
+       << "                   to 0.45 of the sample rate\n"
+       << "  --opamp          simulate the IC2A and IC2B active filters\n"
+       << "  --modulation SPEC\n"
+       << "                   modulation of the 7 MHz carrier in the\n"
+       << "                   modulated runs.  SPEC is am:modHz,\n"
+       << "                   fm:modHz:deviationHz, usb:toneHz, lsb:toneHz,\n"
+       << "                   cw:keyHz:riseSeconds or twotone:lowHz:highHz\n"
+       << "  --band SPEC      add a crowded band of AM stations around the\n"
+       << "                   wanted carrier.  SPEC is\n"
+       << "                   stations[:spanHz[:seed]] (default span "
+       << BAND_SPAN << ")\n"
+       << "  --noise SPEC     add Gaussian noise to the RF signal and jitter\n"
+       << "                   to the local oscillator.  SPEC is\n"
+       << "                   rmsVolts[:bandwidthHz[:jitterSeconds[:seed]]]\n"
+       << "  --cache-dir DIR  where to keep the results of each scenario\n"
+       << "                   (default " << DEFAULT_CACHE_DIRECTORY << ")\n"
+       << "  --no-cache       simulate every scenario, even if it hasn't\n"
+       << "                   changed since it was last run\n"
+       << "  --compress       write compressed .zsc files instead of CSV\n"
+       << "                   files.  unpack turns them back into CSV\n"
+       << "  --plot WIDTH     write .plot files with each column reduced to\n"
+       << "                   what a plot WIDTH pixels wide can show,\n"
+       << "                   instead of CSV files.  plot.py uses them\n"
+       << "  --phases N       simulate a Tayloe detector with 8 or 16\n"
+       << "                   phases instead of the ZetaSDR's 4\n"
+       << "  --logic TIMING   simulate the flip flops and multiplexer by\n"
+       << "                   events with propagation delays, \"typical\"\n"
+       << "                   for 74HC parts or FLIPFLOP:ON:OFF in ns\n"
+       << "  --statistics     write .stats files with summary statistics\n"
+       << "                   of each run, such as I/Q imbalance and\n"
+       << "                   distortion, instead of the results\n"
+       << "  --fixed-circuit  use the detector with the ZetaSDR's circuit\n"
+       << "                   values built in at compile time\n"
+       << "  --pipelined      run the ZetaSDR signal synthesis, detector\n"
+       << "                   and filters in separate threads\n"
+       << "  --chunks N[:OVERLAP]\n"
+       << "                   split each ZetaSDR run into N chunks of time\n"
+       << "                   simulated in parallel, each starting OVERLAP\n"
+       << "                   seconds early to settle (default "
+       << DEFAULT_CHUNK_OVERLAP << ")\n"
+       << "  --check-chunks   also run sequentially, and report the\n"
+       << "                   largest differences at the chunk joins\n"
+       << "  --fused          run the IQ mixer in a single pass, keeping\n"
+       << "                   only the lines that are written\n"
+       << "  --trace FILE     write a timeline of what each thread was\n"
+       << "                   doing as Chrome trace event JSON\n"
+       << "  --telemetry NAME[:COLUMNS]\n"
+       << "                   publish the progress and the latest samples\n"
+       << "                   of the comma separated COLUMNS in shared\n"
+       << "                   memory, for the telemetry viewer\n";
+}
 
 //===================================================================
 
-auto main() -> int {
+auto main(int argc, char* argv[]) -> int {
+
+  auto trigger = string{};
+  auto preTrigger = size_t{PRE_TRIGGER_LINES};
+  auto postTrigger = size_t{POST_TRIGGER_LINES};
+  auto maxSegments = size_t{0};
+  auto adc = string{};
+  auto opAmp = false;
+  auto pipelined = false;
+  auto fixedCircuit = false;
+  auto fused = false;
+  auto modulation = Modulation{AmModulation{MODULATION_FREQUENCY}};
+  auto noise = string{};
+  auto band = string{};
+  auto cacheDirectory = string{DEFAULT_CACHE_DIRECTORY};
+  auto compress = false;
+  auto plotWidth = size_t{0};
+  auto statistics = false;
+  auto telemetry = string{};
+  auto phases = size_t{0};
+  auto logic = string{};
+  auto chunks = string{};
+  auto checkChunks = false;
+  auto traceFile = string{};
+
+  static const struct option longOptions[] = {
+    {"trigger", required_argument, nullptr, 't'},
+    {"pre", required_argument, nullptr, 'b'},
+    {"post", required_argument, nullptr, 'a'},
+    {"segments", required_argument, nullptr, 's'},
+    {"adc", required_argument, nullptr, 'd'},
+    {"opamp", no_argument, nullptr, 'o'},
+    {"pipelined", no_argument, nullptr, 'p'},
+    {"fixed-circuit", no_argument, nullptr, 'F'},
+    {"fused", no_argument, nullptr, 'f'},
+    {"modulation", required_argument, nullptr, 'm'},
+    {"noise", required_argument, nullptr, 'n'},
+    {"band", required_argument, nullptr, 'B'},
+    {"cache-dir", required_argument, nullptr, 'c'},
+    {"no-cache", no_argument, nullptr, 'N'},
+    {"compress", no_argument, nullptr, 'z'},
+    {"plot", required_argument, nullptr, 'w'},
+    {"statistics", no_argument, nullptr, 'S'},
+    {"telemetry", required_argument, nullptr, 'T'},
+    {"phases", required_argument, nullptr, 'P'},
+    {"logic", required_argument, nullptr, 'L'},
+    {"chunks", required_argument, nullptr, 'C'},
+    {"check-chunks", no_argument, nullptr, 'V'},
+    {"trace", required_argument, nullptr, 'R'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  auto option = int{0};
+  while ((option = getopt_long(argc, argv, "t:b:a:s:d:opFfm:n:B:c:Nzw:ST:P:L:C:VR:h",
+			       longOptions, nullptr)) != -1) {
+    switch (option) {
+    case 't':
+      trigger = optarg;
+      break;
+    case 'b':
+      preTrigger = stoul(optarg);
+      break;
+    case 'a':
+      postTrigger = stoul(optarg);
+      break;
+    case 's':
+      maxSegments = stoul(optarg);
+      break;
+    case 'd':
+      adc = optarg;
+      break;
+    case 'o':
+      opAmp = true;
+      break;
+    case 'p':
+      pipelined = true;
+      break;
+    case 'F':
+      fixedCircuit = true;
+      break;
+    case 'f':
+      fused = true;
+      break;
+    case 'm':
+      modulation = parseModulation(optarg);
+      break;
+    case 'n':
+      noise = optarg;
+      break;
+    case 'B':
+      band = optarg;
+      break;
+    case 'c':
+      cacheDirectory = optarg;
+      break;
+    case 'N':
+      cacheDirectory.clear();
+      break;
+    case 'z':
+      compress = true;
+      break;
+    case 'w':
+      plotWidth = stoul(optarg);
+      break;
+    case 'S':
+      statistics = true;
+      break;
+    case 'T':
+      telemetry = optarg;
+      break;
+    case 'P':
+      phases = stoul(optarg);
+      break;
+    case 'L':
+      logic = optarg;
+      break;
+    case 'C':
+      chunks = optarg;
+      break;
+    case 'V':
+      checkChunks = true;
+      break;
+    case 'R':
+      traceFile = optarg;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
 
   const auto zetaSdrCircuit = Circuit{RESISTANCE,
 				      CAPACITANCE,
@@ -92,96 +279,101 @@ auto main() -> int {
   auto zetasdr = ZetaSdr{zetaSdrCircuit};
   auto iqmixer = IqMixer{FILTER_CUTOFF};
 
-  // Signals to use
-  const auto unmodulatedSignal = Signal{CARRIER_AMPLITUDE,
-					CARRIER_FREQUENCY,
-					NO_MODULATION};
-
-  const auto modulatedSignal = Signal{CARRIER_AMPLITUDE,
-				      CARRIER_FREQUENCY,
-				      MODULATION_FREQUENCY};
-
-  // Same signal as before but with additional signal 0.5 MHz away
-  auto adjacentSignal = modulatedSignal;
-  adjacentSignal.add(CARRIER_AMPLITUDE,
-		     ADJ_CARRIER_FREQUENCY,
-		     ADJ_MODULATION_FREQUENCY);
-
-  // The ZetaSDR radio simulation and the IQ mixer tune themselves to
-  // the first element of the signal object.  So swap the two elements
-  // over to get these simulators to tune to the adjacent frequency
-  // instead.
-  auto tunedToAdjacentSignal = Signal(CARRIER_AMPLITUDE,
-				      ADJ_CARRIER_FREQUENCY,
-				      ADJ_MODULATION_FREQUENCY);
-  tunedToAdjacentSignal.add(CARRIER_AMPLITUDE,
-			    CARRIER_FREQUENCY,
-			    MODULATION_FREQUENCY);
-
-  /*
-   * Unmodulated carrier, in phase with local oscillator
-   */
-  zetasdr.run("zetasdr_unmodulated_0.txt", 4,
-  	      unmodulatedSignal, 0);
-
-  /*
-   * Unmodulated carrier, with 35 degree phase difference in start
-   * state compared to local oscillator
-   */
-  zetasdr.run("zetasdr_unmodulated_35.txt", 4,
-	      unmodulatedSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Modulated carrier, in phase with local oscillator
-   */
-  zetasdr.run("zetasdr_modulated_0.txt", CYCLES,
-	      modulatedSignal, 0);
-
-
-  /*
-   * Modulated carrier with 35 degree phase difference in initial
-   * state compared to local oscillator
-   */
-  zetasdr.run("zetasdr_modulated_35.txt", CYCLES,
-	      modulatedSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Modulated carrier with 35 degree phase difference in initial
-   * state compared to local oscillator, plus another signal 0.5 MHz
-   * higher frequency.
-   */
-  zetasdr.run("zetasdr_adjacent_35.txt", CYCLES,
-	      adjacentSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Ideal multiplying IQ mixer.
-   */
-  iqmixer.run("iq_modulated_0.txt", CYCLES,
-	      modulatedSignal, 0);
-
-  /*
-   * Ideal multiplying IQ mixer with 35 degree phase difference
-   */
-  iqmixer.run("iq_modulated_35.txt", CYCLES,
-	      modulatedSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Ideal multiplying IQ mixer with adjacent signal present
-   */
-  iqmixer.run("iq_adjacent_35.txt", CYCLES,
-	      adjacentSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Tune the ZetaSDR to the adjacent channel and see what that looks
-   * like.
-   */
-  zetasdr.run("zetasdr_tuned_adjacent_35.txt", CYCLES,
-	      tunedToAdjacentSignal, PHASE_ANGLE_DEGREES);
-
-  /*
-   * Tune the IQ mixer to the adjacent channel and see what that looks
-   * like.
-   */
-  iqmixer.run("iq_tuned_adjacent_35.txt", CYCLES,
-	      tunedToAdjacentSignal, PHASE_ANGLE_DEGREES);
+  // The scenarios share their signals, so only synthesise each one once
+  auto waveforms = make_shared<WaveformCache>();
+  zetasdr.setWaveformCache(waveforms);
+  iqmixer.setWaveformCache(waveforms);
+
+  if (!telemetry.empty()) {
+    const auto colon = telemetry.find(':');
+    auto publisher = colon == string::npos ?
+      make_shared<TelemetryPublisher>(telemetry) :
+      make_shared<TelemetryPublisher>(telemetry.substr(0, colon),
+				      telemetry.substr(colon + 1));
+    zetasdr.setTelemetry(publisher);
+    iqmixer.setTelemetry(publisher);
+  }
+
+  if (phases) {
+    zetasdr.setPhases(phases);
+  }
+  if (!logic.empty()) {
+    zetasdr.setLogicTiming(LogicTiming::parse(logic));
+  }
+  zetasdr.setPipelined(pipelined);
+  zetasdr.setFixedCircuit(fixedCircuit);
+  if (!chunks.empty()) {
+    const auto colon = chunks.find(':');
+    zetasdr.setChunks(stoul(chunks.substr(0, colon)),
+		      colon == string::npos ? DEFAULT_CHUNK_OVERLAP :
+		      stold(chunks.substr(colon + 1)),
+		      checkChunks);
+  }
+  iqmixer.setFused(fused);
+  zetasdr.setCompressed(compress);
+  iqmixer.setCompressed(compress);
+  zetasdr.setPlotWidth(plotWidth);
+  iqmixer.setPlotWidth(plotWidth);
+  zetasdr.setStatistics(statistics);
+  iqmixer.setStatistics(statistics);
+
+  if (!cacheDirectory.empty()) {
+    zetasdr.setCache(cacheDirectory);
+    iqmixer.setCache(cacheDirectory);
+  }
+
+  if (!trigger.empty()) {
+    const auto settings = CaptureSettings{Trigger::parse(trigger),
+					  preTrigger,
+					  postTrigger,
+					  maxSegments};
+    zetasdr.setCapture(settings);
+    iqmixer.setCapture(settings);
+  }
+
+  if (opAmp) {
+    zetasdr.setOpAmpFilter(OpAmpFilter{RESISTANCE,
+				       OPAMP_FEEDBACK_RESISTANCE,
+				       OPAMP_FEEDBACK_CAPACITANCE,
+				       OPAMP_COUPLING_CAPACITANCE,
+				       SOUND_CARD_INPUT_RESISTANCE});
+  }
+
+  if (!noise.empty()) {
+    const auto settings = NoiseSettings::parse(noise);
+    zetasdr.setNoise(settings);
+    iqmixer.setNoise(settings);
+  }
+
+  if (!adc.empty()) {
+    const auto settings = AdcSettings::parse(adc);
+    zetasdr.setAdc(settings);
+    iqmixer.setAdc(settings);
+  }
+
+  const auto bandSettings = band.empty() ? optional<BandSettings>{} :
+    BandSettings::parse(band);
+
+  const auto extension = statistics ? ".stats" : plotWidth ? ".plot" :
+    compress ? ".zsc" : ".txt";
+  if (!traceFile.empty()) {
+    Trace::start();
+  }
+  for (auto&& scenario : standardScenarios(modulation)) {
+    auto trace = TraceScope{"scenario", scenario.name};
+    if (bandSettings) {
+      addCrowdedBand(scenario.signal, *bandSettings);
+    }
+    if (scenario.receiver == Receiver::ZETASDR) {
+      zetasdr.run(scenario.name + extension, scenario.cycleCount,
+		  scenario.signal, scenario.phaseAngleDeg);
+    }
+    else {
+      iqmixer.run(scenario.name + extension, scenario.cycleCount,
+		  scenario.signal, scenario.phaseAngleDeg);
+    }
+  }
+  if (!traceFile.empty()) {
+    Trace::write(traceFile);
+  }
 }
@@ -0,0 +1,278 @@
+/**
+ * Sweeps an interfering carrier past the receivers
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tunes a receiver to the 7 MHz carrier, adds a weaker unmodulated
+ * carrier at each of a range of frequencies, and measures how much
+ * of it gets into the filtered I/Q output, how well its image is
+ * rejected, and how loud its beat with the wanted carrier is in the
+ * demodulated output.  Each frequency is only simulated until the
+ * Goertzel detectors agree from one window to the next.  The results
+ * go to standard output in the same comma separated format as the
+ * program output files.
+ *
+ * With --refine, the frequencies are only the starting grid, and
+ * more are added wherever the levels change faster than a straight
+ * line between their neighbours, which is mostly around the edges of
+ * the pass band and the harmonics of the local oscillator.
+ */
+
+#include <getopt.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "Refinement.h"
+#include "Selectivity.h"
+
+using namespace std;
+
+// Default sweep, from just outside the 400 kHz filter to past the
+// 7.6 MHz adjacent signal
+constexpr auto DEFAULT_FROM_HZ = floating{7.1e6};
+constexpr auto DEFAULT_TO_HZ = floating{8e6};
+constexpr auto DEFAULT_POINTS = size_t{10};
+
+// Default convergence tolerance, about 0.01 dB
+constexpr auto DEFAULT_TOLERANCE = floating{1e-3};
+
+// Default longest simulated time for each frequency
+constexpr auto DEFAULT_MAX_SECONDS = floating{200e-6};
+
+// Levels that refinement follows by default.  The ideal mixer's
+// image rejection is only rounding error, and would be refined
+// everywhere.
+constexpr auto DEFAULT_REFINE_METRICS = "selectivity,demodulated";
+
+// Default smallest step between refined frequencies, as a fraction
+// of the sweep
+constexpr auto DEFAULT_MIN_STEP_FRACTION = floating{1.0 / 1024};
+
+//===================================================================
+
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options]\n"
+       << "  --receiver NAME  zetasdr (default) or iq\n"
+       << "  --from HZ        first interfering carrier frequency\n"
+       << "                   (default " << DEFAULT_FROM_HZ << ")\n"
+       << "  --to HZ          last interfering carrier frequency\n"
+       << "                   (default " << DEFAULT_TO_HZ << ")\n"
+       << "  --points N       number of frequencies (default "
+       << DEFAULT_POINTS << ")\n"
+       << "  --phase DEGREES  phase of the wanted carrier compared to\n"
+       << "                   the local oscillator (default 0)\n"
+       << "  --phases N       phases of the ZetaSDR's Tayloe detector,\n"
+       << "                   4 (default), 8 or 16\n"
+       << "  --tolerance X    largest relative change in the levels from\n"
+       << "                   one window to the next (default "
+       << DEFAULT_TOLERANCE << ")\n"
+       << "  --max-time S     longest time to simulate at each frequency\n"
+       << "                   (default " << DEFAULT_MAX_SECONDS << ")\n"
+       << "  --refine DB      add frequencies between the points wherever\n"
+       << "                   a level is more than DB off a straight line\n"
+       << "  --metrics LIST   levels that --refine follows, from\n"
+       << "                   selectivity, image and demodulated (default\n"
+       << "                   " << DEFAULT_REFINE_METRICS << ")\n"
+       << "  --budget N       most frequencies to measure when refining\n"
+       << "                   (default " << DEFAULT_REFINEMENT_BUDGET << ")\n"
+       << "  --min-step HZ    smallest step to refine down to (default\n"
+       << "                   1/1024 of the sweep)\n"
+       << "  --workers N      frequencies to measure at once (default one\n"
+       << "                   per core)\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto receiver = Receiver::ZETASDR;
+  auto fromHz = DEFAULT_FROM_HZ;
+  auto toHz = DEFAULT_TO_HZ;
+  auto points = DEFAULT_POINTS;
+  auto phaseAngleDeg = floating{0};
+  auto detectorPhases = size_t{4};
+  auto tolerance = DEFAULT_TOLERANCE;
+  auto maxSeconds = DEFAULT_MAX_SECONDS;
+  auto refineDb = numeric_limits<floating>::infinity();
+  auto metricNames = string{DEFAULT_REFINE_METRICS};
+  auto budget = DEFAULT_REFINEMENT_BUDGET;
+  auto minStepHz = floating{0};
+  auto workers = size_t{max(1u, thread::hardware_concurrency())};
+
+  static const struct option longOptions[] = {
+    {"receiver", required_argument, nullptr, 'r'},
+    {"from", required_argument, nullptr, 'f'},
+    {"to", required_argument, nullptr, 't'},
+    {"points", required_argument, nullptr, 'n'},
+    {"phase", required_argument, nullptr, 'p'},
+    {"phases", required_argument, nullptr, 'P'},
+    {"tolerance", required_argument, nullptr, 'e'},
+    {"max-time", required_argument, nullptr, 'm'},
+    {"refine", required_argument, nullptr, 'R'},
+    {"metrics", required_argument, nullptr, 'M'},
+    {"budget", required_argument, nullptr, 'b'},
+    {"min-step", required_argument, nullptr, 's'},
+    {"workers", required_argument, nullptr, 'j'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  try {
+    auto option = int{0};
+    while ((option = getopt_long(argc, argv, "r:f:t:n:p:P:e:m:R:M:b:s:j:h",
+				 longOptions, nullptr)) != -1) {
+      switch (option) {
+      case 'r':
+	if (optarg == "zetasdr"s) {
+	  receiver = Receiver::ZETASDR;
+	}
+	else if (optarg == "iq"s) {
+	  receiver = Receiver::IQMIXER;
+	}
+	else {
+	  cout << "Unknown receiver " << optarg << endl;
+	  return EXIT_FAILURE;
+	}
+	break;
+      case 'f':
+	fromHz = stold(optarg);
+	break;
+      case 't':
+	toHz = stold(optarg);
+	break;
+      case 'n':
+	points = stoul(optarg);
+	break;
+      case 'p':
+	phaseAngleDeg = stold(optarg);
+	break;
+      case 'P':
+	detectorPhases = stoul(optarg);
+	break;
+      case 'e':
+	tolerance = stold(optarg);
+	break;
+      case 'm':
+	maxSeconds = stold(optarg);
+	break;
+      case 'R':
+	refineDb = stold(optarg);
+	break;
+      case 'M':
+	metricNames = optarg;
+	break;
+      case 'b':
+	budget = stoul(optarg);
+	break;
+      case 's':
+	minStepHz = stold(optarg);
+	break;
+      case 'j':
+	workers = stoul(optarg);
+	break;
+      case 'h':
+	usage(argv[0]);
+	return EXIT_SUCCESS;
+      default:
+	usage(argv[0]);
+	return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (const logic_error&) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (points == 0) {
+    cout << "Need at least one frequency" << endl;
+    return EXIT_FAILURE;
+  }
+  // Pick out the levels to follow when refining
+  auto metrics = vector<floating SelectivityPoint::*>{};
+  auto metricStream = istringstream{metricNames};
+  auto metricName = string{};
+  while (getline(metricStream, metricName, ',')) {
+    if (metricName == "selectivity") {
+      metrics.push_back(&SelectivityPoint::selectivityDb);
+    }
+    else if (metricName == "image") {
+      metrics.push_back(&SelectivityPoint::imageRejectionDb);
+    }
+    else if (metricName == "demodulated") {
+      metrics.push_back(&SelectivityPoint::demodulatedDb);
+    }
+    else {
+      cout << "Unknown level " << metricName << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (minStepHz <= 0) {
+    minStepHz = fabs(toHz - fromHz) * DEFAULT_MIN_STEP_FRACTION;
+  }
+
+  const auto maxTimeSteps = static_cast<size_t>(maxSeconds / TIME_STEP_SIZE);
+
+  auto grid = vector<floating>{};
+  for (auto point = size_t{0}; point < points; point++) {
+    grid.push_back(points == 1 ? fromHz :
+		   fromHz + (toHz - fromHz) * point / (points - 1));
+  }
+
+  auto sweep = AdaptiveSweep<SelectivityPoint>{
+    [&](floating interfererHz) -> optional<SelectivityPoint> {
+      // Refining around the wanted carrier can land right on it
+      if (interfererHz == CARRIER_FREQUENCY) {
+	return {};
+      }
+      return measureSelectivity(receiver, interfererHz, phaseAngleDeg,
+				tolerance, maxTimeSteps, detectorPhases);
+    },
+    [&](const SelectivityPoint& point) {
+      auto levels = vector<floating>{};
+      for (auto&& metric : metrics) {
+	levels.push_back(point.*metric);
+      }
+      return levels;
+    },
+    refineDb, minStepHz, budget, workers};
+  const auto results = sweep.run(grid);
+
+  cout << "# interfererHz, offsetHz, selectivityDb, imageRejectionDb, "
+       << "demodulatedDb, seconds, converged" << endl;
+  if (sweep.wasCut()) {
+    cout << "# the budget ran out after " << results.size()
+	 << " frequencies, before the levels were within " << refineDb
+	 << " dB of straight lines" << endl;
+  }
+  for (auto&& [interfererHz, result] : results) {
+    cout << result.interfererHz << ","
+	 << result.interfererHz - CARRIER_FREQUENCY << ","
+	 << result.selectivityDb << ","
+	 << result.imageRejectionDb << ","
+	 << result.demodulatedDb << ","
+	 << result.timeSteps * TIME_STEP_SIZE << ","
+	 << (result.converged ? 1 : 0) << endl;
+  }
+  return EXIT_SUCCESS;
+}
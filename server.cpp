@@ -0,0 +1,126 @@
+/**
+ * Runs simulations on request, keeping its caches warm between them
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Clients connect to a UNIX domain socket and send one request per
+ * line, as KEY=VALUE words, such as
+ *
+ *   scenario=zetasdr_modulated_35 phase=10 columns=time,demodulated
+ *
+ * and get the results back as CSV.  See Server.h for the keys.
+ */
+
+#include <csignal>
+#include <getopt.h>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include "Server.h"
+
+using namespace std;
+
+// Set by SIGINT and SIGTERM to stop the server
+static volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Ask the server to stop
+ */
+static auto requestStop(int) -> void {
+  stopRequested = 1;
+}
+
+//===================================================================
+
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options]\n"
+       << "  --socket PATH    socket to listen on (default "
+       << DEFAULT_SERVER_SOCKET << ")\n"
+       << "  --workers N      most simulations to run at once (default\n"
+       << "                   one per core)\n"
+       << "  --memory MB      most memory to keep results in (default "
+       << (DEFAULT_RESULT_MEMORY_BYTES >> 20) << ")\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto socketPath = string{DEFAULT_SERVER_SOCKET};
+  auto workers = size_t{max(1u, thread::hardware_concurrency())};
+  auto memoryBytes = DEFAULT_RESULT_MEMORY_BYTES;
+
+  static const struct option longOptions[] = {
+    {"socket", required_argument, nullptr, 's'},
+    {"workers", required_argument, nullptr, 'j'},
+    {"memory", required_argument, nullptr, 'm'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  try {
+    auto option = int{0};
+    while ((option = getopt_long(argc, argv, "s:j:m:h",
+				 longOptions, nullptr)) != -1) {
+      switch (option) {
+      case 's':
+	socketPath = optarg;
+	break;
+      case 'j':
+	workers = stoul(optarg);
+	break;
+      case 'm':
+	memoryBytes = stoul(optarg) << 20;
+	break;
+      case 'h':
+	usage(argv[0]);
+	return EXIT_SUCCESS;
+      default:
+	usage(argv[0]);
+	return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (const logic_error&) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (optind != argc || workers == 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // No SA_RESTART, so that the signals interrupt the wait for a
+  // connection
+  struct sigaction action = {};
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  auto server = SimulationServer{socketPath, workers, memoryBytes};
+  server.serve(stopRequested);
+  cout << "Stopping" << endl;
+  return EXIT_SUCCESS;
+}
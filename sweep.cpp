@@ -0,0 +1,333 @@
+/**
+ * Runs a sweep of scenarios in several worker processes
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Each job is one of the standard scenarios with its phase angle
+ * changed.  The jobs go in a file queue in the sweep directory, and
+ * worker processes take them off one at a time, so a job that
+ * crashes or is killed only takes its own worker with it.  Its job
+ * is put back on the queue and tried again, up to --attempts times,
+ * and another worker is started in its place.  Workers on other
+ * machines can share the work with "sweep --worker DIR" on the same
+ * directory over a shared filesystem.
+ *
+ * Running sweep again on the same directory carries on from where it
+ * got to, only running the jobs without results.
+ */
+
+#include <algorithm>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "Mixer.h"
+#include "Scenarios.h"
+#include "Sweep.h"
+
+using namespace std;
+
+//===================================================================
+
+/**
+ * Work out the phase angles of a sweep
+ *
+ * @param specification FROM:TO:STEP in degrees
+ * @return the angles
+ */
+static auto parsePhases(const string& specification) -> vector<floating> {
+  auto fields = vector<floating>{};
+  auto stream = istringstream{specification};
+  auto field = string{};
+  while (getline(stream, field, ':')) {
+    fields.push_back(stold(field));
+  }
+  if (fields.size() != 3 || fields[2] <= 0 || fields[1] < fields[0]) {
+    cout << "Phases are FROM:TO:STEP, not " << specification << endl;
+    exit(EXIT_FAILURE);
+  }
+  auto phases = vector<floating>{};
+  const auto count = static_cast<size_t>((fields[1] - fields[0]) / fields[2]
+					 + 1e-9);
+  for (auto index = size_t{0}; index <= count; index++) {
+    phases.push_back(fields[0] + index * fields[2]);
+  }
+  return phases;
+}
+
+/**
+ * Run jobs from the queue until there are none left
+ *
+ * @param queue the queue
+ */
+static auto work(SweepQueue& queue) -> void {
+  const auto circuit = Circuit{RESISTANCE, CAPACITANCE, FILTER_CUTOFF};
+  auto zetasdr = ZetaSdr{circuit};
+  auto iqmixer = IqMixer{FILTER_CUTOFF};
+
+  while (auto claim = queue.claim(getpid())) {
+    const auto job = queue.getJob(claim->name);
+    const auto modulation = job.modulation.empty() ?
+      Modulation{AmModulation{MODULATION_FREQUENCY}} :
+      parseModulation(job.modulation);
+
+    auto scenarios = standardScenarios(modulation);
+    const auto scenario = find_if(scenarios.begin(), scenarios.end(),
+				  [&](const Scenario& candidate) {
+				    return candidate.name == job.scenario;
+				  });
+    if (scenario == scenarios.end()) {
+      cout << "No scenario called " << job.scenario << endl;
+      exit(EXIT_FAILURE);
+    }
+
+    auto& mixer = scenario->receiver == Receiver::ZETASDR ?
+      static_cast<Mixer&>(zetasdr) : static_cast<Mixer&>(iqmixer);
+    mixer.setStatistics(job.format == "statistics");
+    mixer.setCompressed(job.format == "compressed");
+
+    const auto output = queue.temporaryFile(*claim);
+    if (scenario->receiver == Receiver::ZETASDR) {
+      zetasdr.run(output, scenario->cycleCount, scenario->signal,
+		  job.phaseAngleDeg);
+    }
+    else {
+      iqmixer.run(output, scenario->cycleCount, scenario->signal,
+		  job.phaseAngleDeg);
+    }
+    queue.commit(*claim);
+  }
+}
+
+/**
+ * Start a worker process, with its output going to its log file
+ *
+ * @param queue the queue
+ * @return process id of the worker
+ */
+static auto startWorker(SweepQueue& queue) -> pid_t {
+  cout.flush();
+  const auto pid = fork();
+  if (pid < 0) {
+    cout << "Unable to start a worker" << endl;
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    if (!freopen(queue.logFile(getpid()).c_str(), "w", stdout)) {
+      exit(EXIT_FAILURE);
+    }
+    work(queue);
+    exit(EXIT_SUCCESS);
+  }
+  return pid;
+}
+
+//===================================================================
+
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options] DIRECTORY\n"
+       << "  --scenarios LIST comma separated standard scenarios to run\n"
+       << "                   (default all of them)\n"
+       << "  --phases FROM:TO:STEP\n"
+       << "                   phase angles to run each scenario at, in\n"
+       << "                   degrees (default each scenario's own)\n"
+       << "  --modulation SPEC\n"
+       << "                   modulation of the 7 MHz carrier, as for\n"
+       << "                   program\n"
+       << "  --statistics     write summary statistics of each job, and\n"
+       << "                   merge them into summary.csv\n"
+       << "  --compress       write compressed results\n"
+       << "  --workers N      worker processes (default one per core)\n"
+       << "  --attempts N     times to try each job (default "
+       << SWEEP_ATTEMPTS << ")\n"
+       << "  --worker         only run jobs from the queue, for other\n"
+       << "                   machines sharing the directory\n"
+       << "  --merge          only rewrite index.csv and summary.csv\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto scenarioNames = string{};
+  auto phases = string{};
+  auto modulation = string{};
+  auto format = string{"csv"};
+  auto workers = max(1u, thread::hardware_concurrency());
+  auto attempts = SWEEP_ATTEMPTS;
+  auto workerOnly = false;
+  auto mergeOnly = false;
+
+  static const struct option longOptions[] = {
+    {"scenarios", required_argument, nullptr, 's'},
+    {"phases", required_argument, nullptr, 'p'},
+    {"modulation", required_argument, nullptr, 'm'},
+    {"statistics", no_argument, nullptr, 'S'},
+    {"compress", no_argument, nullptr, 'z'},
+    {"workers", required_argument, nullptr, 'j'},
+    {"attempts", required_argument, nullptr, 'a'},
+    {"worker", no_argument, nullptr, 'W'},
+    {"merge", no_argument, nullptr, 'M'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  try {
+    auto option = int{0};
+    while ((option = getopt_long(argc, argv, "s:p:m:Szj:a:WMh",
+				 longOptions, nullptr)) != -1) {
+      switch (option) {
+      case 's':
+	scenarioNames = optarg;
+	break;
+      case 'p':
+	phases = optarg;
+	break;
+      case 'm':
+	modulation = optarg;
+	parseModulation(modulation);
+	break;
+      case 'S':
+	format = "statistics";
+	break;
+      case 'z':
+	format = "compressed";
+	break;
+      case 'j':
+	workers = stoul(optarg);
+	break;
+      case 'a':
+	attempts = stoul(optarg);
+	break;
+      case 'W':
+	workerOnly = true;
+	break;
+      case 'M':
+	mergeOnly = true;
+	break;
+      case 'h':
+	usage(argv[0]);
+	return EXIT_SUCCESS;
+      default:
+	usage(argv[0]);
+	return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (const logic_error&) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (optind + 1 != argc || workers == 0 || attempts == 0) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  auto queue = SweepQueue{argv[optind]};
+
+  if (workerOnly) {
+    work(queue);
+    return EXIT_SUCCESS;
+  }
+  if (mergeOnly) {
+    queue.merge();
+    return EXIT_SUCCESS;
+  }
+
+  if (auto recovered = queue.recover(attempts)) {
+    cout << "Recovered " << recovered << " jobs from stopped workers" << endl;
+  }
+
+  // Add the jobs
+  auto wanted = vector<string>{};
+  auto stream = istringstream{scenarioNames};
+  auto name = string{};
+  while (getline(stream, name, ',')) {
+    wanted.push_back(name);
+  }
+  const auto scenarios = standardScenarios(AmModulation{MODULATION_FREQUENCY});
+  for (auto&& wantedName : wanted) {
+    if (none_of(scenarios.begin(), scenarios.end(),
+		[&](const Scenario& scenario) {
+		  return scenario.name == wantedName;
+		})) {
+      cout << "No scenario called " << wantedName << endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto added = size_t{0};
+  auto done = size_t{0};
+  for (auto&& scenario : scenarios) {
+    if (!wanted.empty() &&
+	find(wanted.begin(), wanted.end(), scenario.name) == wanted.end()) {
+      continue;
+    }
+    const auto angles = phases.empty() ?
+      vector<floating>{scenario.phaseAngleDeg} : parsePhases(phases);
+    for (auto angle : angles) {
+      auto job = SweepJob{scenario.name, scenario.name, angle,
+			  modulation, format};
+      if (!phases.empty()) {
+	auto jobName = ostringstream{};
+	jobName << scenario.name << "_p" << angle;
+	job.name = jobName.str();
+      }
+      (queue.add(job) ? added : done)++;
+    }
+  }
+  cout << added << " jobs to run, " << done << " already done" << endl;
+
+  // Run them, replacing any worker that fails while there is still
+  // work to do
+  auto running = map<pid_t, bool>{};
+  for (auto worker = size_t{0};
+       worker < min<size_t>(workers, queue.count("pending")); worker++) {
+    running[startWorker(queue)] = true;
+  }
+  while (!running.empty()) {
+    auto status = int{0};
+    const auto pid = wait(&status);
+    if (pid < 0) {
+      break;
+    }
+    running.erase(pid);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+      continue;
+    }
+    cout << "Worker " << pid << " failed, see " << queue.logFile(pid) << endl;
+    queue.abandon(pid, attempts);
+    if (queue.count("pending") > 0) {
+      running[startWorker(queue)] = true;
+    }
+  }
+
+  queue.merge();
+  cout << queue.count("failed") << " jobs failed, "
+       << queue.count("pending") + queue.count("running")
+       << " not finished" << endl;
+  return queue.count("failed") ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+/**
+ * Live view of a running simulation
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Attaches to the shared memory that program --telemetry NAME
+ * publishes, and shows the progress and throughput of the run, and a
+ * text scope trace of the latest samples of each published column.
+ * It only reads the shared memory, so it doesn't slow the simulation
+ * down, and it can be started and stopped at any time.  With --csv it
+ * writes the samples as comma separated values instead, for piping
+ * into something else.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "Telemetry.h"
+
+using namespace std;
+
+// Default time between updates
+constexpr auto DEFAULT_INTERVAL_SECONDS = 1.0;
+
+// Default number of characters in each scope trace
+constexpr auto DEFAULT_TRACE_WIDTH = size_t{60};
+
+// Characters for the scope trace, from lowest to highest
+static const char* const TRACE_LEVELS[] = {
+  "▁", "▂", "▃", "▄",
+  "▅", "▆", "▇", "█"
+};
+
+//===================================================================
+
+/**
+ * Draw one column of the latest samples as a row of bars, each bar
+ * being the mean of its share of the samples
+ *
+ * @param samples latest samples
+ * @param column which column
+ * @param width number of bars
+ * @return the bars
+ */
+static auto trace(const vector<TelemetrySample>& samples,
+		  size_t column,
+		  size_t width) -> string {
+  if (samples.empty()) {
+    return {};
+  }
+  width = min(width, samples.size());
+  auto bars = vector<double>(width);
+  for (auto bar = size_t{0}; bar < width; bar++) {
+    const auto first = bar * samples.size() / width;
+    const auto last = (bar + 1) * samples.size() / width;
+    for (auto index = first; index < last; index++) {
+      bars[bar] += samples[index].values.at(column);
+    }
+    bars[bar] /= last - first;
+  }
+
+  const auto [lowest, highest] = minmax_element(bars.begin(), bars.end());
+  const auto range = *highest - *lowest;
+  auto text = string{};
+  for (auto value : bars) {
+    const auto level = range > 0 ?
+      static_cast<size_t>((value - *lowest) / range * 7.999) : 0;
+    text += TRACE_LEVELS[level];
+  }
+  return text;
+}
+
+/**
+ * Show the progress of a run, and a trace of each of its columns
+ *
+ * @param run the run
+ * @param samples latest samples
+ * @param width characters in each trace
+ */
+static auto show(const TelemetryRun& run,
+		 const vector<TelemetrySample>& samples,
+		 size_t width) -> void {
+  const auto seconds =
+    (telemetryNanoseconds() - run.startNanoseconds) * 1e-9;
+  const auto fraction = run.totalTimeSteps ?
+    static_cast<double>(run.timeStepsDone) / run.totalTimeSteps : 0.0;
+  const auto rate = seconds > 0 ? run.timeStepsDone / seconds : 0.0;
+
+  cout << run.name << ": " << fixed << setprecision(1)
+       << 100 * fraction << "% of " << run.totalTimeSteps
+       << " time steps, " << scientific << setprecision(2) << rate
+       << " steps/s";
+  if (rate > 0 && fraction < 1) {
+    cout << ", " << fixed << setprecision(0)
+	 << (run.totalTimeSteps - run.timeStepsDone) / rate << " s to go";
+  }
+  cout << "\n";
+
+  for (auto column = size_t{0}; column < run.columns.size(); column++) {
+    auto lowest = samples.empty() ? 0.0 : samples.front().values.at(column);
+    auto highest = lowest;
+    for (auto&& sample : samples) {
+      lowest = min(lowest, sample.values.at(column));
+      highest = max(highest, sample.values.at(column));
+    }
+    cout << "  " << setw(12) << left << run.columns.at(column) << right
+	 << " " << trace(samples, column, width)
+	 << scientific << setprecision(3)
+	 << "  [" << lowest << ", " << highest << "]\n";
+  }
+  cout << flush;
+}
+
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options] NAME\n"
+       << "  --interval S     seconds between updates (default "
+       << DEFAULT_INTERVAL_SECONDS << ")\n"
+       << "  --width N        characters in each scope trace (default "
+       << DEFAULT_TRACE_WIDTH << ")\n"
+       << "  --csv            write the samples as comma separated\n"
+       << "                   values instead\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto interval = DEFAULT_INTERVAL_SECONDS;
+  auto width = DEFAULT_TRACE_WIDTH;
+  auto csv = false;
+
+  static const struct option longOptions[] = {
+    {"interval", required_argument, nullptr, 'i'},
+    {"width", required_argument, nullptr, 'w'},
+    {"csv", no_argument, nullptr, 'c'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  try {
+    auto option = int{0};
+    while ((option = getopt_long(argc, argv, "i:w:ch",
+				 longOptions, nullptr)) != -1) {
+      switch (option) {
+      case 'i':
+	interval = stod(optarg);
+	break;
+      case 'w':
+	width = stoul(optarg);
+	break;
+      case 'c':
+	csv = true;
+	break;
+      case 'h':
+	usage(argv[0]);
+	return EXIT_SUCCESS;
+      default:
+	usage(argv[0]);
+	return EXIT_FAILURE;
+      }
+    }
+  }
+  catch (const logic_error&) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (optind + 1 != argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  const auto name = string{argv[optind]};
+  const auto reader = TelemetryReader{name};
+
+  // Start with what is already in the ring
+  auto nextIndex = uint64_t{0};
+  auto runSequence = uint64_t{0};
+  auto latest = vector<TelemetrySample>{};
+
+  while (telemetryExists(name)) {
+    const auto run = reader.getRun();
+    if (run.sequence != runSequence) {
+      runSequence = run.sequence;
+      latest.clear();
+      if (csv) {
+	cout << "# " << run.name << "\n# timestep, time";
+	for (auto&& column : run.columns) {
+	  cout << ", " << column;
+	}
+	cout << endl;
+      }
+    }
+
+    auto samples = reader.read(nextIndex);
+    if (!samples.empty()) {
+      nextIndex = samples.back().index + 1;
+    }
+    if (csv) {
+      cout << scientific << setprecision(9);
+      for (auto&& sample : samples) {
+	cout << sample.timeStep << "," << sample.time;
+	for (auto value : sample.values) {
+	  cout << "," << value;
+	}
+	cout << "\n";
+      }
+      cout << flush;
+    }
+    else {
+      // Only show the samples from the current run
+      for (auto&& sample : samples) {
+	if (sample.values.size() == run.columns.size()) {
+	  latest.push_back(move(sample));
+	}
+      }
+      if (latest.size() > TELEMETRY_SLOTS) {
+	latest.erase(latest.begin(), latest.end() - TELEMETRY_SLOTS);
+      }
+      show(run, latest, width);
+    }
+
+    this_thread::sleep_for(chrono::duration<double>(interval));
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/**
+ * Converts compressed results files back into CSV files
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// The program is using AAA (almost-always-auto) style, in case you
+// are wondering
+
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include "Compressed.h"
+#include "Output.h"
+
+using namespace std;
+
+/**
+ * Print the command line options
+ *
+ * @param name program name
+ */
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options] input.zsc [output.txt]\n"
+       << "  --from SECONDS   first time to unpack (default the start)\n"
+       << "  --to SECONDS     last time to unpack (default the end)\n"
+       << "  --index          list the compressed blocks instead\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto fromTime = -numeric_limits<double>::infinity();
+  auto toTime = numeric_limits<double>::infinity();
+  auto listIndex = false;
+
+  static const struct option longOptions[] = {
+    {"from", required_argument, nullptr, 'f'},
+    {"to", required_argument, nullptr, 't'},
+    {"index", no_argument, nullptr, 'i'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  auto option = int{0};
+  while ((option = getopt_long(argc, argv, "f:t:ih",
+			       longOptions, nullptr)) != -1) {
+    switch (option) {
+    case 'f':
+      fromTime = stod(optarg);
+      break;
+    case 't':
+      toTime = stod(optarg);
+      break;
+    case 'i':
+      listIndex = true;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (optind >= argc || (!listIndex && optind + 2 != argc)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto reader = CompressedReader{argv[optind]};
+
+  if (listIndex) {
+    cout << "# block, offset, bytes, rows, first timestep, "
+	 << "last timestep, first time, last time, segment" << endl;
+    auto number = size_t{0};
+    for (auto&& block : reader.getIndex()) {
+      cout << number++ << "," << block.offset << "," << block.size << ","
+	   << block.rows << "," << block.firstTimeStep << ","
+	   << block.lastTimeStep << "," << setprecision(9) << scientific
+	   << block.firstTime << "," << block.lastTime << ","
+	   << defaultfloat;
+      if (block.segment == NO_SEGMENT) {
+	cout << "-" << endl;
+      }
+      else {
+	cout << block.segment << endl;
+      }
+    }
+    return EXIT_SUCCESS;
+  }
+
+  auto output = CsvFile{argv[optind + 1]};
+  reader.read(fromTime, toTime, output);
+}
@@ -0,0 +1,479 @@
+/**
+ * Checks the fast simulation engines against the reference engine
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs each of the standard scenarios with the reference engine, the
+ * long double simulation that program uses by default, and with each
+ * of the fast engines.  For every column it reports the largest and
+ * RMS differences, relative to the RMS of the reference column, and
+ * for the demodulated column it also compares the magnitude spectra.
+ * It fails if any of these are outside the engine's budget.
+ *
+ * It also checks the crowded band synthesis against summing the
+ * carriers one at a time.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include "Fft.h"
+#include "Mixer.h"
+#include "Output.h"
+#include "Scenarios.h"
+
+using namespace std;
+
+/**
+ * The most that a fast engine may differ from the reference.  The
+ * sample errors are relative to the RMS of the reference column, and
+ * the spectral error is relative to the size of the reference
+ * spectrum of the demodulated output.
+ */
+struct Budget {
+  double maxError;
+  double rmsError;
+  double spectralError;
+};
+
+// Number of chunks the chunked engine splits each ZetaSDR run into
+constexpr auto VERIFY_CHUNKS = size_t{4};
+
+// The chunked engine's joins, where the low pass filters have only
+// had the overlap to settle
+constexpr auto CHUNKS_BUDGET = Budget{5e-7, 5e-8, 1e-5};
+
+// The chunked engine with the active filters.  Their state carried
+// across the joins is within 1e-13, so the low pass filters are still
+// the worst
+constexpr auto CHUNKS_OPAMP_BUDGET = Budget{5e-7, 5e-8, 1e-5};
+
+// The crowded band synthesis against summing each carrier
+constexpr auto BAND_BUDGET = Budget{1e-5, 1e-6, 0};
+
+// Size of the crowded band check: stations, first time step, and
+// number of time steps
+constexpr auto BAND_CHECK_STATIONS = size_t{300};
+constexpr auto BAND_CHECK_FIRST = size_t{4000000};
+constexpr auto BAND_CHECK_TIME_STEPS = size_t{200000};
+
+/**
+ * A fast engine is the reference simulation with some options
+ * turned on.  Options that change the results, rather than how they
+ * are worked out, are turned on for both.
+ */
+struct Engine {
+  string name;
+  string description;
+  function<auto (ZetaSdr&, IqMixer&) -> void> configure;
+  Budget budget;
+  function<auto (ZetaSdr&, IqMixer&) -> void> both = {};
+};
+
+/**
+ * Differences between one column of results from the reference and
+ * from a fast engine
+ */
+struct ColumnError {
+  string name;
+  double maxError;
+  double rmsError;
+};
+
+//===================================================================
+
+/**
+ * Get the fast engines.  Add an entry here for each new engine, with
+ * a budget that it has to keep to before it can be used for real.
+ *
+ * @return the engines
+ */
+static auto engines() -> vector<Engine> {
+  return {
+    {"pipelined", "ZetaSDR stages in separate threads",
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setPipelined(true);
+      },
+     {0, 0, 0}},
+    {"fused", "IQ mixer in a single pass over blocks",
+     [](ZetaSdr&, IqMixer& iqmixer) {
+	iqmixer.setFused(true);
+      },
+     {1e-4, 1e-4, 1e-12}},
+    {"chunks", "ZetaSDR run as chunks of time in parallel",
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setChunks(VERIFY_CHUNKS, DEFAULT_CHUNK_OVERLAP);
+      },
+     CHUNKS_BUDGET},
+    {"chunks+opamp", "ZetaSDR run as chunks with the active filters",
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setChunks(VERIFY_CHUNKS, DEFAULT_CHUNK_OVERLAP);
+      },
+     CHUNKS_OPAMP_BUDGET,
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setOpAmpFilter(OpAmpFilter{RESISTANCE,
+					   OPAMP_FEEDBACK_RESISTANCE,
+					   OPAMP_FEEDBACK_CAPACITANCE,
+					   OPAMP_COUPLING_CAPACITANCE,
+					   SOUND_CARD_INPUT_RESISTANCE});
+      }},
+    {"logic", "ZetaSDR logic simulated by events with no delays",
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setLogicTiming(LogicTiming{0, 0, 0});
+      },
+     {0, 0, 0}},
+    {"fixed", "ZetaSDR circuit values built in at compile time",
+     [](ZetaSdr& zetasdr, IqMixer&) {
+	zetasdr.setFixedCircuit(true);
+      },
+     {0, 0, 0}},
+    {"waveforms", "RF signal shared between runs",
+     [](ZetaSdr& zetasdr, IqMixer& iqmixer) {
+	static auto waveforms = make_shared<WaveformCache>();
+	zetasdr.setWaveformCache(waveforms);
+	iqmixer.setWaveformCache(waveforms);
+      },
+     {0, 0, 0}}
+  };
+}
+
+/**
+ * Run a scenario and keep the results in memory
+ *
+ * @param scenario scenario to run
+ * @param both turns on the options that the reference engine has
+ *             too, empty for none
+ * @param configure turns on the engine's options, empty for the
+ *                  reference engine
+ * @return the results
+ */
+static auto runScenario(const Scenario& scenario,
+			const function<auto (ZetaSdr&, IqMixer&) -> void>&
+			both,
+			const function<auto (ZetaSdr&, IqMixer&) -> void>&
+			configure) -> ColumnSink {
+  const auto circuit = Circuit{RESISTANCE, CAPACITANCE, FILTER_CUTOFF};
+  auto zetasdr = ZetaSdr{circuit};
+  auto iqmixer = IqMixer{FILTER_CUTOFF};
+  if (both) {
+    both(zetasdr, iqmixer);
+  }
+  if (configure) {
+    configure(zetasdr, iqmixer);
+  }
+
+  auto results = ColumnSink{};
+  if (scenario.receiver == Receiver::ZETASDR) {
+    zetasdr.run(results, scenario.cycleCount,
+		scenario.signal, scenario.phaseAngleDeg);
+  }
+  else {
+    iqmixer.run(results, scenario.cycleCount,
+		scenario.signal, scenario.phaseAngleDeg);
+  }
+  return results;
+}
+
+/**
+ * Compare one column of results
+ *
+ * @param name column name
+ * @param reference reference values
+ * @param candidate fast engine values
+ * @return the differences
+ */
+static auto compareColumn(const string& name,
+			  const vector<double>& reference,
+			  const vector<double>& candidate) -> ColumnError {
+  auto maxError = 0.0;
+  auto sumSquaredError = 0.0;
+  auto sumSquaredReference = 0.0;
+  for (auto index = size_t{0}; index < reference.size(); index++) {
+    const auto error = fabs(candidate[index] - reference[index]);
+    maxError = max(maxError, error);
+    sumSquaredError += error * error;
+    sumSquaredReference += reference[index] * reference[index];
+  }
+  const auto count = static_cast<double>(max(reference.size(), size_t{1}));
+  const auto referenceRms = sqrt(sumSquaredReference / count);
+  const auto rmsError = sqrt(sumSquaredError / count);
+  if (referenceRms > 0) {
+    return {name, maxError / referenceRms, rmsError / referenceRms};
+  }
+  return {name, maxError, rmsError};
+}
+
+/**
+ * Compare the magnitude spectra of the demodulated output
+ *
+ * @param reference reference values
+ * @param candidate fast engine values
+ * @return RMS difference between the spectra, relative to the
+ *         reference spectrum
+ */
+static auto spectralError(const vector<double>& reference,
+			  const vector<double>& candidate) -> double {
+  const auto referenceSpectrum = magnitudeSpectrum(reference);
+  const auto candidateSpectrum = magnitudeSpectrum(candidate);
+  auto sumSquaredError = 0.0;
+  auto sumSquaredReference = 0.0;
+  for (auto bin = size_t{0}; bin < referenceSpectrum.size(); bin++) {
+    const auto error = candidateSpectrum[bin] - referenceSpectrum[bin];
+    sumSquaredError += error * error;
+    sumSquaredReference += referenceSpectrum[bin] * referenceSpectrum[bin];
+  }
+  return sumSquaredReference > 0 ?
+    sqrt(sumSquaredError / sumSquaredReference) : sqrt(sumSquaredError);
+}
+
+/**
+ * Compare the results of a fast engine with the reference, and print
+ * the outcome
+ *
+ * @param engine fast engine
+ * @param reference reference results
+ * @param candidate fast engine results
+ * @param verbose print every column rather than just the worst
+ * @return true if the engine kept to its budget
+ */
+static auto check(const Engine& engine,
+		  const ColumnSink& reference,
+		  const ColumnSink& candidate,
+		  bool verbose) -> bool {
+  const auto& names = reference.getNames();
+  if (names != candidate.getNames() ||
+      reference.getRowCount() != candidate.getRowCount() ||
+      reference.getColumns().at(0) != candidate.getColumns().at(0)) {
+    cout << "  " << engine.name << ": FAIL, columns or time steps differ"
+	 << endl;
+    return false;
+  }
+
+  // The first two columns are the time step and the time
+  auto errors = vector<ColumnError>{};
+  auto spectral = 0.0;
+  for (auto column = size_t{2}; column < names.size(); column++) {
+    errors.push_back(compareColumn(names.at(column),
+				   reference.getColumns().at(column),
+				   candidate.getColumns().at(column)));
+    if (names.at(column) == "demodulated") {
+      spectral = spectralError(reference.getColumns().at(column),
+			       candidate.getColumns().at(column));
+    }
+  }
+
+  auto worstMax = ColumnError{"", 0, 0};
+  auto worstRms = ColumnError{"", 0, 0};
+  for (auto&& error : errors) {
+    if (error.maxError >= worstMax.maxError) {
+      worstMax = error;
+    }
+    if (error.rmsError >= worstRms.rmsError) {
+      worstRms = error;
+    }
+  }
+
+  const auto passed = worstMax.maxError <= engine.budget.maxError &&
+    worstRms.rmsError <= engine.budget.rmsError &&
+    spectral <= engine.budget.spectralError;
+
+  cout << "  " << engine.name << ": " << (passed ? "pass" : "FAIL")
+       << scientific << setprecision(3)
+       << ", max " << worstMax.maxError << " (" << worstMax.name << ")"
+       << ", rms " << worstRms.rmsError << " (" << worstRms.name << ")"
+       << ", spectral " << spectral << endl;
+  if (verbose) {
+    for (auto&& error : errors) {
+      cout << "    " << left << setw(20) << error.name << right
+	   << " max " << error.maxError << ", rms " << error.rmsError
+	   << endl;
+    }
+  }
+  return passed;
+}
+
+//===================================================================
+
+/**
+ * Compare the crowded band synthesis with summing every carrier at
+ * every time step, and time them both
+ *
+ * @param stations number of stations in the band
+ * @return true if the band synthesis kept to its budget
+ */
+static auto checkBand(size_t stations) -> bool {
+  auto signal = Signal{CARRIER_AMPLITUDE, CARRIER_FREQUENCY,
+		       AmModulation{MODULATION_FREQUENCY}};
+  addCrowdedBand(signal, BandSettings{stations, BAND_SPAN, 1});
+
+  // Start part way into a run, where the time steps are large
+  const auto first = size_t{BAND_CHECK_FIRST};
+  auto direct = vector<floating>(BAND_CHECK_TIME_STEPS);
+  auto band = vector<floating>(BAND_CHECK_TIME_STEPS);
+
+  const auto start = chrono::steady_clock::now();
+  signal.synthesiseDirect(first, direct.size(), direct.data());
+  const auto middle = chrono::steady_clock::now();
+  for (auto block = size_t{0}; block < band.size(); block += 4096) {
+    signal.synthesiseBand(first + block, min(size_t{4096}, band.size() - block),
+			  band.data() + block);
+  }
+  const auto end = chrono::steady_clock::now();
+
+  const auto reference = vector<double>(direct.begin(), direct.end());
+  const auto candidate = vector<double>(band.begin(), band.end());
+  const auto error = compareColumn("signal", reference, candidate);
+  const auto passed = error.maxError <= BAND_BUDGET.maxError &&
+    error.rmsError <= BAND_BUDGET.rmsError;
+
+  const auto nanoseconds = [&](auto from, auto to) {
+    return chrono::duration<double, nano>(to - from).count() / direct.size();
+  };
+  cout << "crowded band of " << signal.getCarrierCount() << " carriers\n"
+       << "  band: " << (passed ? "pass" : "FAIL")
+       << scientific << setprecision(3)
+       << ", max " << error.maxError << ", rms " << error.rmsError
+       << fixed << setprecision(1)
+       << ", " << nanoseconds(middle, end) << " ns per time step against "
+       << nanoseconds(start, middle) << " ns summing each carrier" << endl;
+  return passed;
+}
+
+//===================================================================
+
+/**
+ * Print the command line options
+ *
+ * @param name program name
+ */
+static auto usage(const char* name) -> void {
+  cout << "Usage: " << name << " [options]\n"
+       << "  --engine NAME    only check this engine (default all of them)\n"
+       << "  --cycles N       run at most N carrier cycles per scenario\n"
+       << "  --verbose        print the errors for every column\n"
+       << "  --band STATIONS  stations in the crowded band check (default "
+       << BAND_CHECK_STATIONS << ", 0 to skip it)\n"
+       << "  --list           list the engines and their budgets\n";
+}
+
+auto main(int argc, char* argv[]) -> int {
+
+  auto engineName = string{};
+  auto maxCycles = size_t{0};
+  auto verbose = false;
+  auto list = false;
+  auto stations = size_t{BAND_CHECK_STATIONS};
+
+  static const struct option longOptions[] = {
+    {"engine", required_argument, nullptr, 'e'},
+    {"cycles", required_argument, nullptr, 'c'},
+    {"verbose", no_argument, nullptr, 'v'},
+    {"list", no_argument, nullptr, 'l'},
+    {"band", required_argument, nullptr, 'b'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  auto option = int{0};
+  while ((option = getopt_long(argc, argv, "e:c:vlb:h",
+			       longOptions, nullptr)) != -1) {
+    switch (option) {
+    case 'e':
+      engineName = optarg;
+      break;
+    case 'c':
+      maxCycles = stoul(optarg);
+      break;
+    case 'v':
+      verbose = true;
+      break;
+    case 'l':
+      list = true;
+      break;
+    case 'b':
+      stations = stoul(optarg);
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto selected = vector<Engine>{};
+  for (auto&& engine : engines()) {
+    if (engineName.empty() || engine.name == engineName) {
+      selected.push_back(engine);
+    }
+  }
+  if (selected.empty()) {
+    cout << "No engine called " << engineName << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (list) {
+    for (auto&& engine : selected) {
+      cout << engine.name << ": " << engine.description
+	   << scientific << setprecision(1)
+	   << ", max " << engine.budget.maxError
+	   << ", rms " << engine.budget.rmsError
+	   << ", spectral " << engine.budget.spectralError << endl;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  auto passed = true;
+  if (stations && engineName.empty()) {
+    passed = checkBand(stations);
+  }
+  for (auto&& scenario : standardScenarios(AmModulation{MODULATION_FREQUENCY})) {
+    if (maxCycles) {
+      scenario.cycleCount = min(scenario.cycleCount, maxCycles);
+    }
+    cout << scenario.name << endl;
+    const auto reference = runScenario(scenario, {}, {});
+    for (auto&& engine : selected) {
+      const auto candidate = runScenario(scenario, engine.both,
+					 engine.configure);
+      if (engine.both) {
+	const auto engineReference = runScenario(scenario, engine.both, {});
+	passed = check(engine, engineReference, candidate, verbose) && passed;
+      }
+      else {
+	passed = check(engine, reference, candidate, verbose) && passed;
+      }
+    }
+  }
+
+  cout << (passed ? "All engines within budget" :
+	   "Some engines are outside their budgets") << endl;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
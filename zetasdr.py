@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+
+#
+# Python interface to libzetasdr.so.  Runs the simulations in-process
+# and returns the results as NumPy arrays which share memory with the
+# library, so nothing is copied or parsed.
+#
+#  Copyright 2019  Jason Leake
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation
+# files (the "Software"), to deal in the Software without
+# restriction, including without limitation the rights to use, copy,
+# modify, merge, publish, distribute, sublicense, and/or sell copies
+# of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+# Example:
+#
+#   import zetasdr
+#   signal = zetasdr.Signal(1e-3, 7e6, 1e5)
+#   circuit = zetasdr.Circuit(85, 0.022e-6, 4e5)
+#   result = zetasdr.runZetaSdr(circuit, signal, 200, 35)
+#   plt.plot(result["time"], result["demodulated"])
+#
+
+import ctypes
+import os
+
+import numpy
+
+API_VERSION = 1
+
+_lib = ctypes.CDLL(os.environ.get("ZETASDR_LIBRARY",
+                                  os.path.join(os.path.dirname(
+                                      os.path.abspath(__file__)),
+                                               "libzetasdr.so")))
+
+_lib.zsdr_api_version.restype = ctypes.c_int
+_lib.zsdr_last_error.restype = ctypes.c_char_p
+
+_lib.zsdr_circuit_create.restype = ctypes.c_void_p
+_lib.zsdr_circuit_create.argtypes = [ctypes.c_double] * 3
+_lib.zsdr_circuit_destroy.argtypes = [ctypes.c_void_p]
+
+_lib.zsdr_signal_create.restype = ctypes.c_void_p
+_lib.zsdr_signal_create.argtypes = [ctypes.c_double] * 4
+_lib.zsdr_signal_add.restype = ctypes.c_int
+_lib.zsdr_signal_add.argtypes = [ctypes.c_void_p] + [ctypes.c_double] * 4
+_lib.zsdr_signal_destroy.argtypes = [ctypes.c_void_p]
+
+_lib.zsdr_run_zetasdr.restype = ctypes.c_void_p
+_lib.zsdr_run_zetasdr.argtypes = [ctypes.c_void_p, ctypes.c_void_p,
+                                  ctypes.c_size_t, ctypes.c_double]
+_lib.zsdr_run_iqmixer.restype = ctypes.c_void_p
+_lib.zsdr_run_iqmixer.argtypes = [ctypes.c_double, ctypes.c_void_p,
+                                  ctypes.c_size_t, ctypes.c_double]
+
+_lib.zsdr_result_rows.restype = ctypes.c_size_t
+_lib.zsdr_result_rows.argtypes = [ctypes.c_void_p]
+_lib.zsdr_result_columns.restype = ctypes.c_size_t
+_lib.zsdr_result_columns.argtypes = [ctypes.c_void_p]
+_lib.zsdr_result_column_name.restype = ctypes.c_char_p
+_lib.zsdr_result_column_name.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+_lib.zsdr_result_column.restype = ctypes.POINTER(ctypes.c_double)
+_lib.zsdr_result_column.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+_lib.zsdr_result_destroy.argtypes = [ctypes.c_void_p]
+
+if _lib.zsdr_api_version() < API_VERSION:
+    raise ImportError("libzetasdr.so is older than zetasdr.py")
+
+##
+# Raise an exception describing the last library failure
+#
+def _fail():
+    raise RuntimeError(_lib.zsdr_last_error().decode())
+
+##
+# Circuit characteristics of the ZetaSDR
+#
+class Circuit:
+    ##
+    # @param resistance resistance in series with detector capacitors
+    # @param capacitance detector capacitor value
+    # @param lpFreqHz low pass filter cutoff, 0 to disable
+    #
+    def __init__(self, resistance, capacitance, lpFreqHz):
+        self.handle = _lib.zsdr_circuit_create(resistance, capacitance,
+                                               lpFreqHz)
+        if not self.handle:
+            _fail()
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            _lib.zsdr_circuit_destroy(self.handle)
+
+##
+# RF signal made up of one or more amplitude modulated carriers
+#
+class Signal:
+    ##
+    # @param carrierAmplitude carrier amplitude
+    # @param carrierFreqHz carrier frequency
+    # @param modFreqHz modulation frequency
+    # @param phaseDeg initial phase angle
+    #
+    def __init__(self, carrierAmplitude, carrierFreqHz, modFreqHz,
+                 phaseDeg = 0):
+        self.handle = _lib.zsdr_signal_create(carrierAmplitude,
+                                              carrierFreqHz,
+                                              modFreqHz, phaseDeg)
+        if not self.handle:
+            _fail()
+
+    ##
+    # Add another carrier
+    #
+    def add(self, carrierAmplitude, carrierFreqHz, modFreqHz,
+            phaseDeg = 0):
+        if _lib.zsdr_signal_add(self.handle, carrierAmplitude,
+                                carrierFreqHz, modFreqHz, phaseDeg):
+            _fail()
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            _lib.zsdr_signal_destroy(self.handle)
+
+##
+# Results of one run.  Behaves as a read-only dictionary of column
+# name to NumPy array.  The arrays point straight into the library's
+# memory, and each one keeps the result alive for as long as it is
+# in use.
+#
+class Result:
+    def __init__(self, handle):
+        if not handle:
+            _fail()
+        self.handle = handle
+        self.columns = {}
+        rows = _lib.zsdr_result_rows(handle)
+        for column in range(_lib.zsdr_result_columns(handle)):
+            name = _lib.zsdr_result_column_name(handle, column).decode()
+            pointer = _lib.zsdr_result_column(handle, column)
+            buffer = (ctypes.c_double * rows).from_address(
+                ctypes.addressof(pointer.contents)) if rows else \
+                (ctypes.c_double * 0)()
+            buffer._owner = self
+            array = numpy.frombuffer(buffer, dtype=numpy.float64)
+            array.flags.writeable = False
+            self.columns[name] = array
+
+    def __getitem__(self, name):
+        return self.columns[name]
+
+    def __iter__(self):
+        return iter(self.columns)
+
+    def keys(self):
+        return self.columns.keys()
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            _lib.zsdr_result_destroy(self.handle)
+
+##
+# Run the ZetaSDR simulation
+#
+# @param circuit Circuit object
+# @param signal Signal object
+# @param cycles number of carrier cycles
+# @param phaseDeg phase of carrier relative to the local oscillator
+# @return Result object
+#
+def runZetaSdr(circuit, signal, cycles, phaseDeg = 0):
+    return Result(_lib.zsdr_run_zetasdr(circuit.handle, signal.handle,
+                                        cycles, phaseDeg))
+
+##
+# Run the ideal IQ mixer simulation
+#
+# @param lpFreqHz low pass filter cutoff, 0 to disable
+# @param signal Signal object
+# @param cycles number of carrier cycles
+# @param phaseDeg phase of carrier relative to the local oscillator
+# @return Result object
+#
+def runIqMixer(lpFreqHz, signal, cycles, phaseDeg = 0):
+    return Result(_lib.zsdr_run_iqmixer(lpFreqHz, signal.handle,
+                                        cycles, phaseDeg))
@@ -0,0 +1,90 @@
+/**
+ * C interface to the simulation, built into libzetasdr.so
+ *
+ * Copyright 2019  Jason Leake
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * All the objects are opaque handles.  Functions that create objects
+ * return NULL on failure, and zsdr_last_error() then describes what
+ * went wrong.  The result columns belong to the result object, and
+ * stay valid until zsdr_result_destroy() is called on it.
+ *
+ * Only add functions to the end of this interface, and bump
+ * ZSDR_API_VERSION when doing so, so that existing callers carry on
+ * working.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ZSDR_API_VERSION 1
+
+typedef struct zsdr_circuit zsdr_circuit;
+typedef struct zsdr_signal zsdr_signal;
+typedef struct zsdr_result zsdr_result;
+
+int zsdr_api_version(void);
+const char* zsdr_last_error(void);
+
+zsdr_circuit* zsdr_circuit_create(double resistance,
+				  double capacitance,
+				  double lpFreqHz);
+void zsdr_circuit_destroy(zsdr_circuit* circuit);
+
+zsdr_signal* zsdr_signal_create(double carrierAmplitude,
+				double carrierFreqHz,
+				double modFreqHz,
+				double initialPhaseAngleDegrees);
+int zsdr_signal_add(zsdr_signal* signal,
+		    double carrierAmplitude,
+		    double carrierFreqHz,
+		    double modFreqHz,
+		    double initialPhaseAngleDegrees);
+void zsdr_signal_destroy(zsdr_signal* signal);
+
+zsdr_result* zsdr_run_zetasdr(const zsdr_circuit* circuit,
+			      const zsdr_signal* signal,
+			      size_t cycleCount,
+			      double phaseAngleDeg);
+zsdr_result* zsdr_run_iqmixer(double lpFreqHz,
+			      const zsdr_signal* signal,
+			      size_t cycleCount,
+			      double phaseAngleDeg);
+
+size_t zsdr_result_rows(const zsdr_result* result);
+size_t zsdr_result_columns(const zsdr_result* result);
+const char* zsdr_result_column_name(const zsdr_result* result,
+				    size_t column);
+const double* zsdr_result_column(const zsdr_result* result,
+				 size_t column);
+void zsdr_result_destroy(zsdr_result* result);
+
+#ifdef __cplusplus
+}
+#endif